@@ -3,223 +3,238 @@
 #include "config.h"
 #include "state.h"
 #include "looper.h"
+#include "synth_events.h"
+#include "tempo.h"
 #include "arpeggiator.h"
 
-// External functions from main.cpp for playing notes
-extern void play_single_note(uint8_t note, uint8_t velocity);
-extern void stop_single_note(uint8_t note);
+// Midi output hook in main.cpp. The synth gets the notes directly.
+extern void arpeggiator_send_midi(uint8_t status, uint8_t data1, uint8_t data2);
+
+// Longest step sequence: up-down over every pad and octave
+#define ARP_MAX_STEPS   (2 * 12 * NUM_ARP_OCTAVES)
+
+// Notes handed to the synth and not finished yet
+#define ARP_MAX_PENDING 4
+
+// One step per beat of the tempo clock. The first one waits for the next
+// grid point, and the second of each pair is delayed by the swing.
+#define ARP_STEP_TICKS  TEMPO_PPQN
+#define ARP_START_GRID  (TEMPO_PPQN / 4)
+#define ARP_SWING_TICKS ((ARP_SWING_PERCENT - 50) * 2 * ARP_STEP_TICKS / 100)
+
+// A note handed to the synth ahead of time. Midi and the looper get it
+// when it sounds.
+typedef struct {
+    uint32_t on_time;           // Audio sample clock
+    uint32_t off_time;
+    uint8_t note;
+    uint8_t velocity;
+    bool sounding;              // Note on sent and recorded
+} arp_note_t;
 
 // Arpeggiator state
 typedef struct {
     uint16_t held_pads;         // Bitmask of currently held pads (bits 0-11)
     uint8_t held_count;         // Number of held pads
-    uint8_t held_order[12];     // Pads in order they were pressed (for sorting)
+    uint8_t sorted_pads[12];    // Held pads, low to high by note
+    uint8_t sorted_notes[12];   // Their notes when inserted, only used for the order
     uint8_t velocity;           // Velocity to use for arpeggiated notes
     
-    uint8_t current_index;      // Current position in the arp sequence
-    uint8_t current_octave;     // Current octave offset (0, 1, or 2)
-    int8_t direction;           // 1 = ascending, -1 = descending (for up-down)
+    // Steps of the pattern over the held pads, each the pad in the low
+    // nibble and the octave offset in the high one. Rebuilt when the held
+    // pads, the scale, the pattern or the octave range change.
+    uint8_t steps[ARP_MAX_STEPS];
+    uint8_t step_count;
+    uint8_t position;           // Next step
+    uint8_t pattern;            // Pattern and octave range the steps were built for
+    uint8_t octaves;
     
-    uint8_t current_note;       // Currently playing note (for note_off)
-    uint8_t current_pad;        // Pad ID of currently playing note (for looper recording)
-    bool note_playing;          // Is a note currently sounding?
+    uint32_t step_tick;         // Tempo tick of the next step, before the swing
+    bool swung;                 // The next step is the second of a pair
+    uint32_t last_time;         // Latest time handed to the synth, which must not go back
     
-    uint32_t last_step_time;    // Timestamp of last step
-    uint32_t note_on_time;      // Timestamp when current note started
+    arp_note_t pending[ARP_MAX_PENDING]; // In time order
+    uint8_t pending_count;
 } arpeggiator_t;
 
 static arpeggiator_t arp;
 
-// Get interval in milliseconds from state
-static uint32_t get_interval_ms() {
-    uint16_t speed = get_arp_speed_ms();
-    // Ensure valid range
-    if (speed < ARP_SPEED_MIN) return ARP_SPEED_MIN;
-    if (speed > ARP_SPEED_MAX) return ARP_SPEED_MAX;
-    return speed;
+static inline uint32_t align_up(uint32_t tick, uint32_t step) {
+    return ((tick + step - 1) / step) * step;
 }
 
-// Get the sorted list of held pads (low to high by note)
-static void get_sorted_pads(uint8_t *sorted, uint8_t *count) {
-    *count = 0;
-    
-    // Collect held pads
-    for (uint8_t i = 0; i < 12; i++) {
-        if (arp.held_pads & (1 << i)) {
-            sorted[(*count)++] = i;
-        }
-    }
-    
-    // Sort by note value (bubble sort is fine for max 12 items)
-    // Guard against count < 2 to avoid underflow
-    if (*count < 2) return;
-    
-    for (uint8_t i = 0; i < *count - 1; i++) {
-        for (uint8_t j = 0; j < *count - i - 1; j++) {
-            uint8_t note_a = get_note_by_id(sorted[j]);
-            uint8_t note_b = get_note_by_id(sorted[j + 1]);
-            if (note_a > note_b) {
-                uint8_t temp = sorted[j];
-                sorted[j] = sorted[j + 1];
-                sorted[j + 1] = temp;
-            }
-        }
+// Fisher-Yates shuffle of the steps, for the random pattern
+static void shuffle_steps() {
+    for (uint8_t i = arp.step_count; i > 1; i--) {
+        uint8_t j = rand() % i;
+        uint8_t temp = arp.steps[i - 1];
+        arp.steps[i - 1] = arp.steps[j];
+        arp.steps[j] = temp;
     }
 }
 
-// Get the next pad in the sequence based on pattern
-static bool get_next_step(uint8_t *pad_id, uint8_t *octave_offset) {
-    if (arp.held_count == 0) return false;
-    
-    uint8_t sorted[12];
-    uint8_t count;
-    get_sorted_pads(sorted, &count);
-    
-    if (count == 0) return false;
-    
-    uint8_t pattern = get_arp_pattern();
-    uint8_t max_octaves = get_arp_octave() + 1;  // 1, 2, or 3
-    
-    // Clamp current_index to valid range (in case pads were released)
-    if (arp.current_index >= count) {
-        arp.current_index = 0;
+static void build_steps() {
+    arp.pattern = get_arp_pattern();
+    arp.octaves = get_arp_octave() + 1;  // 1, 2, or 3
+
+    // Every pad of every octave, low to high
+    uint8_t count = 0;
+    for (uint8_t octave = 0; octave < arp.octaves; octave++) {
+        for (uint8_t i = 0; i < arp.held_count; i++) {
+            arp.steps[count++] = (octave << 4) | arp.sorted_pads[i];
+        }
     }
-    
-    switch (pattern) {
-        case ARP_UP:
-            *pad_id = sorted[arp.current_index];
-            *octave_offset = arp.current_octave;
-            
-            // Advance to next
-            arp.current_index++;
-            if (arp.current_index >= count) {
-                arp.current_index = 0;
-                arp.current_octave++;
-                if (arp.current_octave >= max_octaves) {
-                    arp.current_octave = 0;
-                }
-            }
-            break;
-            
+
+    switch (arp.pattern) {
         case ARP_DOWN:
-            *pad_id = sorted[count - 1 - arp.current_index];
-            *octave_offset = (max_octaves - 1) - arp.current_octave;
-            
-            // Advance to next
-            arp.current_index++;
-            if (arp.current_index >= count) {
-                arp.current_index = 0;
-                arp.current_octave++;
-                if (arp.current_octave >= max_octaves) {
-                    arp.current_octave = 0;
-                }
+            for (uint8_t i = 0; i < count / 2; i++) {
+                uint8_t temp = arp.steps[i];
+                arp.steps[i] = arp.steps[count - 1 - i];
+                arp.steps[count - 1 - i] = temp;
             }
             break;
-            
+
         case ARP_UP_DOWN:
-            if (arp.direction == 1) {
-                // Going up
-                *pad_id = sorted[arp.current_index];
-                *octave_offset = arp.current_octave;
-                
-                arp.current_index++;
-                if (arp.current_index >= count) {
-                    arp.current_index = 0;
-                    arp.current_octave++;
-                    if (arp.current_octave >= max_octaves) {
-                        // Reached top, reverse direction
-                        arp.direction = -1;
-                        arp.current_octave = max_octaves - 1;
-                        arp.current_index = count > 1 ? count - 2 : 0;  // Skip the top note (already played)
-                    }
-                }
-            } else {
-                // Going down
-                *pad_id = sorted[arp.current_index];
-                *octave_offset = arp.current_octave;
-                
-                if (arp.current_index == 0) {
-                    if (arp.current_octave == 0) {
-                        // Reached bottom, reverse direction
-                        arp.direction = 1;
-                        arp.current_index = count > 1 ? 1 : 0;  // Skip the bottom note (already played)
-                        arp.current_octave = 0;
-                    } else {
-                        arp.current_octave--;
-                        arp.current_index = count - 1;
-                    }
-                } else {
-                    arp.current_index--;
+            // Back down without repeating the top and bottom notes
+            if (count > 2) {
+                for (uint8_t i = count - 1; i > 1; i--) {
+                    arp.steps[count + (count - 1 - i)] = arp.steps[i - 1];
                 }
+                count = 2 * count - 2;
             }
             break;
-            
+
         case ARP_RANDOM:
-            *pad_id = sorted[rand() % count];
-            *octave_offset = rand() % max_octaves;
+            arp.step_count = count;
+            shuffle_steps();
             break;
-            
+
         default:
-            return false;
+            break;
     }
-    
-    return true;
-}
+    arp.step_count = count;
 
-// Play the next step in the arpeggio
-static void play_next_step() {
-    uint8_t pad_id;
-    uint8_t octave_offset;
-    
-    if (!get_next_step(&pad_id, &octave_offset)) {
-        return;
+    // Carry on from the same place, as far as the new steps go
+    if (arp.position >= arp.step_count) {
+        arp.position = 0;
     }
+}
+
+// Get the next pad in the sequence based on pattern
+static bool get_next_step(uint8_t *pad_id, uint8_t *octave_offset) {
+    if (arp.held_count == 0) return false;
     
-    // Stop previous note if playing
-    if (arp.note_playing) {
-        stop_single_note(arp.current_note);
-        arp.note_playing = false;
+    if (arp.pattern != get_arp_pattern() || arp.octaves != get_arp_octave() + 1) {
+        build_steps();
     }
+    if (arp.step_count == 0 || arp.pattern == ARP_OFF) return false;
     
-    // Calculate note with octave offset
-    uint8_t base_note = get_note_by_id(pad_id);
-    uint8_t note = base_note + (octave_offset * 12);
+    uint8_t step = arp.steps[arp.position];
+    *pad_id = step & 0x0F;
+    *octave_offset = step >> 4;
     
-    // Ensure note is in valid MIDI range
-    if (note > 127) note = 127;
+    // Advance to next
+    arp.position++;
+    if (arp.position >= arp.step_count) {
+        arp.position = 0;
+        if (arp.pattern == ARP_RANDOM) {
+            shuffle_steps(); // A new order for every round
+        }
+    }
     
-    // Play the note
-    play_single_note(note, arp.velocity);
-    arp.current_note = note;
-    arp.current_pad = pad_id;
-    arp.note_playing = true;
-    arp.note_on_time = time_us_32() / 1000;  // Convert to ms
-
-    // Record to looper using the actual note value
-    looper_record_note(note, arp.velocity, true);
+    return true;
 }
 
-// Stop the current note (for gate timing)
-static void stop_current_note() {
-    if (arp.note_playing) {
-        stop_single_note(arp.current_note);
-        // Record note off with the actual note value
-        looper_record_note(arp.current_note, 0, false);
-        arp.note_playing = false;
+// Hands the synth every step that starts before the lookahead horizon
+static void schedule_steps(uint32_t now) {
+    uint32_t horizon = now + SEQUENCER_LOOKAHEAD;
+    while (arp.pending_count < ARP_MAX_PENDING) {
+        uint32_t on_tick = arp.step_tick + (arp.swung ? ARP_SWING_TICKS : 0);
+        uint32_t on_time = tempo_tick_time(on_tick);
+        if ((int32_t)(on_time - horizon) >= 0) { return; }
+        if ((int32_t)(on_time - (now + SYNTH_EVENTS_LATENCY)) < 0) {
+            // Too late to be played in time, the tempo clock was restarted.
+            // Pick up the grid from here.
+            arp.step_tick = align_up(tempo_tick_at(now + SYNTH_EVENTS_LATENCY), ARP_START_GRID);
+            arp.swung = false;
+            continue;
+        }
+
+        uint8_t pad_id;
+        uint8_t octave_offset;
+        if (!get_next_step(&pad_id, &octave_offset)) { return; }
+
+        // Calculate note with octave offset, in the valid MIDI range
+        uint8_t note = get_note_by_id(pad_id) + (octave_offset * 12);
+        if (note > 127) note = 127;
+
+        // Gate length as a share of this step, which the swing lengthens or shortens
+        uint32_t length = arp.swung ? ARP_STEP_TICKS - ARP_SWING_TICKS : ARP_STEP_TICKS + ARP_SWING_TICKS;
+        uint32_t off_time = tempo_tick_time(on_tick + (length * ARP_GATE_PERCENT) / 100);
+        if ((int32_t)(on_time - arp.last_time) < 0) { on_time = arp.last_time; }
+        if ((int32_t)(off_time - on_time) <= 0) { off_time = on_time + 1; }
+
+        synth_events_post_at(SYNTH_LANE_ARPEGGIATOR, on_time, SYNTH_EVENT_NOTE_ON, note, arp.velocity);
+        synth_events_post_at(SYNTH_LANE_ARPEGGIATOR, off_time, SYNTH_EVENT_NOTE_OFF, note, 0);
+        arp.last_time = off_time;
+
+        arp_note_t *pending = &arp.pending[arp.pending_count++];
+        pending->on_time = on_time;
+        pending->off_time = off_time;
+        pending->note = note;
+        pending->velocity = arp.velocity;
+        pending->sounding = false;
+
+        arp.step_tick += ARP_STEP_TICKS;
+        arp.swung = !arp.swung;
     }
 }
 
+// Sends over Midi and records the note ons and offs that are due
+static void send_due_notes(uint32_t due) {
+    while (arp.pending_count > 0) {
+        arp_note_t *pending = &arp.pending[0];
+        if (!pending->sounding) {
+            if ((int32_t)(pending->on_time - due) > 0) { return; }
+            arpeggiator_send_midi(0x90, pending->note, pending->velocity);
+            looper_record_note(pending->note, pending->velocity, true);
+            pending->sounding = true;
+        }
+        if ((int32_t)(pending->off_time - due) > 0) { return; }
+        arpeggiator_send_midi(0x80, pending->note, 0);
+        looper_record_note(pending->note, 0, false);
+
+        arp.pending_count--;
+        for (uint8_t i = 0; i < arp.pending_count; i++) {
+            arp.pending[i] = arp.pending[i + 1];
+        }
+    }
+}
+
+// Drops the steps handed to the synth, and ends the notes now
+static void release_notes() {
+    synth_events_cancel_scheduled(SYNTH_LANE_ARPEGGIATOR);
+    for (uint8_t i = 0; i < arp.pending_count; i++) {
+        synth_events_post(SYNTH_EVENT_NOTE_OFF, arp.pending[i].note, 0);
+        if (arp.pending[i].sounding) {
+            arpeggiator_send_midi(0x80, arp.pending[i].note, 0);
+            looper_record_note(arp.pending[i].note, 0, false);
+        }
+    }
+    arp.pending_count = 0;
+}
+
 void arpeggiator_init() {
     arp.held_pads = 0;
     arp.held_count = 0;
-    arp.current_index = 0;
-    arp.current_octave = 0;
-    arp.direction = 1;
-    arp.current_note = 0;
-    arp.current_pad = 0;
-    arp.note_playing = false;
-    arp.last_step_time = 0;
-    arp.note_on_time = 0;
+    arp.step_count = 0;
+    arp.position = 0;
+    arp.pattern = ARP_OFF;
+    arp.octaves = 0;
+    arp.step_tick = 0;
+    arp.swung = false;
+    arp.last_time = 0;
+    arp.pending_count = 0;
     arp.velocity = 100;
     
     // Initialize default arp speed if not set
@@ -231,61 +246,87 @@ void arpeggiator_init() {
 void arpeggiator_pad_on(uint8_t pad_id, uint8_t velocity) {
     if (pad_id >= 12) return;
     
-    // Add pad to held set
+    // Insert pad into the sorted held set
     if (!(arp.held_pads & (1 << pad_id))) {
+        uint8_t note = get_note_by_id(pad_id);
+        uint8_t i = arp.held_count;
+        while (i > 0 && arp.sorted_notes[i - 1] > note) {
+            arp.sorted_pads[i] = arp.sorted_pads[i - 1];
+            arp.sorted_notes[i] = arp.sorted_notes[i - 1];
+            i--;
+        }
+        arp.sorted_pads[i] = pad_id;
+        arp.sorted_notes[i] = note;
         arp.held_pads |= (1 << pad_id);
-        arp.held_order[arp.held_count++] = pad_id;
+        arp.held_count++;
+        build_steps();
     }
     
     // Store velocity
     arp.velocity = velocity;
     
-    // If this is the first pad, start immediately
-    if (arp.held_count == 1) {
-        arp.current_index = 0;
-        arp.current_octave = 0;
-        arp.direction = 1;
-        arp.last_step_time = time_us_32() / 1000;
-        play_next_step();
+    // If this is the first pad, start on the next grid point that can still be played in time
+    if (arp.held_count == 1 && arp.pending_count == 0) {
+        uint32_t now = synth_events_now();
+        arp.position = 0;
+        arp.swung = false;
+        arp.last_time = now;
+        arp.step_tick = align_up(tempo_tick_at(now + SYNTH_EVENTS_LATENCY), ARP_START_GRID);
+        schedule_steps(now);
     }
 }
 
 void arpeggiator_pad_off(uint8_t pad_id) {
     if (pad_id >= 12) return;
     
-    // Remove pad from held set
+    // Remove pad from the sorted held set
     if (arp.held_pads & (1 << pad_id)) {
         arp.held_pads &= ~(1 << pad_id);
         arp.held_count--;
         
-        // Remove from held_order array
-        for (uint8_t i = 0; i < 12; i++) {
-            if (arp.held_order[i] == pad_id) {
-                // Shift remaining elements
-                for (uint8_t j = i; j < 11; j++) {
-                    arp.held_order[j] = arp.held_order[j + 1];
-                }
-                break;
-            }
+        uint8_t i = 0;
+        while (arp.sorted_pads[i] != pad_id) {
+            i++;
         }
+        for (; i < arp.held_count; i++) {
+            arp.sorted_pads[i] = arp.sorted_pads[i + 1];
+            arp.sorted_notes[i] = arp.sorted_notes[i + 1];
+        }
+        build_steps();
     }
     
     // If no more pads held, stop
     if (arp.held_count == 0) {
-        stop_current_note();
-        arp.current_index = 0;
-        arp.current_octave = 0;
-        arp.direction = 1;
+        release_notes();
+        arp.position = 0;
+    }
+}
+
+void arpeggiator_scale_changed() {
+    // Sort the held pads again by their new notes, insertion sort is fine for max 12 items
+    for (uint8_t i = 0; i < arp.held_count; i++) {
+        uint8_t pad = arp.sorted_pads[i];
+        uint8_t note = get_note_by_id(pad);
+        uint8_t j = i;
+        while (j > 0 && arp.sorted_notes[j - 1] > note) {
+            arp.sorted_pads[j] = arp.sorted_pads[j - 1];
+            arp.sorted_notes[j] = arp.sorted_notes[j - 1];
+            j--;
+        }
+        arp.sorted_pads[j] = pad;
+        arp.sorted_notes[j] = note;
+    }
+    if (arp.held_count > 0) {
+        build_steps();
     }
 }
 
 void arpeggiator_stop() {
-    stop_current_note();
+    release_notes();
     arp.held_pads = 0;
     arp.held_count = 0;
-    arp.current_index = 0;
-    arp.current_octave = 0;
-    arp.direction = 1;
+    arp.step_count = 0;
+    arp.position = 0;
 }
 
 bool arpeggiator_is_active() {
@@ -297,23 +338,17 @@ bool arpeggiator_is_enabled() {
 }
 
 void arpeggiator_task() {
-    // Only process if arpeggiator is enabled and has held pads
-    if (get_arp_pattern() == ARP_OFF || arp.held_count == 0) {
+    // Notes already handed to the synth play out, even with the arpeggiator turned off
+    bool running = get_arp_pattern() != ARP_OFF && arp.held_count > 0;
+    if (!running && arp.pending_count == 0) {
         return;
     }
     
-    uint32_t now = time_us_32() / 1000;  // Current time in ms
-    uint32_t interval = get_interval_ms();
-    uint32_t gate_time = (interval * ARP_GATE_PERCENT) / 100;
-    
-    // Check if we need to stop the current note (gate off)
-    if (arp.note_playing && (now - arp.note_on_time >= gate_time)) {
-        stop_current_note();
-    }
-    
-    // Check if it's time for the next step
-    if (now - arp.last_step_time >= interval) {
-        arp.last_step_time = now;
-        play_next_step();
+    // Steps follow the tempo clock, not this task. They are handed to the
+    // synth SEQUENCER_LOOKAHEAD ahead, and sent over Midi when they sound.
+    uint32_t now = synth_events_now();
+    if (running) {
+        schedule_steps(now);
     }
+    send_due_notes(now + SYNTH_EVENTS_LATENCY);
 }
@@ -25,6 +25,9 @@ void arpeggiator_pad_on(uint8_t pad_id, uint8_t velocity);
 // Called when a pad is released - removes note from arp sequence
 void arpeggiator_pad_off(uint8_t pad_id);
 
+// Call when the notes of the pads change order, after a scale change or edit
+void arpeggiator_scale_changed();
+
 // Stop all arpeggiated notes and reset state
 void arpeggiator_stop();
 
@@ -51,6 +51,10 @@
 #define MPU6050_SWAP_X_Y            true // Setting all three to true because of the module
 #define MPU6050_FLIP_X              true // orientation when mounted inside the enclosure
 #define MPU6050_FLIP_Y              true
+#define MPU6050_SAMPLE_RATE_HZ      1000 // Accelerometer samples per second, read in bursts from
+                                         // the FIFO. 1000 divided by a whole number.
+// #define MPU6050_INT_PIN          8  // Optional. If connected, the FIFO is only read
+#define MPU6050_INT_DESCRIPTION     "MPU6050 INT" // when the MPU6050 signals a new sample
 
 #define PLUS " + "
 #define SSD1306_MPU6050_SDA_DESCRIPTION SSD1306_SDA_DESCRIPTION PLUS MPU6050_SDA_DESCRIPTION
@@ -70,14 +74,34 @@
 #define MPR121_RELEASE_THRESHOLD    64 // size of your electrodes and their distance from the chip.
                                        // Threshold range is 0-255. If set incorrectly, you will get
                                        // "ghost" note_on and note_off events.
-#define MPR121_DEBOUNCE_THRESHOLD   46 // Larger values allow holding the electrode for longer without
+#define MPR121_DEBOUNCE_MS          46 // Larger values allow holding the electrode for longer without
                                        // triggering a new note_on event, but make it harder for the
                                        // sensor to detect quick subsequent taps
-
-#define VELOCITY_HOLD_SAMPLES       127 // How long to hold the peak value from accelerometer data.
+// #define MPR121_IRQ_PIN           20 // Optional. If connected, the touch status is only read
+#define MPR121_IRQ_DESCRIPTION      "MPR121 IRQ" // when the MPR121 signals a change
+
+#define USE_PRESSURE                // Remove this line to disable pad pressure (polyphonic aftertouch)
+#define MPR121_PRESSURE_INTERVAL_US 2000 // Pad pressure is read at this interval while any pad is touched
+#define MPR121_PRESSURE_RANGE       96   // Drop of the filtered data beyond MPR121_TOUCH_THRESHOLD
+                                         // that counts as full pressure
+#define MPR121_BASELINE_INTERVAL_US 50000 // The baselines are refreshed at this interval
+
+#define VELOCITY_WINDOW_MS          50  // How far back from a touch to look for the strike
+                                        // in the accelerometer data
+#define VELOCITY_LAG_MS             3   // How far past it. The note waits until the IMU task
+                                        // has read these samples from the FIFO
 #define VELOCITY_MULTIPLIER         4   // Higher values yield higher velocity, but
                                         // lower the dynamic range.
 
+/* Task scheduler (core0) */
+#define TOUCH_TASK_PERIOD_US        1000    // 1 kHz
+#define USB_TASK_PERIOD_US          1000
+#define UI_TASK_PERIOD_US           1000    // Encoder and button events, looper, arpeggiator
+#define IMU_TASK_PERIOD_US          4000    // 250 Hz, draining about 4 samples from the FIFO
+#define DISPLAY_MAX_FPS             30
+#define DISPLAY_TASK_PERIOD_US      (1000000 / DISPLAY_MAX_FPS)
+#define BATTERY_CHECK_INTERVAL_MS   5000    // 0.2 Hz, on its own timer
+
 /* Audio and synth */
 #define PRA32_U_MIDI_CH             0  // 0-based
 #define g_midi_ch                   PRA32_U_MIDI_CH // Required for compatibility with PRA32-U library
@@ -85,10 +109,32 @@
 #define AUDIO_BUFFER_LENGTH         64
 #define SOUND_OUTPUT_FREQUENCY      48000
 #define PICO_AUDIO_I2S_MONO_OUTPUT
+#define PRA32_U2_USE_2_CORES_FOR_SIGNAL_PROCESSING // Core1 renders the lower half of the voices and
+                                        // the effects, core0 renders the upper half of each
+                                        // block in an interrupt, unless core1 gets to it first
+#if defined (BOARD_IS_PICO2)
+#define PRA32_U2_NUM_VOICES         6  // Polyphony, at least 3
+#else
+#define PRA32_U2_NUM_VOICES         3
+#endif
+
+// Synth event queue between core0 and core1
+#define SYNTH_EVENTS_QUEUE_SIZE     256 // Must be a power of two
+#define SYNTH_EVENTS_LATENCY        (2 * AUDIO_BUFFER_LENGTH) // In samples. Events are applied this long
+                                        // after being posted, which keeps their relative timing exact
 
 // Event looper limits
 #define LOOPER_MAX_SECONDS          20          // Max loop length in seconds
-#define LOOPER_MAX_EVENTS           512         // Max stored events per loop
+#define LOOPER_MEMORY_SIZE          6144        // Bytes for the recorded events. Note offs and small pitch
+                                                // changes take 3, note ons and cc changes 4, and one more
+                                                // after a gap of over 512 samples. An overdub take needs
+                                                // as much room again until it is merged
+#define LOOPER_QUANTIZE_BARS        1           // Round loop lengths to whole bars of the tempo clock, 0 for free lengths
+
+// Tempo clock, shared by the looper and the arpeggiator
+#define SEQUENCER_LOOKAHEAD         (8 * AUDIO_BUFFER_LENGTH) // In samples. How far ahead of the audio clock
+                                        // looper playback and arpeggiator steps are handed to the synth
+#define TEMPO_EXTERNAL_TIMEOUT_MS   500 // Back to the internal tempo this long after the incoming Midi clock stops
 
 #define I2S_PIO_NUM                 0 // 0 for pio0, 1 for pio1
 #define I2S_DATA_PIN                2 // -> I2S DIN
@@ -120,17 +166,29 @@
 #define ARP_SPEED_MAX       1000    // Maximum interval (1000ms = 60 BPM)
 #define ARP_SPEED_DEFAULT   250     // Default interval (250ms = 240 BPM)
 #define ARP_SPEED_STEP      25      // Increment/decrement step in ms
+#define ARP_SWING_PERCENT   50      // Share of each pair of steps taken by the first one.
+                                    // 50 plays them straight, 67 as a triplet shuffle
 
 #define ARP_OCTAVE_1    0   // 1 octave range
 #define ARP_OCTAVE_2    1   // 2 octave range
 #define ARP_OCTAVE_3    2   // 3 octave range
 #define NUM_ARP_OCTAVES 3
 
-#define USE_MIDI                    // Remove this line to disable Midi output
+#define USE_MIDI                    // Remove this line to disable Midi output and input
+#define MIDI_IN_MAX_BYTES           128 // Read from the USB Midi stream per USB task, the rest waits in the FIFO
+#define MIDI_IN_NOTES_PER_TICK      16  // Incoming note ons played per USB task, the rest are dropped
+#define MIDI_IN_CONTROLS_PER_TICK   8   // Incoming CC, pitch bend, pressure and program changes per USB task.
+                                        // The rest wait for the next one, merged by control.
+#define MIDI_IN_SYSEX_MAX           16  // SysEx bytes kept to recognise a message
+#define MIDI_OUT_QUEUE_SIZE         64  // Outgoing Midi packets waiting for the host. A power of two, up to 128
+#define MIDI_OUT_RESERVE            16  // Of those, the ones only note offs can take
 
 /* Flash memory */
-// Reserve the last 4KB of the default 2MB flash for persistence.
-#define FLASH_TARGET_OFFSET         (FLASH_SECTOR_SIZE * 511)
+// Reserve the last 16KB of the default 2MB flash for persistence.
+// Settings are appended to a log across these sectors, see settings_store.h
+#define FLASH_SETTINGS_SECTORS      4
+#define FLASH_SETTINGS_OFFSET       (FLASH_SECTOR_SIZE * (512 - FLASH_SETTINGS_SECTORS))
+#define FLASH_LEGACY_OFFSET         (FLASH_SECTOR_SIZE * 511) // Single page written by firmware 2.5.1 and earlier
 #define MAGIC_NUMBER                {0x44, 0x4F, 0x44, 0x45} // 'DODE' - δώδε means 'twelve' in ancient Greek
 #define MAGIC_NUMBER_LENGTH         4
 #define FLASH_WRITE_DELAY_S         10  // To minimize flash operations, delay writing by this amount of seconds
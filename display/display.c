@@ -4,12 +4,13 @@
 #include <string.h>
 #include "pico/stdlib.h"
 #include "hardware/i2c.h"
+#include "hardware/sync.h"
 #include "config.h"
 #include "ssd1306.h"        // https://github.com/TuriSc/pico-ssd1306
 #include "state.h"
 #include "looper.h"
 #include "display.h"
-#include "i2c_mutex.h"
+#include "i2c1_bus.h"
 
 // Include assets
 #include "display_fonts.h"
@@ -33,19 +34,166 @@
 
 #define ICON_CENTERED_MARGIN_X ((SSD1306_WIDTH / 2) - (32 / 2))
 
+// SSD1306 control bytes and commands
+#define CONTROL_COMMAND         0x00
+#define CONTROL_DATA            0x40
+#define COMMAND_CONTRAST        0x81
+#define COMMAND_COLUMN_ADDRESS  0x21
+#define COMMAND_PAGE_ADDRESS    0x22
+
+#define DISPLAY_PAGES           (SSD1306_HEIGHT / 8)
+#define WINDOWS_PER_PAGE        2
+#define WINDOW_MIN_GAP          10  // Unchanged columns, about the bytes another window's addressing takes
+#define FLUSH_TIMEOUT_US        20000
+
+// Only the columns that changed since the last flush are sent, as up to
+// WINDOWS_PER_PAGE windows per page. Each window is one command and one data
+// transaction on the shared bus, so an IMU read never waits for more than one page.
+typedef struct {
+    uint8_t command[7];                 // Control byte, column and page address
+    i2c1_transaction_t command_transaction;
+    i2c1_transaction_t data_transaction;
+} display_window_t;
+
+typedef struct {
+    uint8_t data[1 + SSD1306_WIDTH];    // Copy of the page, column c at c + 1. The slot before
+                                        // a window holds its control byte, that column isn't sent
+    display_window_t windows[WINDOWS_PER_PAGE];
+} display_page_t;
+
+static display_page_t pages[DISPLAY_PAGES];
+static uint8_t shadow[DISPLAY_PAGES][SSD1306_WIDTH];   // Display RAM, once the queued windows are sent
+static bool shadow_valid = false;
+static uint8_t contrast_command[3];
+static i2c1_transaction_t contrast_transaction;
+static volatile int16_t contrast_request = -1;  // Waiting for the previous contrast command when >= 0
+
 static alarm_id_t display_dim_alarm_id;
-static volatile bool display_pending = false;  // Flag for deferred display updates
+static volatile uint8_t dirty_regions = DISPLAY_REGION_ALL;  // Changed since the last frame
+static volatile bool flush_pending = false;    // Drawn, but not queued yet
+
+static void init_transaction(i2c1_transaction_t *t, const uint8_t *data, uint16_t length) {
+    t->address = SSD1306_ADDRESS;
+    t->priority = I2C1_PRIORITY_LOW;
+    t->write_data = data;
+    t->write_length = length;
+    t->read_data = NULL;
+    t->read_length = 0;
+    t->status = I2C1_IDLE;
+}
+
+static void queue_window(uint8_t page, display_window_t *window, const uint8_t *frame, uint8_t start, uint8_t end) {
+    display_page_t *dp = &pages[page];
+    memcpy(&dp->data[1 + start], &frame[start], end - start + 1);
+    dp->data[start] = CONTROL_DATA;
+
+    window->command[2] = start;
+    window->command[3] = end;
+    window->command[5] = page;
+    window->command[6] = page;
+    window->data_transaction.write_data = &dp->data[start];
+    window->data_transaction.write_length = 1 + end - start + 1;
+    i2c1_bus_submit(&window->command_transaction);
+    i2c1_bus_submit(&window->data_transaction);
+}
+
+// Queues what changed in the frame buffer. Returns false, and leaves it for
+// display_update(), if the previous frame is still being sent.
+static bool display_flush(ssd1306_t *p) {
+    for (uint8_t page = 0; page < DISPLAY_PAGES; page++) {
+        for (uint8_t w = 0; w < WINDOWS_PER_PAGE; w++) {
+            display_window_t *window = &pages[page].windows[w];
+            if (i2c1_bus_is_pending(&window->command_transaction) ||
+                i2c1_bus_is_pending(&window->data_transaction)) {
+                flush_pending = true;
+                return false;
+            }
+            // Don't trust the shadow after a failed transfer, send it all again
+            if (window->command_transaction.status == I2C1_FAILED ||
+                window->data_transaction.status == I2C1_FAILED) {
+                window->command_transaction.status = I2C1_IDLE;
+                window->data_transaction.status = I2C1_IDLE;
+                shadow_valid = false;
+            }
+        }
+    }
+
+    for (uint8_t page = 0; page < DISPLAY_PAGES; page++) {
+        const uint8_t *frame = &p->buffer[page * SSD1306_WIDTH];
+        uint8_t windows = 0;
+        int16_t start = -1;
+        int16_t end = -1;
+        for (int16_t column = 0; column < SSD1306_WIDTH; column++) {
+            if (shadow_valid && frame[column] == shadow[page][column]) { continue; }
+            if (start < 0) {
+                start = column;
+            } else if (column - end - 1 >= WINDOW_MIN_GAP && windows < WINDOWS_PER_PAGE - 1) {
+                // Far enough from the previous change to be worth a window of its own
+                queue_window(page, &pages[page].windows[windows++], frame, start, end);
+                start = column;
+            }
+            end = column;
+        }
+        if (start >= 0) {
+            queue_window(page, &pages[page].windows[windows], frame, start, end);
+        }
+        memcpy(shadow[page], frame, SSD1306_WIDTH);
+    }
+    shadow_valid = true;
+    flush_pending = false;
+    return true;
+}
+
+static void flush_wait(void) {
+    for (uint8_t page = 0; page < DISPLAY_PAGES; page++) {
+        for (uint8_t w = 0; w < WINDOWS_PER_PAGE; w++) {
+            i2c1_bus_wait(&pages[page].windows[w].data_transaction, FLUSH_TIMEOUT_US);
+        }
+    }
+}
+
+// Contrast changes may come from the dim alarm, while the main loop is queueing one
+static void submit_contrast(void) {
+    uint32_t ints = save_and_disable_interrupts();
+    if (contrast_request >= 0 && !i2c1_bus_is_pending(&contrast_transaction)) {
+        contrast_command[2] = contrast_request;
+        contrast_request = -1;
+        i2c1_bus_submit(&contrast_transaction);
+    }
+    restore_interrupts(ints);
+}
+
+static void send_contrast(uint8_t contrast) {
+    contrast_request = contrast;
+    submit_contrast();
+}
 
 void display_init(ssd1306_t *p) {
     p->external_vcc=false;
-    i2c1_mutex_enter();
+    i2c1_bus_acquire();
     ssd1306_init(p, SSD1306_WIDTH, SSD1306_HEIGHT, SSD1306_ADDRESS, SSD1306_I2C_PORT);
 #if defined (SSD1306_ROTATE)
     ssd1306_rotate(p, 1);
 #endif
+    i2c1_bus_release();
+
+    for (uint8_t page = 0; page < DISPLAY_PAGES; page++) {
+        for (uint8_t w = 0; w < WINDOWS_PER_PAGE; w++) {
+            display_window_t *window = &pages[page].windows[w];
+            window->command[0] = CONTROL_COMMAND;
+            window->command[1] = COMMAND_COLUMN_ADDRESS;
+            window->command[4] = COMMAND_PAGE_ADDRESS;
+            init_transaction(&window->command_transaction, window->command, sizeof(window->command));
+            init_transaction(&window->data_transaction, pages[page].data, sizeof(pages[page].data));
+        }
+    }
+    shadow_valid = false;
+    contrast_command[0] = CONTROL_COMMAND;
+    contrast_command[1] = COMMAND_CONTRAST;
+    init_transaction(&contrast_transaction, contrast_command, sizeof(contrast_command));
+
     ssd1306_clear(p);
-    ssd1306_show(p);
-    i2c1_mutex_exit();
+    display_flush(p);
 }
 
 static inline void draw_info_screen(ssd1306_t *p) {
@@ -94,6 +242,9 @@ static inline void draw_looper_screen(ssd1306_t *p) {
     if(looper_is_recording()) {
         ssd1306_bmp_show_image_with_offset(p, icon_rec_data, icon_rec_size, state_x, state_y);
         state_label = "REC";
+    } else if(looper_is_overdubbing()) {
+        ssd1306_bmp_show_image_with_offset(p, icon_rec_data, icon_rec_size, state_x, state_y);
+        state_label = "DUB";
     } else if(looper_is_playing()) {
         ssd1306_bmp_show_image_with_offset(p, icon_play_data, icon_play_size, state_x, state_y);
         state_label = "PLAY";
@@ -144,10 +295,11 @@ static inline void draw_looper_screen(ssd1306_t *p) {
 
     // Row 3: hint or event count
     if(get_context() == CTX_LOOPER) {
-        ssd1306_draw_string(p, 0, 24, 1, "Btn Rec/Play | Hold Clear | Enc Restart");
+        ssd1306_draw_string(p, 0, 24, 1, "Btn Rec/Play | Hold Clear | Enc Restart/Undo");
     } else {
-        char evt_buf[16];
-        snprintf(evt_buf, sizeof(evt_buf), "evts:%u", looper_get_event_count());
+        char evt_buf[22];
+        snprintf(evt_buf, sizeof(evt_buf), "evts:%u mem:%u%% L%u", looper_get_event_count(),
+            looper_get_memory_percent(), looper_get_layer_count());
         ssd1306_draw_string(p, 0, 24, 1, evt_buf);
     }
 }
@@ -376,9 +528,8 @@ static inline void draw_scale_store_screen(ssd1306_t *p) {
 void intro_animation(ssd1306_t *p, void (*callback)(void)) {
     for(uint8_t current_frame=0; current_frame < INTRO_FRAMES_NUM; current_frame++) {
         ssd1306_bmp_show_image_with_offset(p, intro_frames[current_frame], INTRO_FRAME_SIZE, ICON_CENTERED_MARGIN_X, 0);
-        i2c1_mutex_enter();
-        ssd1306_show(p);
-        i2c1_mutex_exit();
+        flush_wait();
+        display_flush(p);
         busy_wait_ms(42); // About 24fps
         ssd1306_clear(p);
     }
@@ -533,12 +684,8 @@ static inline void draw_main_screen(ssd1306_t *p) {
 }
 
 void display_dim(ssd1306_t *p) {
-    // Use try_enter since this may be called from alarm callback (interrupt context)
-    if (i2c1_mutex_try_enter()) {
-        ssd1306_contrast(p, 0);
-        i2c1_mutex_exit();
-    }
-    // If mutex busy, skip - collision is rare and display staying bright briefly is acceptable
+    // Called from the alarm callback (interrupt context), queueing doesn't block
+    send_contrast(0);
 }
 
 int64_t display_dim_callback(alarm_id_t id, void * p) {
@@ -547,56 +694,48 @@ int64_t display_dim_callback(alarm_id_t id, void * p) {
 }
 
 void display_wake(ssd1306_t *p) {
-    i2c1_mutex_enter();
-    ssd1306_contrast(p, 255);
-    i2c1_mutex_exit();
+    send_contrast(255);
     if (display_dim_alarm_id) cancel_alarm(display_dim_alarm_id);
     display_dim_alarm_id = add_alarm_in_ms(DISPLAY_DIM_DELAY * 1000, display_dim_callback, p, true);
 }
 
 void display_refresh(ssd1306_t *p) {
-    i2c1_mutex_enter();
+    i2c1_bus_acquire();
     ssd1306_reset(p);
-    ssd1306_show(p);
-    i2c1_mutex_exit();
+    i2c1_bus_release();
+    shadow_valid = false;
+    display_flush(p);
 }
 
-void display_request_refresh(void) {
-    display_pending = true;
+// Also called from the battery timer interrupt, so the bits are set with it held off
+void display_invalidate(uint8_t regions) {
+    uint32_t ints = save_and_disable_interrupts();
+    dirty_regions |= regions;
+    restore_interrupts(ints);
 }
 
 void display_update_contrast(ssd1306_t *p) {
     if (display_dim_alarm_id) cancel_alarm(display_dim_alarm_id);
     uint8_t contrast = get_contrast();
-    i2c1_mutex_enter();
     switch (contrast) {
         case CONTRAST_MIN:
-            ssd1306_contrast(p, 0);
+            send_contrast(0);
         break;
         case CONTRAST_MED:
-            ssd1306_contrast(p, 127);
+            send_contrast(127);
         break;
         case CONTRAST_MAX:
-            ssd1306_contrast(p, 255);
+            send_contrast(255);
         break;
         case CONTRAST_AUTO:
-            i2c1_mutex_exit();  // Release before calling display_wake which acquires mutex
             display_wake(p);
-            return;  // display_wake already released mutex
         break;
     }
-    i2c1_mutex_exit();
 }
 
 void display_draw(ssd1306_t *p) {
-    // Try to acquire I2C lock - if busy, mark as pending and return immediately
-    // This prevents blocking note playback while waiting for IMU reads to complete
-    if (!i2c1_mutex_try_enter()) {
-        display_pending = true;
-        return;
-    }
-    
-    display_pending = false;
+    // Drawing only queues the frame on the I2C1 bus, and never waits for the IMU
+    dirty_regions = 0;
     selection_t selection = get_selection();
     context_t context = get_context();
 
@@ -672,10 +811,55 @@ void display_draw(ssd1306_t *p) {
         break;
     }
 
-    ssd1306_show(p);
-    i2c1_mutex_exit();
+    display_flush(p);
 }
 
-bool display_is_pending(void) {
-    return display_pending;
+// The regions shown by the current screen
+static uint8_t visible_regions(void) {
+    switch (get_context()) {
+        case CTX_SELECTION:
+            switch (get_selection()) {
+                case SELECTION_KEY:
+                case SELECTION_SCALE:
+                case SELECTION_INSTRUMENT:
+                case SELECTION_VOLUME:
+                    return DISPLAY_REGION_SCREEN | DISPLAY_REGION_NOTES;
+                default:
+                    return DISPLAY_REGION_SCREEN; // The looper page only shows its icon
+            }
+        case CTX_KEY:
+        case CTX_SCALE:
+        case CTX_INSTRUMENT:
+        case CTX_VOLUME:
+            return DISPLAY_REGION_SCREEN | DISPLAY_REGION_NOTES;
+        case CTX_LOOPER:
+            return DISPLAY_REGION_SCREEN | DISPLAY_REGION_LOOPER;
+        default:
+            return DISPLAY_REGION_SCREEN;
+    }
+}
+
+void display_update(ssd1306_t *p) {
+    uint8_t visible = visible_regions();
+
+    // The looper clock and progress bar move on their own
+    if ((visible & DISPLAY_REGION_LOOPER) && (looper_is_recording() || looper_is_playing())) {
+        display_invalidate(DISPLAY_REGION_LOOPER);
+    }
+
+    // Changes off screen are picked up by the full redraw on the next screen change.
+    // They are dropped in one go with the check, so a region invalidated in between is kept.
+    uint32_t ints = save_and_disable_interrupts();
+    bool draw = (dirty_regions & visible) != 0;
+    if (!draw) {
+        dirty_regions = 0;
+    }
+    restore_interrupts(ints);
+
+    if (draw) {
+        display_draw(p);
+    } else if (flush_pending) {
+        display_flush(p);
+    }
+    submit_contrast();
 }
@@ -13,15 +13,23 @@ extern "C" {
 #define CONTRAST_MAX    2
 #define CONTRAST_AUTO   3
 
+// Parts of the screen a state change can invalidate. The display task redraws
+// at most DISPLAY_MAX_FPS times per second, and only if the current screen
+// shows one of the invalidated regions.
+#define DISPLAY_REGION_SCREEN   0x01    // Context, selection or setting changes
+#define DISPLAY_REGION_NOTES    0x02    // Note indicator of the main screen
+#define DISPLAY_REGION_LOOPER   0x04    // Looper state, clock and progress bar
+#define DISPLAY_REGION_ALL      0xFF
+
 void display_init(ssd1306_t *p);
 void display_draw(ssd1306_t *p);
 void display_update_contrast(ssd1306_t *p);
 void display_dim(ssd1306_t *p);
 void display_wake(ssd1306_t *p);
 void display_refresh(ssd1306_t *p);
-void display_request_refresh(void); // Mark display for refresh when convenient
+void display_invalidate(uint8_t regions);  // Mark regions for the next frame
+void display_update(ssd1306_t *p);  // Redraw what was invalidated, and queue what the bus could not take yet
 void intro_animation(ssd1306_t *p, void (*callback)(void));
-bool display_is_pending(void);  // Returns true if a display update was deferred
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,196 @@
+#include "pico/stdlib.h"
+#include "hardware/i2c.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+#include "hardware/sync.h"
+#include "i2c1_bus.h"
+
+// A transaction still active after this long is given up, such as when a
+// device holds the bus, and the I2C block is reset so the queue carries on.
+// The longest one takes about 3.5 ms at 400 kHz.
+#define TRANSACTION_TIMEOUT_US  10000
+
+static i2c1_transaction_t *queue;       // Sorted by priority, first in first out within one
+static i2c1_transaction_t *volatile active;
+static uint32_t active_since;
+static uint baudrate;
+static bool held;                       // Queue stopped by i2c1_bus_acquire()
+static bool aborted;
+static int tx_channel;
+static int rx_channel;
+
+// Words for IC_DATA_CMD, which carry the read, restart and stop flags next to the data
+static uint16_t commands[I2C1_BUS_MAX_LENGTH];
+
+static void start_next(void) {
+    if (active != NULL || held || queue == NULL) { return; }
+    i2c1_transaction_t *t = queue;
+    queue = t->next;
+    active = t;
+    active_since = time_us_32();
+    aborted = false;
+    t->status = I2C1_ACTIVE;
+
+    uint16_t length = 0;
+    for (uint16_t i = 0; i < t->write_length; i++) {
+        commands[length++] = t->write_data[i];
+    }
+    for (uint16_t i = 0; i < t->read_length; i++) {
+        uint16_t command = I2C_IC_DATA_CMD_CMD_BITS;
+        if (i == 0 && t->write_length > 0) { command |= I2C_IC_DATA_CMD_RESTART_BITS; }
+        commands[length++] = command;
+    }
+    commands[length - 1] |= I2C_IC_DATA_CMD_STOP_BITS;
+
+    // The target address can only be changed while the block is disabled
+    i2c_hw_t *hw = i2c_get_hw(i2c1);
+    hw->enable = 0;
+    hw->tar = t->address;
+    hw->enable = 1;
+
+    if (t->read_length > 0) {
+        dma_channel_transfer_to_buffer_now(rx_channel, t->read_data, t->read_length);
+    }
+    dma_channel_transfer_from_buffer_now(tx_channel, commands, length);
+}
+
+static void i2c1_irq_handler(void) {
+    i2c_hw_t *hw = i2c_get_hw(i2c1);
+    uint32_t status = hw->intr_stat;
+
+    if (status & I2C_IC_RAW_INTR_STAT_TX_ABRT_BITS) {
+        // The controller flushes the TX FIFO and sends a STOP on its own.
+        // It holds the FIFO flushed until TX_ABRT is cleared, so the DMA is
+        // stopped first, or it would refill it with the rest of the transaction.
+        dma_channel_abort(tx_channel);
+        dma_channel_abort(rx_channel);
+        (void)hw->clr_tx_abrt;
+        aborted = true;
+    }
+    if (!(status & I2C_IC_RAW_INTR_STAT_STOP_DET_BITS)) { return; }
+    (void)hw->clr_stop_det;
+    if (active == NULL) { return; }
+
+    // The last byte read may still be on its way out of the RX FIFO
+    while (!aborted && dma_channel_is_busy(rx_channel)) {
+        tight_loop_contents();
+    }
+    active->status = aborted ? I2C1_FAILED : I2C1_DONE;
+    active = NULL;
+    start_next();
+}
+
+static void configure_block(void) {
+    i2c_hw_t *hw = i2c_get_hw(i2c1);
+    hw->dma_cr = I2C_IC_DMA_CR_TDMAE_BITS | I2C_IC_DMA_CR_RDMAE_BITS;
+    hw->intr_mask = I2C_IC_RAW_INTR_STAT_STOP_DET_BITS | I2C_IC_RAW_INTR_STAT_TX_ABRT_BITS;
+    (void)hw->clr_intr;
+}
+
+// Gives up the active transaction if it has been going on for too long.
+// Call with interrupts disabled.
+static void expire_active(void) {
+    if (active == NULL || time_us_32() - active_since < TRANSACTION_TIMEOUT_US) { return; }
+    dma_channel_abort(tx_channel);
+    dma_channel_abort(rx_channel);
+    // Resetting the block drops the transfer, and whatever it would have
+    // signalled later on
+    i2c_init(i2c1, baudrate);
+    configure_block();
+    active->status = I2C1_FAILED;
+    active = NULL;
+    start_next();
+}
+
+void i2c1_bus_init(uint i2c_baudrate) {
+    i2c_hw_t *hw = i2c_get_hw(i2c1);
+    baudrate = i2c_baudrate;
+
+    tx_channel = dma_claim_unused_channel(true);
+    dma_channel_config config = dma_channel_get_default_config(tx_channel);
+    channel_config_set_transfer_data_size(&config, DMA_SIZE_16);
+    channel_config_set_read_increment(&config, true);
+    channel_config_set_write_increment(&config, false);
+    channel_config_set_dreq(&config, i2c_get_dreq(i2c1, true));
+    dma_channel_configure(tx_channel, &config, &hw->data_cmd, NULL, 0, false);
+
+    rx_channel = dma_claim_unused_channel(true);
+    config = dma_channel_get_default_config(rx_channel);
+    channel_config_set_transfer_data_size(&config, DMA_SIZE_8);
+    channel_config_set_read_increment(&config, false);
+    channel_config_set_write_increment(&config, true);
+    channel_config_set_dreq(&config, i2c_get_dreq(i2c1, false));
+    dma_channel_configure(rx_channel, &config, NULL, &hw->data_cmd, 0, false);
+
+    configure_block();
+
+    irq_set_exclusive_handler(I2C1_IRQ, i2c1_irq_handler);
+    irq_set_enabled(I2C1_IRQ, true);
+}
+
+bool i2c1_bus_submit(i2c1_transaction_t *t) {
+    if (t->write_length + t->read_length == 0 ||
+        t->write_length + t->read_length > I2C1_BUS_MAX_LENGTH) {
+        return false;
+    }
+
+    uint32_t ints = save_and_disable_interrupts();
+    if (t->status == I2C1_QUEUED || t->status == I2C1_ACTIVE) {
+        restore_interrupts(ints);
+        return false;
+    }
+
+    t->status = I2C1_QUEUED;
+    t->next = NULL;
+    i2c1_transaction_t **link = &queue;
+    while (*link != NULL && (*link)->priority <= t->priority) {
+        link = &(*link)->next;
+    }
+    t->next = *link;
+    *link = t;
+
+    expire_active();
+    start_next();
+    restore_interrupts(ints);
+    return true;
+}
+
+bool i2c1_bus_is_pending(const i2c1_transaction_t *t) {
+    return t->status == I2C1_QUEUED || t->status == I2C1_ACTIVE;
+}
+
+bool i2c1_bus_wait(const i2c1_transaction_t *t, uint32_t timeout_us) {
+    uint32_t start = time_us_32();
+    while (i2c1_bus_is_pending(t)) {
+        if (time_us_32() - start > timeout_us) { return false; }
+        uint32_t ints = save_and_disable_interrupts();
+        expire_active();
+        restore_interrupts(ints);
+    }
+    return t->status == I2C1_DONE;
+}
+
+void i2c1_bus_acquire(void) {
+    uint32_t ints = save_and_disable_interrupts();
+    held = true;
+    restore_interrupts(ints);
+
+    while (active != NULL) {
+        ints = save_and_disable_interrupts();
+        expire_active();
+        restore_interrupts(ints);
+    }
+    // The pico-sdk calls poll the interrupt status on their own
+    irq_set_enabled(I2C1_IRQ, false);
+}
+
+void i2c1_bus_release(void) {
+    i2c_hw_t *hw = i2c_get_hw(i2c1);
+    (void)hw->clr_intr;
+    irq_set_enabled(I2C1_IRQ, true);
+
+    uint32_t ints = save_and_disable_interrupts();
+    held = false;
+    start_next();
+    restore_interrupts(ints);
+}
@@ -0,0 +1,71 @@
+#ifndef I2C1_BUS_H
+#define I2C1_BUS_H
+
+#include "pico/stdlib.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Transaction scheduler for the I2C1 bus (shared by SSD1306 display and MPU6050 IMU)
+// Transactions are queued by priority and run one at a time in the background:
+// a DMA channel feeds the TX FIFO with the bytes to write and the read commands,
+// a second one drains the RX FIFO, and the I2C1 interrupt starts the next
+// transaction once the STOP condition is on the bus. Long transfers such as
+// the display frame buffer are queued in chunks, so a sensor read waits for
+// at most one chunk.
+
+#define I2C1_BUS_MAX_LENGTH     136 // Bytes written plus bytes read in a single transaction
+
+typedef enum {
+    I2C1_PRIORITY_HIGH = 0,     // IMU reads
+    I2C1_PRIORITY_LOW,          // Display commands and frame buffer pages
+} i2c1_priority_t;
+
+typedef enum {
+    I2C1_IDLE = 0,
+    I2C1_QUEUED,
+    I2C1_ACTIVE,
+    I2C1_DONE,
+    I2C1_FAILED,                // Not acknowledged, or the bus was lost
+} i2c1_status_t;
+
+// Owned by the caller, and must stay untouched while queued or active.
+// The write is followed by a repeated start and the read, if any.
+typedef struct i2c1_transaction {
+    uint8_t address;
+    uint8_t priority;           // i2c1_priority_t
+    const uint8_t *write_data;
+    uint16_t write_length;
+    uint8_t *read_data;
+    uint16_t read_length;
+    volatile uint8_t status;    // i2c1_status_t
+    struct i2c1_transaction *next;
+} i2c1_transaction_t;
+
+// Call after i2c_init(), with the same baudrate. The block is initialized
+// again with it if a transaction never ends, such as with the bus stuck.
+void i2c1_bus_init(uint i2c_baudrate);
+
+// Queues the transaction behind the ones of the same or higher priority.
+// Returns false if it is still pending from an earlier submission or too long.
+// Safe to call from interrupt handlers on core0.
+bool i2c1_bus_submit(i2c1_transaction_t *t);
+
+bool i2c1_bus_is_pending(const i2c1_transaction_t *t);
+
+// Returns true if the transaction completed successfully within timeout_us.
+// On timeout the transaction stays queued. One that the bus never completes
+// is failed after a while, so neither this nor i2c1_bus_acquire() hangs.
+bool i2c1_bus_wait(const i2c1_transaction_t *t, uint32_t timeout_us);
+
+// Exclusive access for the blocking pico-sdk calls made by the display and
+// IMU libraries. Waits for the active transaction, and holds the queue until released.
+void i2c1_bus_acquire(void);
+void i2c1_bus_release(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
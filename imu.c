@@ -2,10 +2,11 @@
 
 #include "pico/stdlib.h"
 #include "hardware/clocks.h"
+#include "hardware/i2c.h"
 #include "MPU6050.h"
 #include <config.h>
 #include "imu.h"
-#include "i2c_mutex.h"
+#include "i2c1_bus.h"
 
 mpu6050_t mpu6050;
 
@@ -17,70 +18,147 @@ mpu6050_t mpu6050;
 #define FIXED_POINT_BITS 16
 #define FIXED_POINT_SCALE (1 << FIXED_POINT_BITS)
 
-#define PEAK_HOLD_WINDOW        10
+// Strike detection. Every FIFO sample goes into a ring of acceleration
+// changes, stamped with the time it was taken. A touch searches the part
+// of the ring around its own timestamp, so each note gets its own velocity.
+// The samples after the touch are still in the FIFO at first, so the note
+// waits for imu_task() to read them, for up to VELOCITY_GIVE_UP_US.
+#define SAMPLE_PERIOD_US        (1000000 / MPU6050_SAMPLE_RATE_HZ)
+#define VELOCITY_GIVE_UP_US     (2 * IMU_TASK_PERIOD_US)
+#define IMPACT_RING_SIZE        64   // Power of two
+#define IMPACT_RING_MASK        (IMPACT_RING_SIZE - 1)
+_Static_assert(IMPACT_RING_SIZE * SAMPLE_PERIOD_US >=
+               (VELOCITY_WINDOW_MS + VELOCITY_LAG_MS) * 1000 + VELOCITY_GIVE_UP_US,
+               "The impact ring is too short for VELOCITY_WINDOW_MS");
+
+// Tilt comes from an estimate of the gravity vector in the sensor frame, in Q30
+// (1 g = 1 << 30). Each sample rotates it by the gyro rates, then pulls it
+// towards the measured acceleration by 1/2^FUSION_SHIFT, a time constant of
+// 64 ms at 1 kHz. The measurement is left out while the acceleration is far
+// from 1 g, so strikes don't shake the tilt.
+#define ACCEL_1G                16384   // LSB at ±2 g
+#define ACCEL_1G_TOLERANCE      (ACCEL_1G / 8)
+#define GYRO_CONFIG_500DPS      0x08    // 65.5 LSB per °/s
+#define GYRO_Q30_PER_LSB        ((286 * SAMPLE_PERIOD_US) / 1000) // Radians turned in one sample period,
+                                                                  // (pi / 180 / 65.5) << 30 per second
+#define FUSION_SHIFT            6
+
+// MPU6050 registers
+#define REG_SMPLRT_DIV          0x19
+#define REG_GYRO_CONFIG         0x1B
+#define REG_FIFO_EN             0x23
+#define REG_INT_PIN_CFG         0x37
+#define REG_INT_ENABLE          0x38
+#define REG_USER_CTRL           0x6A
+#define REG_FIFO_COUNTH         0x72
+#define REG_FIFO_R_W            0x74
+
+#define FIFO_EN_ACCEL           0x08
+#define FIFO_EN_GYRO            0x70 // X, Y and Z
+#define INT_PIN_CFG_LATCH_INT   0x20 // INT stays high until the next read
+#define INT_PIN_CFG_RD_CLEAR    0x10 // Any read clears it
+#define INT_ENABLE_DATA_RDY     0x01
+#define USER_CTRL_FIFO_EN       0x40
+#define USER_CTRL_FIFO_RESET    0x04
+
+#define FIFO_SIZE               1024
+#define SAMPLE_BYTES            12   // Accelerometer then gyroscope X, Y and Z, big endian
+#define FIFO_MAX_SAMPLES        (FIFO_SIZE / SAMPLE_BYTES)
+#define BURST_MAX_SAMPLES       10   // Per read, the rest waits for the next imu_task()
+_Static_assert(1 + BURST_MAX_SAMPLES * SAMPLE_BYTES <= I2C1_BUS_MAX_LENGTH,
+               "A FIFO burst has to fit a single bus transaction");
 
 typedef struct {
-    int16_t peak;
-    int16_t window[PEAK_HOLD_WINDOW];
-    int8_t window_index;
-    int8_t reset_value;
-    int8_t reset_counter;
-} peak_hold_state_t;
-
-peak_hold_state_t peak_hold;
-
-void peak_hold_init(peak_hold_state_t *state) {
-    state->peak = 0;
-    for (int i = 0; i < PEAK_HOLD_WINDOW; i++) {
-        state->window[i] = 0;
+    uint32_t time_us;
+    int16_t delta;      // Change of the total acceleration since the previous sample
+} impact_sample_t;
+
+static impact_sample_t impact_ring[IMPACT_RING_SIZE];
+static uint8_t impact_head;     // Next slot to write
+static uint8_t impact_count;
+
+static int32_t gravity[3] = { 0, 0, 1 << 30 };
+
+// Integer square root. The seed from the highest set bit is within a factor
+// of 2 above the root, so Newton's method takes at most 6 steps down to it.
+static uint32_t isqrt32(uint32_t x) {
+    if (x == 0) { return 0; }
+    uint32_t y = 1u << ((33 - __builtin_clz(x)) / 2);
+    while (true) {
+        uint32_t next = (y + x / y) >> 1;
+        if (next >= y) { return y; }
+        y = next;
     }
-    state->window_index = 0;
-    state->reset_value = VELOCITY_HOLD_SAMPLES;
-    state->reset_counter = 0;
 }
 
-void peak_hold_update(peak_hold_state_t *state, int16_t value) {
-    state->window[state->window_index] = value;
-    state->window_index = (state->window_index + 1) % PEAK_HOLD_WINDOW;
-
-    // Find maximum value in window
-    int16_t max_value = state->window[0];
-    for (int i = 1; i < PEAK_HOLD_WINDOW; i++) {
-        if (state->window[i] > max_value) {
-            max_value = state->window[i];
-        }
-    }
-
-    // Update peak if new maximum is higher
-    if (max_value > state->peak) {
-        state->peak = max_value;
-    }
-
-    // Reset the peak after the timeout
-    if (++state->reset_counter == state->reset_value) {
-        peak_hold_init(state);
-    }
+static inline int32_t mul_q30(int32_t a, int32_t b) {
+    return (int32_t)(((int64_t)a * b) >> 30);
 }
 
-int16_t peak_hold_get(peak_hold_state_t *state) {
-    return state->peak;
-}
+// Complementary filter step for one sample, see FUSION_SHIFT
+static void fusion_update(const int16_t accel[3], const int16_t gyro[3], uint32_t accel_magnitude) {
+    int32_t wx = gyro[0] * GYRO_Q30_PER_LSB;
+    int32_t wy = gyro[1] * GYRO_Q30_PER_LSB;
+    int32_t wz = gyro[2] * GYRO_Q30_PER_LSB;
+
+    // The gravity vector turns against the sensor: g += g x w
+    int32_t gx = gravity[0] + mul_q30(gravity[1], wz) - mul_q30(gravity[2], wy);
+    int32_t gy = gravity[1] + mul_q30(gravity[2], wx) - mul_q30(gravity[0], wz);
+    int32_t gz = gravity[2] + mul_q30(gravity[0], wy) - mul_q30(gravity[1], wx);
+
+    int32_t error = (int32_t)accel_magnitude - ACCEL_1G;
+    if (error > -ACCEL_1G_TOLERANCE && error < ACCEL_1G_TOLERANCE) {
+        // Scaled separately, the difference could overflow
+        gx += (accel[0] * (65536 >> FUSION_SHIFT)) - (gx >> FUSION_SHIFT);
+        gy += (accel[1] * (65536 >> FUSION_SHIFT)) - (gy >> FUSION_SHIFT);
+        gz += (accel[2] * (65536 >> FUSION_SHIFT)) - (gz >> FUSION_SHIFT);
+    }
 
-inline int16_t mul_fixed(int16_t a, int16_t b) {
-    return (a * b) >> FIXED_POINT_BITS;
+    gravity[0] = gx;
+    gravity[1] = gy;
+    gravity[2] = gz;
 }
 
-inline int16_t sqrt_fixed(int16_t x) {
-    int16_t y = x;
-    int32_t e = FIXED_POINT_SCALE;
-    while (e > 1) {
-        e >>= 1;
-        y = (y + mul_fixed(x, FIXED_POINT_SCALE / y)) >> 1;
-    }
-    return y;
+// Waiting for one display page on the bus, then the read itself
+#define IMU_READ_TIMEOUT_US 5000
+
+static uint8_t fifo_count_register = REG_FIFO_COUNTH;
+static uint8_t fifo_count_data[2];
+static i2c1_transaction_t fifo_count_transaction = {
+    .address = MPU6050_ADDRESS,
+    .priority = I2C1_PRIORITY_HIGH,
+    .write_data = &fifo_count_register,
+    .write_length = 1,
+    .read_data = fifo_count_data,
+    .read_length = sizeof(fifo_count_data),
+};
+
+static uint8_t fifo_data_register = REG_FIFO_R_W;
+static uint8_t fifo_data[BURST_MAX_SAMPLES * SAMPLE_BYTES];
+static i2c1_transaction_t fifo_data_transaction = {
+    .address = MPU6050_ADDRESS,
+    .priority = I2C1_PRIORITY_HIGH,
+    .write_data = &fifo_data_register,
+    .write_length = 1,
+    .read_data = fifo_data,
+    .read_length = 0, // Set for each burst
+};
+
+static uint8_t fifo_reset_command[2] = { REG_USER_CTRL, USER_CTRL_FIFO_EN | USER_CTRL_FIFO_RESET };
+static i2c1_transaction_t fifo_reset_transaction = {
+    .address = MPU6050_ADDRESS,
+    .priority = I2C1_PRIORITY_HIGH,
+    .write_data = fifo_reset_command,
+    .write_length = sizeof(fifo_reset_command),
+};
+
+static void write_register(uint8_t reg, uint8_t value) {
+    uint8_t buffer[2] = { reg, value };
+    i2c_write_blocking(MPU6050_I2C_PORT, MPU6050_ADDRESS, buffer, 2, false);
 }
 
 void imu_init(){
+    i2c1_bus_acquire();
     mpu6050 = mpu6050_init(MPU6050_I2C_PORT, MPU6050_ADDRESS);
 
     if (mpu6050_begin(&mpu6050)) {
@@ -91,31 +169,67 @@ void imu_init(){
         mpu6050_set_dlpf_mode(&mpu6050, MPU6050_DLPF_3);
 
         mpu6050_set_accelerometer_measuring(&mpu6050, true);
+        mpu6050_set_gyroscope_measuring(&mpu6050, true);
+        write_register(REG_GYRO_CONFIG, GYRO_CONFIG_500DPS);
+
+        // Fill the FIFO at a fixed rate, imu_task() drains it in bursts.
+        // The sample rate divides the 1 kHz output rate of the DLPF.
+        write_register(REG_SMPLRT_DIV, (1000 / MPU6050_SAMPLE_RATE_HZ) - 1);
+        write_register(REG_FIFO_EN, FIFO_EN_ACCEL | FIFO_EN_GYRO);
+#if defined (MPU6050_INT_PIN)
+        write_register(REG_INT_PIN_CFG, INT_PIN_CFG_LATCH_INT | INT_PIN_CFG_RD_CLEAR);
+        write_register(REG_INT_ENABLE, INT_ENABLE_DATA_RDY);
+#endif
+        write_register(REG_USER_CTRL, USER_CTRL_FIFO_EN | USER_CTRL_FIFO_RESET);
 
-        // We're not calibrating the IMU on Pico RP2040, and we're not fusing gyro and accelerometer data
-        // to account for gravitational compensation.
+        // We're not calibrating the IMU on Pico RP2040. Gyro and accelerometer
+        // data are fused into the gravity estimate, see fusion_update().
     }
 
-    peak_hold_init(&peak_hold);
+    i2c1_bus_release();
+
+#if defined (MPU6050_INT_PIN)
+    gpio_init(MPU6050_INT_PIN);
+    gpio_set_dir(MPU6050_INT_PIN, GPIO_IN);
+    gpio_pull_down(MPU6050_INT_PIN);
+#endif
+
+    impact_head = 0;
+    impact_count = 0;
 }
 
-// Overriding rpi-pico-mpu6050 library methods for minimal, fixed-point calculations
-void read_raw_accel_fixed(struct mpu6050 *self) {
-    struct i2c_information *i2c = &self->i2c;
-    uint8_t data[6];
+// Overriding rpi-pico-mpu6050 library methods for minimal, fixed-point calculations.
+// Reads up to BURST_MAX_SAMPLES samples from the FIFO into fifo_data and
+// returns how many, with the number of samples left behind in *remaining.
+// Both reads go ahead of any display page still queued on the bus.
+static uint8_t read_fifo(uint8_t *remaining) {
+#if defined (MPU6050_INT_PIN)
+    if (!gpio_get(MPU6050_INT_PIN)) { return 0; } // No new sample since the last read
+#endif
+
+    if (!i2c1_bus_submit(&fifo_count_transaction)) { return 0; } // Previous read timed out and is still queued
+    if (!i2c1_bus_wait(&fifo_count_transaction, IMU_READ_TIMEOUT_US)) { return 0; }
+    uint16_t count = (fifo_count_data[0] << 8) | fifo_count_data[1];
 
-    self->ra.x = 0;
-    self->ra.y = 0;
-    self->ra.z = 0;
+    // On overflow the oldest bytes are lost, and the samples don't line up anymore.
+    // This also happens while imu_task() isn't called, with the IMU axes off.
+    if (count > FIFO_MAX_SAMPLES * SAMPLE_BYTES) {
+        i2c1_bus_submit(&fifo_reset_transaction);
+        return 0;
+    }
 
-    // Read raw accelerometer data
-    uint8_t reg = 0x3B; // ACCEL_XOUT_H
-    i2c_write_timeout_us(i2c->instance, i2c->address, &reg, 1, true, 3000);
-    i2c_read_timeout_us(i2c->instance, i2c->address, data, 6, false, 3000);
+    uint8_t samples = count / SAMPLE_BYTES;
+    *remaining = 0;
+    if (samples > BURST_MAX_SAMPLES) {
+        *remaining = samples - BURST_MAX_SAMPLES;
+        samples = BURST_MAX_SAMPLES;
+    }
+    if (samples == 0) { return 0; }
 
-    self->ra.x = data[0] << 8 | data[1];
-    self->ra.y = data[2] << 8 | data[3];
-    self->ra.z = data[4] << 8 | data[5];
+    fifo_data_transaction.read_length = samples * SAMPLE_BYTES;
+    if (!i2c1_bus_submit(&fifo_data_transaction)) { return 0; }
+    if (!i2c1_bus_wait(&fifo_data_transaction, IMU_READ_TIMEOUT_US)) { return 0; }
+    return samples;
 }
 
 int16_t abs_fixed(int16_t x) {
@@ -132,30 +246,77 @@ int16_t map_14(int16_t value) {
     return (result < 0) ? 0 : (result > 16383) ? 16383 : result;
 }
 
+// Reads the FIFO, adds its samples to the impact ring and updates the
+// gravity estimate. Returns the number of samples.
+static uint8_t drain_fifo(void) {
+    uint8_t remaining;
+    uint8_t samples = read_fifo(&remaining);
+    if (samples == 0) { return 0; }
+
+    // The newest sample in the FIFO was taken just now
+    uint32_t time_us = time_us_32() - (uint32_t)(remaining + samples - 1) * SAMPLE_PERIOD_US;
+
+    static int16_t prev_tot_accel;
+    for (uint8_t i = 0; i < samples; i++) {
+        const uint8_t *sample = &fifo_data[i * SAMPLE_BYTES];
+        int16_t accel[3];
+        int16_t gyro[3];
+        for (uint8_t axis = 0; axis < 3; axis++) {
+            accel[axis] = sample[axis * 2] << 8 | sample[axis * 2 + 1];
+            gyro[axis] = sample[6 + axis * 2] << 8 | sample[6 + axis * 2 + 1];
+        }
+
+        // Calculate the total motion acceleration (which is not linear since we have not accounted for gravity)
+        uint32_t magnitude = isqrt32((uint32_t)(accel[0] * accel[0]) +
+                                     (uint32_t)(accel[1] * accel[1]) +
+                                     (uint32_t)(accel[2] * accel[2]));
+        int16_t tot_accel = magnitude >> 8;
+
+        impact_ring[impact_head].time_us = time_us;
+        impact_ring[impact_head].delta = abs_fixed(prev_tot_accel - tot_accel);
+        impact_head = (impact_head + 1) & IMPACT_RING_MASK;
+        if (impact_count < IMPACT_RING_SIZE) { impact_count++; }
+        prev_tot_accel = tot_accel;
+        time_us += SAMPLE_PERIOD_US;
+
+        fusion_update(accel, gyro, magnitude);
+    }
+
+    mpu6050.ra.x = gravity[0] >> 16;
+    mpu6050.ra.y = gravity[1] >> 16;
+    mpu6050.ra.z = gravity[2] >> 16;
+    return samples;
+}
+
+bool imu_get_velocity(uint32_t time_us, uint8_t *velocity) {
+    uint32_t end_us = time_us + VELOCITY_LAG_MS * 1000;
+    bool complete = (int32_t)(time_us_32() - end_us) > VELOCITY_GIVE_UP_US;
+    if (impact_count > 0) {
+        const impact_sample_t *newest = &impact_ring[(impact_head - 1) & IMPACT_RING_MASK];
+        if ((int32_t)(newest->time_us - end_us) >= 0) { complete = true; }
+    }
+
+    // Newest first, until the window is left behind
+    int16_t peak = 0;
+    for (uint8_t i = 1; i <= impact_count; i++) {
+        const impact_sample_t *sample = &impact_ring[(impact_head - i) & IMPACT_RING_MASK];
+        if ((int32_t)(sample->time_us - end_us) > 0) { continue; }
+        if ((int32_t)(time_us - sample->time_us) > VELOCITY_WINDOW_MS * 1000) { break; }
+        if (sample->delta > peak) { peak = sample->delta; }
+    }
+    *velocity = map_7(peak * VELOCITY_MULTIPLIER);
+    return complete;
+}
+
 void imu_task(Imu_data * data) {
-    // Acquire I2C lock before reading IMU data
-    i2c1_mutex_enter();
-    read_raw_accel_fixed(&mpu6050);
-    i2c1_mutex_exit();
-    
-    struct mpu6050_vector16 *accel = &mpu6050.ra;
+    if (drain_fifo() == 0) { return; }
 
+    // Tilt follows the gravity estimate.
     // Scale the raw readings.
     // 493 = (MPU6050_SCALE_250DPS * (1 << 16)) / 1
+    struct mpu6050_vector16 *accel = &mpu6050.ra;
     int16_t ax = (accel->x * 493) / FIXED_POINT_SCALE;
     int16_t ay = (accel->y * 493) / FIXED_POINT_SCALE;
-    int16_t az = (accel->z * 493) / FIXED_POINT_SCALE;
-
-    // Calculate the total motion acceleration (which is not linear since we have not accounted for gravity)
-    int16_t tot_accel = sqrt_fixed(mul_fixed(accel->x, accel->x) +
-                               mul_fixed(accel->y, accel->y) +
-                               mul_fixed(accel->z, accel->z));
-
-    static int16_t prev_tot_accel;
-    int16_t delta_accel = abs_fixed(prev_tot_accel - tot_accel);
-    prev_tot_accel = tot_accel;
-
-    peak_hold_update(&peak_hold, delta_accel);
 
 #if defined (MPU6050_FLIP_X)
     ax = -ax;
@@ -173,7 +334,4 @@ void imu_task(Imu_data * data) {
     // X goes to pitch bending, Y goes to cutoff
     data->deviation_x = map_14(ax);
     data->deviation_y = map_7(LPF_MIN + ay);
-
-    // Acceleration goes to velocity
-    data->acceleration = (map_7(peak_hold_get(&peak_hold) * VELOCITY_MULTIPLIER));
 }
\ No newline at end of file
@@ -8,7 +8,6 @@ extern "C" {
 
 // Accelerometer/gyroscope data structure for Dodepan
 typedef struct {
-    uint8_t acceleration; // Also used to calculate velocity for Midi
     uint16_t deviation_x;
     uint8_t deviation_y;
 } Imu_data;
@@ -16,6 +15,14 @@ typedef struct {
 void imu_init();
 void imu_task(Imu_data * data);
 
+// Velocity (0-127) of a strike at the given time_us_32() timestamp, from the
+// largest change of acceleration from VELOCITY_WINDOW_MS before it to
+// VELOCITY_LAG_MS after it. Returns false while imu_task() has yet to read
+// the samples up to the end of that span, with the velocity of those it has,
+// unless it has fallen behind by more than two of its periods.
+// Doesn't read the IMU, so it is cheap enough for the touch path.
+bool imu_get_velocity(uint32_t time_us, uint8_t *velocity);
+
 #ifdef __cplusplus
 }
 #endif
@@ -145,39 +145,42 @@ void __not_in_flash_func(setup1)() {
 void __not_in_flash_func(loop1)() {
   boolean processed = g_synth.secondary_core_process();
   if (processed) {
-    static uint32_t s_loop_counter = 0;
-    s_loop_counter++;
-    if (s_loop_counter >= 16 * 400) {
-      s_loop_counter = 0;
-    }
-
-    PRA32_U2_ControlPanel_update_analog_inputs(s_loop_counter);
-    PRA32_U2_ControlPanel_update_display_buffer(s_loop_counter);
-    PRA32_U2_ControlPanel_update_display(s_loop_counter);
+    // The control panel is updated as often as before, once per sample of the processed block
+    for (uint32_t i = 0; i < PRA32_U2_I2S_BUFFER_WORDS; i++) {
+      static uint32_t s_loop_counter = 0;
+      s_loop_counter++;
+      if (s_loop_counter >= 16 * 400) {
+        s_loop_counter = 0;
+      }
+
+      PRA32_U2_ControlPanel_update_analog_inputs(s_loop_counter);
+      PRA32_U2_ControlPanel_update_display_buffer(s_loop_counter);
+      PRA32_U2_ControlPanel_update_display(s_loop_counter);
 
 #if defined(PRA32_U2_USE_DEBUG_PRINT)
-    switch (s_loop_counter) {
-    case  1 * 400:
-      PRA32_U2_DEBUG_PRINT_SERIAL.print("\e[1;1H\e[K");
-      PRA32_U2_DEBUG_PRINT_SERIAL.print(s_debug_measurement_elapsed1_us);
-      break;
-    case  2 * 400:
-      PRA32_U2_DEBUG_PRINT_SERIAL.print("\e[2;1H\e[K");
-      PRA32_U2_DEBUG_PRINT_SERIAL.print(s_debug_measurement_max1_us);
-      break;
-    case  3 * 400:
-      PRA32_U2_DEBUG_PRINT_SERIAL.print("\e[4;1H\e[K");
-      PRA32_U2_DEBUG_PRINT_SERIAL.print(s_debug_measurement_elapsed0_us);
-      break;
-    case  4 * 400:
-      PRA32_U2_DEBUG_PRINT_SERIAL.print("\e[5;1H\e[K");
-      PRA32_U2_DEBUG_PRINT_SERIAL.print(s_debug_measurement_max0_us);
-      break;
-    default:
-      PRA32_U2_ControlPanel_debug_print(s_loop_counter);
-      break;
-    }
+      switch (s_loop_counter) {
+      case  1 * 400:
+        PRA32_U2_DEBUG_PRINT_SERIAL.print("\e[1;1H\e[K");
+        PRA32_U2_DEBUG_PRINT_SERIAL.print(s_debug_measurement_elapsed1_us);
+        break;
+      case  2 * 400:
+        PRA32_U2_DEBUG_PRINT_SERIAL.print("\e[2;1H\e[K");
+        PRA32_U2_DEBUG_PRINT_SERIAL.print(s_debug_measurement_max1_us);
+        break;
+      case  3 * 400:
+        PRA32_U2_DEBUG_PRINT_SERIAL.print("\e[4;1H\e[K");
+        PRA32_U2_DEBUG_PRINT_SERIAL.print(s_debug_measurement_elapsed0_us);
+        break;
+      case  4 * 400:
+        PRA32_U2_DEBUG_PRINT_SERIAL.print("\e[5;1H\e[K");
+        PRA32_U2_DEBUG_PRINT_SERIAL.print(s_debug_measurement_max0_us);
+        break;
+      default:
+        PRA32_U2_ControlPanel_debug_print(s_loop_counter);
+        break;
+      }
 #endif  // defined(PRA32_U2_USE_DEBUG_PRINT)
+    }
   }
 }
 
@@ -301,9 +304,7 @@ void __not_in_flash_func(loop)() {
 
   int16_t left_buffer[PRA32_U2_I2S_BUFFER_WORDS];
   int16_t right_buffer[PRA32_U2_I2S_BUFFER_WORDS];
-  for (uint32_t i = 0; i < PRA32_U2_I2S_BUFFER_WORDS; i++) {
-    left_buffer[i] = g_synth.process(right_buffer[i]);
-  }
+  g_synth.render_block(left_buffer, right_buffer, PRA32_U2_I2S_BUFFER_WORDS);
 
 #if defined(PRA32_U2_USE_DEBUG_PRINT)
   uint32_t debug_measurement_end_us = micros();
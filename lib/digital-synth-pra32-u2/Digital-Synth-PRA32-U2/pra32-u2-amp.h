@@ -47,6 +47,11 @@ PRA32_U2_Amp()
     update_breath_controller_effective();
   }
 
+  // Skips the gain smoothing, for a voice that has not been processed for a while
+  INLINE void reset() {
+    m_gain_control_effective = m_gain_control;
+  }
+
   INLINE int32_t process(int32_t audio_input_int24) {
     int32_t audio_output = audio_input_int24;
     audio_output = mul_s32_s32_h16(audio_output, m_gain_mod_input     << 2);
@@ -5,7 +5,7 @@
 class PRA32_U2_ChorusFx {
   static const uint16_t DELAY_BUFF_SIZE = 512;
 
-  int32_t  m_delay_buff[2][DELAY_BUFF_SIZE];
+  delay_sample_t m_delay_buff[2][DELAY_BUFF_SIZE];
   uint16_t m_delay_wp[2];
 
   uint16_t m_chorus_mix_control;
@@ -18,6 +18,8 @@ class PRA32_U2_ChorusFx {
   uint8_t  m_chorus_depth_control_actual;
   uint32_t m_chorus_lfo_phase;
   uint16_t m_chorus_delay_time[2];
+  boolean  m_bypassed;
+  uint8_t  m_warm_up_count;
 
 public:
   PRA32_U2_ChorusFx()
@@ -33,6 +35,8 @@ public:
   , m_chorus_delay_time_control_effective()
   , m_chorus_lfo_phase()
   , m_chorus_delay_time()
+  , m_bypassed(true)
+  , m_warm_up_count()
   {
     m_delay_wp[0] = DELAY_BUFF_SIZE - 1;
     m_delay_wp[1] = DELAY_BUFF_SIZE - 1;
@@ -74,8 +78,28 @@ public:
 #if 1
     static_cast<void>(count);
 
-    m_chorus_mix_control_effective += (m_chorus_mix_control_effective < m_chorus_mix_control);
-    m_chorus_mix_control_effective -= (m_chorus_mix_control_effective > m_chorus_mix_control);
+    if (m_bypassed) {
+      if (m_chorus_mix_control == 0) {
+        return;
+      }
+
+      // The buffer holds stale audio from before the bypass, so keep the output dry
+      // until it has been refilled, then fade the effect in with the mix glide
+      m_bypassed = false;
+      m_warm_up_count = DELAY_BUFF_SIZE / 4;
+      m_chorus_depth_control_effective = m_chorus_depth_control;
+      m_chorus_delay_time_control_effective = m_chorus_delay_time_control;
+    }
+
+    if (m_warm_up_count != 0) {
+      --m_warm_up_count;
+    } else {
+      m_chorus_mix_control_effective += (m_chorus_mix_control_effective < m_chorus_mix_control);
+      m_chorus_mix_control_effective -= (m_chorus_mix_control_effective > m_chorus_mix_control);
+
+      // Bypass once the mix has faded out
+      m_bypassed = (m_chorus_mix_control == 0) && (m_chorus_mix_control_effective == 0);
+    }
 
     m_chorus_depth_control_effective += (m_chorus_depth_control_effective < m_chorus_depth_control);
     m_chorus_depth_control_effective -= (m_chorus_depth_control_effective > m_chorus_depth_control);
@@ -111,6 +135,11 @@ public:
   }
 
   INLINE int32_t process(int32_t left_input_int24, int32_t right_input_int24, int32_t& right_output_int24) {
+    if (m_bypassed) {
+      right_output_int24 = right_input_int24;
+      return               left_input_int24;
+    }
+
     int32_t eff_sample_0 = delay_buff_get(0, get_chorus_delay_time<0>());
     int32_t eff_sample_1 = delay_buff_get(1, get_chorus_delay_time<1>());
     delay_buff_push(0, left_input_int24);
@@ -123,15 +152,15 @@ public:
 private:
   INLINE void delay_buff_push(uint32_t lr, int32_t audio_input_int24) {
     m_delay_wp[lr] = (m_delay_wp[lr] + 1) & (DELAY_BUFF_SIZE - 1);
-    m_delay_buff[lr][m_delay_wp[lr]] = audio_input_int24;
+    m_delay_buff[lr][m_delay_wp[lr]] = pack_delay_sample(audio_input_int24);
   }
 
   INLINE int32_t delay_buff_get(uint32_t lr, uint16_t sample_delay) {
     uint16_t curr_index  = (m_delay_wp[lr] - (sample_delay >> 4)) & (DELAY_BUFF_SIZE - 1);
     uint16_t next_index  = (curr_index - 1) & (DELAY_BUFF_SIZE - 1);
     uint16_t next_weight = (sample_delay & 0xF);
-    int32_t  curr_data   = m_delay_buff[lr][curr_index];
-    int32_t  next_data   = m_delay_buff[lr][next_index];
+    int32_t  curr_data   = unpack_delay_sample(m_delay_buff[lr][curr_index]);
+    int32_t  next_data   = unpack_delay_sample(m_delay_buff[lr][next_index]);
 
     // lerp
     int32_t result = curr_data + mul_s32_u16_h32(next_data - curr_data, next_weight << 12u);
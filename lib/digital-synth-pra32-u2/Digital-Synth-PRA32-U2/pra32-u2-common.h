@@ -9,6 +9,32 @@ typedef int32_t __int24;
 typedef uint32_t __uint24;
 #endif
 
+#if defined(PRA32_U2_USE_16_BIT_DELAY_BUFFERS)
+// Delay lines keep 16-bit samples, one LSB of which is one LSB of the 16-bit output
+typedef int16_t delay_sample_t;
+
+static INLINE delay_sample_t pack_delay_sample(int32_t x) {
+  int32_t y = (x + (1 << 6)) >> 7;
+  y = (y > INT16_MAX) ? INT16_MAX : y;
+  y = (y < INT16_MIN) ? INT16_MIN : y;
+  return y;
+}
+
+static INLINE int32_t unpack_delay_sample(delay_sample_t x) {
+  return x * (1 << 7);
+}
+#else  // defined(PRA32_U2_USE_16_BIT_DELAY_BUFFERS)
+typedef int32_t delay_sample_t;
+
+static INLINE delay_sample_t pack_delay_sample(int32_t x) {
+  return x;
+}
+
+static INLINE int32_t unpack_delay_sample(delay_sample_t x) {
+  return x;
+}
+#endif  // defined(PRA32_U2_USE_16_BIT_DELAY_BUFFERS)
+
 static INLINE uint8_t low_byte(uint16_t x) {
   return x & 0xFF;
 }
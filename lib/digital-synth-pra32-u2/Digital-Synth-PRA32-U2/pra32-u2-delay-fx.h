@@ -4,8 +4,9 @@
 
 class PRA32_U2_DelayFx {
   static const uint16_t DELAY_BUFF_SIZE = 16384;
+  static const int32_t  TAIL_SILENCE_LEVEL = 64; // Below 1 LSB of the 16-bit output
 
-  int32_t  m_delay_buff[2][DELAY_BUFF_SIZE];
+  delay_sample_t m_delay_buff[2][DELAY_BUFF_SIZE];
   uint16_t m_delay_wp[2];
 
   uint16_t m_delay_level;
@@ -15,6 +16,9 @@ class PRA32_U2_DelayFx {
   uint16_t m_delay_time;
   uint16_t m_delay_time_effective;
   uint8_t  m_delay_mode;
+  boolean  m_bypassed;
+  uint16_t m_tail_silent_samples;
+  uint16_t m_fresh_samples;
 
 public:
   PRA32_U2_DelayFx()
@@ -28,6 +32,9 @@ public:
   , m_delay_time()
   , m_delay_time_effective()
   , m_delay_mode()
+  , m_bypassed(true)
+  , m_tail_silent_samples()
+  , m_fresh_samples()
   {
     m_delay_wp[0] = DELAY_BUFF_SIZE - 1;
     m_delay_wp[1] = DELAY_BUFF_SIZE - 1;
@@ -75,6 +82,19 @@ public:
   }
 
   INLINE void process_at_low_rate(uint8_t count) {
+    if (m_bypassed) {
+      if (m_delay_level == 0) {
+        return;
+      }
+
+      // Whatever is left in the buffer is below TAIL_SILENCE_LEVEL, treat it as silence
+      // (see delay_buff_get()) and fade the sends in with the level glide
+      m_bypassed = false;
+      m_fresh_samples = 0;
+      m_delay_feedback_effective = m_delay_feedback;
+      m_delay_time_effective = m_delay_time;
+    }
+
     m_delay_level_effective += (m_delay_level_effective < m_delay_level);
     m_delay_level_effective -= (m_delay_level_effective > m_delay_level);
 
@@ -85,9 +105,21 @@ public:
       m_delay_time_effective += (m_delay_time_effective < m_delay_time);
       m_delay_time_effective -= (m_delay_time_effective > m_delay_time);
     }
+
+    // Bypass once the sends have faded out and the tail has decayed through the whole buffer
+    if (m_delay_level_effective != 0) {
+      m_tail_silent_samples = 0;
+    } else if ((m_delay_level == 0) && (m_tail_silent_samples >= DELAY_BUFF_SIZE)) {
+      m_bypassed = true;
+    }
   }
 
   INLINE int32_t process(int32_t left_input_int24, int32_t right_input_int24, int32_t& right_output_int24) {
+    if (m_bypassed) {
+      right_output_int24 = right_input_int24;
+      return               left_input_int24;
+    }
+
     int32_t left_delay   = delay_buff_get<0>(m_delay_time_effective);
     int32_t right_delay  = delay_buff_get<1>(m_delay_time_effective);
 
@@ -109,6 +141,13 @@ public:
 
     delay_buff_push<0>(left_feedback);
     delay_buff_push<1>(right_feedback);
+    m_fresh_samples += (m_fresh_samples < DELAY_BUFF_SIZE);
+
+    if (m_delay_level_effective == 0) {
+      boolean silent = (static_cast<uint32_t>(left_feedback  + TAIL_SILENCE_LEVEL) <= (2 * TAIL_SILENCE_LEVEL)) &
+                       (static_cast<uint32_t>(right_feedback + TAIL_SILENCE_LEVEL) <= (2 * TAIL_SILENCE_LEVEL));
+      m_tail_silent_samples = (m_tail_silent_samples + (m_tail_silent_samples < DELAY_BUFF_SIZE)) * silent;
+    }
 
     right_output_int24 = right_input_int24 + right_delay;
     return               left_input_int24  + left_delay;
@@ -118,12 +157,14 @@ private:
   template <uint8_t N>
   INLINE void delay_buff_push(int32_t audio_input) {
     m_delay_wp[N] = (m_delay_wp[N] + 1) & (DELAY_BUFF_SIZE - 1);
-    m_delay_buff[N][m_delay_wp[N]] = audio_input;
+    m_delay_buff[N][m_delay_wp[N]] = pack_delay_sample(audio_input);
   }
 
   template <uint8_t N>
   INLINE int32_t delay_buff_get(uint16_t sample_delay) {
     uint16_t delay_rp = (m_delay_wp[N] - sample_delay) & (DELAY_BUFF_SIZE - 1);
-    return m_delay_buff[N][delay_rp];
+
+    // Samples written before the last bypass read as silence
+    return unpack_delay_sample(m_delay_buff[N][delay_rp]) * (sample_delay < m_fresh_samples);
   }
 };
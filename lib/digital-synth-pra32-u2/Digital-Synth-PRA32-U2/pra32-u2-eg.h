@@ -85,6 +85,11 @@ public:
     return m_level_out;
   }
 
+  // True if the EG has been released and its output has fallen to silence_level or below
+  INLINE boolean is_silent(int16_t silence_level) {
+    return (m_state == STATE_IDLE) && (m_level_out <= silence_level);
+  }
+
   INLINE void process_at_low_rate() {
 #if 1
     switch (m_state) {
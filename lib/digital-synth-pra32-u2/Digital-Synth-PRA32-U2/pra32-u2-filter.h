@@ -119,6 +119,18 @@ public:
     update_coefs(eg_input, lfo_input, osc_pitch);
   }
 
+  // Clears the history and skips the cutoff smoothing, for a voice that has
+  // not been processed for a while
+  INLINE void reset(int16_t eg_input, int16_t lfo_input, uint16_t osc_pitch) {
+    m_x_1 = 0;
+    m_x_2 = 0;
+    m_y_1 = 0;
+    m_y_2 = 0;
+
+    m_cutoff_control_effective = m_cutoff_control;
+    m_cutoff_current = get_cutoff_target(eg_input, lfo_input, osc_pitch);
+  }
+
   INLINE int32_t process(int32_t audio_input_int24) {
 #if 1
     int32_t x_0 = audio_input_int24;
@@ -150,7 +162,7 @@ private:
     m_cutoff_control_effective -= (m_cutoff_control_effective > m_cutoff_control);
   }
 
-  INLINE void update_coefs(int16_t eg_input, int16_t lfo_input, uint16_t osc_pitch) {
+  INLINE int16_t get_cutoff_target(int16_t eg_input, int16_t lfo_input, uint16_t osc_pitch) {
     int16_t cutoff_candidate = m_cutoff_control_effective;
     cutoff_candidate += (m_cutoff_eg_amt[0] * eg_input) >> (14 - 2);
     cutoff_candidate += (m_cutoff_eg_amt[1] * eg_input) >> (14 - 2);
@@ -165,6 +177,12 @@ private:
     cutoff_target = (cutoff_target < 0) * cutoff_target + ((254 << 2) + 1);
     cutoff_target = (cutoff_target > 0) * cutoff_target;
 
+    return cutoff_target;
+  }
+
+  INLINE void update_coefs(int16_t eg_input, int16_t lfo_input, uint16_t osc_pitch) {
+    int16_t cutoff_target = get_cutoff_target(eg_input, lfo_input, osc_pitch);
+
     for (uint32_t i = 0; i < (4 * 2); ++i) {
       m_cutoff_current += (m_cutoff_current < cutoff_target);
       m_cutoff_current -= (m_cutoff_current > cutoff_target);
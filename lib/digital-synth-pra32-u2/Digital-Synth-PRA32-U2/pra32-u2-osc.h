@@ -11,6 +11,7 @@
 #include "pra32-u2-osc-wave-shape-table-5.h"
 #include <math.h>
 
+template <uint8_t VOICES>
 class PRA32_U2_Osc {
   static const uint8_t OSC_MIX_TABLE_LENGTH   = 65;
 
@@ -24,7 +25,7 @@ class PRA32_U2_Osc {
   static const uint8_t WAVEFORM_1_PULSE       = 5;
   static const uint8_t WAVEFORM_2_NOISE       = 6;
 
-  uint32_t       m_portamento_coef[4];
+  uint32_t       m_portamento_coef[VOICES];
   int16_t        m_pitch_eg_amt[2];
   int16_t        m_pitch_lfo_amt[2];
 
@@ -32,35 +33,35 @@ class PRA32_U2_Osc {
   int16_t        m_pitch_bend;
   uint8_t        m_pitch_bend_range;
   int16_t        m_pitch_bend_normalized;
-  uint32_t       m_pitch_target[4];
-  uint32_t       m_pitch_current[4];
-  const int16_t* m_wave_table[4 * 5];
-  const int16_t* m_wave_table_temp[4 * 5];
-  uint32_t       m_freq[4 * 2];
-  uint32_t       m_freq_base[4 * 2];
-  int16_t        m_freq_offset[4 * 2];
-  uint32_t       m_phase[4 * 2];
-  uint32_t       m_phase_shape_morph[4];
-  boolean        m_osc_on[4];
-  int8_t         m_osc_gain_effective[4];
+  uint32_t       m_pitch_target[VOICES];
+  uint32_t       m_pitch_current[VOICES];
+  const int16_t* m_wave_table[VOICES * 5];
+  const int16_t* m_wave_table_temp[VOICES * 5];
+  uint32_t       m_freq[VOICES * 2];
+  uint32_t       m_freq_base[VOICES * 2];
+  int16_t        m_freq_offset[VOICES * 2];
+  uint32_t       m_phase[VOICES * 2];
+  uint32_t       m_phase_shape_morph[VOICES];
+  boolean        m_osc_on[VOICES];
+  int8_t         m_osc_gain_effective[VOICES];
   int8_t         m_osc_level;
 
   boolean        m_gate_enabled;
   uint8_t        m_mixer_osc_mix_control;
-  uint8_t        m_mixer_osc_mix_control_effective;
+  uint8_t        m_mixer_osc_mix_control_effective[VOICES];
   int8_t         m_osc2_pitch;
   int16_t        m_osc2_detune;
 
   uint8_t        m_phase_high;
   uint16_t       m_osc1_shape_control;
-  uint16_t       m_osc1_shape_control_effective;
+  uint16_t       m_osc1_shape_control_effective[VOICES];
   uint16_t       m_osc1_morph_control;
-  uint16_t       m_osc1_morph_control_effective;
-  int32_t        m_osc1_shape[4];
-  int32_t        m_osc1_shape_effective[4];
-  uint16_t       m_osc1_phase_modulation_frequency_ratio[4];
+  uint16_t       m_osc1_morph_control_effective[VOICES];
+  int32_t        m_osc1_shape[VOICES];
+  int32_t        m_osc1_shape_effective[VOICES];
+  uint16_t       m_osc1_phase_modulation_frequency_ratio[VOICES];
   int8_t         m_mixer_noise_sub_osc_control;
-  int8_t         m_mixer_noise_sub_osc_control_effective;
+  int8_t         m_mixer_noise_sub_osc_control_effective[VOICES];
   int16_t        m_mix_table[OSC_MIX_TABLE_LENGTH];
   int16_t        m_shape_eg_amt;
   int16_t        m_shape_lfo_amt;
@@ -108,11 +109,6 @@ public:
   , m_shape_eg_amt()
   , m_shape_lfo_amt()
   {
-    m_portamento_coef[0] = 0;
-    m_portamento_coef[1] = 0;
-    m_portamento_coef[2] = 0;
-    m_portamento_coef[3] = 0;
-
     set_gate_enabled (false);
     set_mixer_osc_mix(0);
     set_osc2_pitch   (0);
@@ -120,81 +116,23 @@ public:
 
     m_waveform[0] = WAVEFORM_SAW;
     m_waveform[1] = WAVEFORM_SAW;
-    m_pitch_target[0] = 60 << 24;
-    m_pitch_target[1] = 60 << 24;
-    m_pitch_target[2] = 60 << 24;
-    m_pitch_target[3] = 60 << 24;
-    m_pitch_current[0] = m_pitch_target[0];
-    m_pitch_current[1] = m_pitch_target[1];
-    m_pitch_current[2] = m_pitch_target[2];
-    m_pitch_current[3] = m_pitch_target[3];
-    m_wave_table[0] = g_osc_saw_wave_tables[0];
-    m_wave_table[1] = g_osc_saw_wave_tables[0];
-    m_wave_table[2] = g_osc_saw_wave_tables[0];
-    m_wave_table[3] = g_osc_saw_wave_tables[0];
-    m_wave_table[4] = g_osc_saw_wave_tables[0];
-    m_wave_table[5] = g_osc_saw_wave_tables[0];
-    m_wave_table[6] = g_osc_saw_wave_tables[0];
-    m_wave_table[7] = g_osc_saw_wave_tables[0];
-    m_wave_table[8] = g_osc_saw_wave_tables[0];
-    m_wave_table[9] = g_osc_saw_wave_tables[0];
-    m_wave_table[10] = g_osc_saw_wave_tables[0];
-    m_wave_table[11] = g_osc_saw_wave_tables[0];
-    m_wave_table[12] = g_osc_saw_wave_tables[0];
-    m_wave_table[13] = g_osc_saw_wave_tables[0];
-    m_wave_table[14] = g_osc_saw_wave_tables[0];
-    m_wave_table[15] = g_osc_saw_wave_tables[0];
-    m_wave_table[16] = g_osc_saw_wave_tables[0];
-    m_wave_table[17] = g_osc_saw_wave_tables[0];
-    m_wave_table[18] = g_osc_saw_wave_tables[0];
-    m_wave_table[19] = g_osc_saw_wave_tables[0];
-    m_wave_table_temp[0] = g_osc_saw_wave_tables[0];
-    m_wave_table_temp[1] = g_osc_saw_wave_tables[0];
-    m_wave_table_temp[2] = g_osc_saw_wave_tables[0];
-    m_wave_table_temp[3] = g_osc_saw_wave_tables[0];
-    m_wave_table_temp[4] = g_osc_saw_wave_tables[0];
-    m_wave_table_temp[5] = g_osc_saw_wave_tables[0];
-    m_wave_table_temp[6] = g_osc_saw_wave_tables[0];
-    m_wave_table_temp[7] = g_osc_saw_wave_tables[0];
-    m_wave_table_temp[8] = g_osc_saw_wave_tables[0];
-    m_wave_table_temp[9] = g_osc_saw_wave_tables[0];
-    m_wave_table_temp[10] = g_osc_saw_wave_tables[0];
-    m_wave_table_temp[11] = g_osc_saw_wave_tables[0];
-    m_wave_table_temp[12] = g_osc_saw_wave_tables[0];
-    m_wave_table_temp[13] = g_osc_saw_wave_tables[0];
-    m_wave_table_temp[14] = g_osc_saw_wave_tables[0];
-    m_wave_table_temp[15] = g_osc_saw_wave_tables[0];
-    m_wave_table_temp[16] = g_osc_saw_wave_tables[0];
-    m_wave_table_temp[17] = g_osc_saw_wave_tables[0];
-    m_wave_table_temp[18] = g_osc_saw_wave_tables[0];
-    m_wave_table_temp[19] = g_osc_saw_wave_tables[0];
-    m_freq[0] = g_osc_freq_table[0];
-    m_freq[1] = g_osc_freq_table[0];
-    m_freq[2] = g_osc_freq_table[0];
-    m_freq[3] = g_osc_freq_table[0];
-    m_freq[4] = g_osc_freq_table[0];
-    m_freq[5] = g_osc_freq_table[0];
-    m_freq[6] = g_osc_freq_table[0];
-    m_freq[7] = g_osc_freq_table[0];
-    m_freq_base[0] = g_osc_freq_table[0];
-    m_freq_base[1] = g_osc_freq_table[0];
-    m_freq_base[2] = g_osc_freq_table[0];
-    m_freq_base[3] = g_osc_freq_table[0];
-    m_freq_base[4] = g_osc_freq_table[0];
-    m_freq_base[5] = g_osc_freq_table[0];
-    m_freq_base[6] = g_osc_freq_table[0];
-    m_freq_base[7] = g_osc_freq_table[0];
+    for (uint8_t voice = 0; voice < VOICES; ++voice) {
+      m_portamento_coef[voice] = 0;
+      m_pitch_target[voice] = 60 << 24;
+      m_pitch_current[voice] = m_pitch_target[voice];
+      m_osc1_shape[voice]           = 0;
+      m_osc1_shape_effective[voice] = 0;
+    }
+    for (uint8_t i = 0; i < VOICES * 5; ++i) {
+      m_wave_table[i] = g_osc_saw_wave_tables[0];
+      m_wave_table_temp[i] = g_osc_saw_wave_tables[0];
+    }
+    for (uint8_t i = 0; i < VOICES * 2; ++i) {
+      m_freq[i] = g_osc_freq_table[0];
+      m_freq_base[i] = g_osc_freq_table[0];
+    }
     m_osc_level = 72;
 
-    m_osc1_shape[0]           = 0;
-    m_osc1_shape[1]           = 0;
-    m_osc1_shape[2]           = 0;
-    m_osc1_shape[3]           = 0;
-    m_osc1_shape_effective[0] = 0;
-    m_osc1_shape_effective[1] = 0;
-    m_osc1_shape_effective[2] = 0;
-    m_osc1_shape_effective[3] = 0;
-
     for (uint8_t i = 0; i < OSC_MIX_TABLE_LENGTH; ++i) {
       m_mix_table[i] = static_cast<int16_t>(sqrtf(static_cast<float>(i) /
                                             (OSC_MIX_TABLE_LENGTH - 1)) * (1 << 10));
@@ -203,8 +141,7 @@ public:
     set_pitch_bend_range(2);
   }
 
-  template <uint8_t N>
-  INLINE void set_osc_waveform(uint8_t controller_value) {
+  INLINE void set_osc_waveform(uint8_t index, uint8_t controller_value) {
     static uint8_t waveform_tables[2][6] = {
       {
         WAVEFORM_SAW,
@@ -224,13 +161,13 @@ public:
       },
     };
 
-    volatile int32_t index = ((controller_value * 10) + 127) / 254;
+    volatile int32_t waveform_index = ((controller_value * 10) + 127) / 254;
 
-    // index = min(index, 5)
-    index = index - 5;
-    index = (index < 0) * index + 5;
+    // waveform_index = min(waveform_index, 5)
+    waveform_index = waveform_index - 5;
+    waveform_index = (waveform_index < 0) * waveform_index + 5;
 
-    m_waveform[N] = waveform_tables[N][index];
+    m_waveform[index] = waveform_tables[index][waveform_index];
   }
 
   INLINE void set_osc1_shape_control(uint8_t controller_value) {
@@ -278,9 +215,8 @@ public:
     return pitch_mod_amt_table[controller_value];
   }
 
-  template <uint8_t N>
-  INLINE void set_pitch_eg_amt(uint8_t controller_value) {
-    m_pitch_eg_amt[N] = get_pitch_mod_amt_table(controller_value);
+  INLINE void set_pitch_eg_amt(uint8_t index, uint8_t controller_value) {
+    m_pitch_eg_amt[index] = get_pitch_mod_amt_table(controller_value);
   }
 
   INLINE void set_shape_eg_amt(uint8_t controller_value) {
@@ -293,9 +229,8 @@ public:
     m_shape_eg_amt = ((controller_value - 64) << 1);
   }
 
-  template <uint8_t N>
-  INLINE void set_pitch_lfo_amt(uint8_t controller_value) {
-    m_pitch_lfo_amt[N] = get_pitch_mod_amt_table(controller_value);
+  INLINE void set_pitch_lfo_amt(uint8_t index, uint8_t controller_value) {
+    m_pitch_lfo_amt[index] = get_pitch_mod_amt_table(controller_value);
   }
 
   INLINE void set_shape_lfo_amt(uint8_t controller_value) {
@@ -349,13 +284,11 @@ public:
     m_osc2_detune = m_osc2_detune_table[controller_value];
   }
 
-  template <uint8_t N>
-  INLINE void set_portamento(uint8_t controller_value) {
-    m_portamento_coef[N] = g_portamento_coef_table[controller_value];
+  INLINE void set_portamento(uint8_t voice, uint8_t controller_value) {
+    m_portamento_coef[voice] = g_portamento_coef_table[controller_value];
   }
 
-  template <uint8_t N>
-  INLINE void note_on(uint8_t note_number) {
+  INLINE void note_on(uint8_t voice, uint8_t note_number) {
     uint8_t n;
     if (note_number < NOTE_NUMBER_MIN) {
       n = NOTE_NUMBER_MIN;
@@ -365,16 +298,15 @@ public:
       n = note_number;
     }
 
-    m_pitch_target[N] = (n << 24);
-    if (m_portamento_coef[N] == 0) {
-      m_pitch_current[N] = m_pitch_target[N];
+    m_pitch_target[voice] = (n << 24);
+    if (m_portamento_coef[voice] == 0) {
+      m_pitch_current[voice] = m_pitch_target[voice];
     }
-    m_osc_on[N] = true;
+    m_osc_on[voice] = true;
   }
 
-  template <uint8_t N>
-  INLINE void note_off() {
-    m_osc_on[N] = false;
+  INLINE void note_off(uint8_t voice) {
+    m_osc_on[voice] = false;
   }
 
   INLINE void set_pitch_bend_range(uint8_t controller_value) {
@@ -404,56 +336,56 @@ public:
     return osc_pitch;
   }
 
-  template <uint8_t N>
-  INLINE void process_at_low_rate_a(int16_t lfo_level, int16_t eg_level) {
-    update_pitch_current<N>();
-    update_osc1_shape<N>(lfo_level, eg_level);
-    update_osc1_shape_effective<N>();
-    update_freq_base<N + 0>(lfo_level, eg_level);
-    update_freq_base<N + 4>(lfo_level, eg_level);
+  // Skips the shape smoothing, for a voice that has not been processed for a while
+  INLINE void reset(uint8_t voice, int16_t lfo_level, int16_t eg_level) {
+    update_osc1_shape(voice, lfo_level, eg_level);
+    m_osc1_shape_effective[voice] = m_osc1_shape[voice];
+  }
+
+  INLINE void process_at_low_rate_a(uint8_t voice, int16_t lfo_level, int16_t eg_level) {
+    update_pitch_current(voice);
+    update_osc1_shape(voice, lfo_level, eg_level);
+    update_osc1_shape_effective(voice);
+    update_freq_base<0>(voice, lfo_level, eg_level);
+    update_freq_base<1>(voice, lfo_level, eg_level);
   }
 
   INLINE void process_at_low_rate_b(uint8_t count, int16_t noise_int15) {
-    switch (count & (0x08 - 1)) {
-    case 0x00:
-      update_freq_offset<0>(noise_int15);
-      update_gate<0>();
-      break;
-    case 0x01:
-      update_freq_offset<4>(noise_int15);
-      break;
-    case 0x02:
-      update_freq_offset<1>(noise_int15);
-      update_gate<1>();
-      break;
+    for (uint8_t voice = 0; voice < VOICES; ++voice) {
+      process_at_low_rate_b(voice, count, noise_int15);
+    }
+  }
+
+  // The share of process_at_low_rate_b() that belongs to one voice. The smoothed
+  // controls are kept per voice, so that each voice can be updated on its own
+  // (e.g. on another core) with the same result. Voices share the 8-step
+  // cycle in groups of four, like they share the 4-sample control period.
+  INLINE void process_at_low_rate_b(uint8_t voice, uint8_t count, int16_t noise_int15) {
+    const uint8_t step = count & (0x08 - 1);
+    const uint8_t voice_step = (voice & 0x03) * 2;
+
+    if (step == voice_step + 0) {
+      update_freq_offset<0>(voice, noise_int15);
+      update_gate(voice);
+    } else if (step == voice_step + 1) {
+      update_freq_offset<1>(voice, noise_int15);
+    }
+
+    switch (step) {
     case 0x03:
-      update_freq_offset<5>(noise_int15);
-      update_mixer_control_effective();
-      break;
-    case 0x04:
-      update_freq_offset<2>(noise_int15);
-      update_gate<2>();
-      break;
-    case 0x05:
-      update_freq_offset<6>(noise_int15);
-      break;
-    case 0x06:
-      update_freq_offset<3>(noise_int15);
-      update_gate<3>();
+      update_mixer_control_effective(voice);
       break;
     case 0x07:
-      update_freq_offset<7>(noise_int15);
-      update_osc1_morph_control_effective();
+      update_osc1_morph_control_effective(voice);
       break;
     }
 
-    update_osc1_shape_control_effective();
+    update_osc1_shape_control_effective(voice);
   }
 
-  template <uint8_t N>
-  INLINE int32_t process(int16_t noise_int15) {
+  INLINE int32_t process(uint8_t voice, int16_t noise_int15) {
 #if 1
-    return process_osc<N>(noise_int15);
+    return process_osc(voice, noise_int15);
 #else
     return = 0;
 #endif
@@ -508,197 +440,193 @@ private:
     return data;
   }
 
-  template <uint8_t N>
-  INLINE int32_t process_osc(int16_t noise_int15) {
+  INLINE int32_t process_osc(uint8_t voice, int16_t noise_int15) {
     int32_t result = 0;
 
-    int16_t osc1_gain = m_mix_table[(OSC_MIX_TABLE_LENGTH - 1) - (m_mixer_osc_mix_control_effective >> 1)];
-    int16_t osc2_gain = m_mix_table[                             (m_mixer_osc_mix_control_effective >> 1)];
+    int16_t osc1_gain = m_mix_table[(OSC_MIX_TABLE_LENGTH - 1) - (m_mixer_osc_mix_control_effective[voice] >> 1)];
+    int16_t osc2_gain = m_mix_table[                             (m_mixer_osc_mix_control_effective[voice] >> 1)];
 
-    m_phase[N] += m_freq[N];
-    boolean new_period_osc1 = (m_phase[N] & 0x00FFFFFF) < m_freq[N]; // crossing the begin of a osc 1 wave, the begin or the middle of a sub osc wave
-    m_wave_table[N]      = reinterpret_cast<const int16_t*>((reinterpret_cast<const uintptr_t>(m_wave_table[N]) * (1 - new_period_osc1)));
-    m_wave_table[N]      = reinterpret_cast<const int16_t*>( reinterpret_cast<const uint8_t*>( m_wave_table[N]) +
-                                                            (reinterpret_cast<const uintptr_t>(m_wave_table_temp[N]) * new_period_osc1));
+    m_phase[voice] += m_freq[voice];
+    boolean new_period_osc1 = (m_phase[voice] & 0x00FFFFFF) < m_freq[voice]; // crossing the begin of a osc 1 wave, the begin or the middle of a sub osc wave
+    m_wave_table[voice]                = reinterpret_cast<const int16_t*>((reinterpret_cast<const uintptr_t>(m_wave_table[voice]) * (1 - new_period_osc1)));
+    m_wave_table[voice]                = reinterpret_cast<const int16_t*>( reinterpret_cast<const uint8_t*>( m_wave_table[voice]) +
+                                                            (reinterpret_cast<const uintptr_t>(m_wave_table_temp[voice]) * new_period_osc1));
 
-    m_wave_table[N + 12] = reinterpret_cast<const int16_t*>((reinterpret_cast<const uintptr_t>(m_wave_table[N + 12]) * (1 - new_period_osc1)));
-    m_wave_table[N + 12] = reinterpret_cast<const int16_t*>( reinterpret_cast<const uint8_t*>( m_wave_table[N + 12]) +
-                                                            (reinterpret_cast<const uintptr_t>(m_wave_table_temp[N + 12]) * new_period_osc1));
+    m_wave_table[voice + (VOICES * 3)] = reinterpret_cast<const int16_t*>((reinterpret_cast<const uintptr_t>(m_wave_table[voice + (VOICES * 3)]) * (1 - new_period_osc1)));
+    m_wave_table[voice + (VOICES * 3)] = reinterpret_cast<const int16_t*>( reinterpret_cast<const uint8_t*>( m_wave_table[voice + (VOICES * 3)]) +
+                                                            (reinterpret_cast<const uintptr_t>(m_wave_table_temp[voice + (VOICES * 3)]) * new_period_osc1));
 
-    m_wave_table[N + 16] = reinterpret_cast<const int16_t*>((reinterpret_cast<const uintptr_t>(m_wave_table[N + 16]) * (1 - new_period_osc1)));
-    m_wave_table[N + 16] = reinterpret_cast<const int16_t*>( reinterpret_cast<const uint8_t*>( m_wave_table[N + 16]) +
-                                                            (reinterpret_cast<const uintptr_t>(m_wave_table_temp[N + 16]) * new_period_osc1));
+    m_wave_table[voice + (VOICES * 4)] = reinterpret_cast<const int16_t*>((reinterpret_cast<const uintptr_t>(m_wave_table[voice + (VOICES * 4)]) * (1 - new_period_osc1)));
+    m_wave_table[voice + (VOICES * 4)] = reinterpret_cast<const int16_t*>( reinterpret_cast<const uint8_t*>( m_wave_table[voice + (VOICES * 4)]) +
+                                                            (reinterpret_cast<const uintptr_t>(m_wave_table_temp[voice + (VOICES * 4)]) * new_period_osc1));
 
     if (m_waveform[0] == WAVEFORM_SINE) {
       // For Sine Wave (wave_3)
 
-      // phase_modulation_depth_candidate = max(m_osc1_shape_effective[N] - (128 << 8), 0)
-      volatile int32_t phase_modulation_depth_candidate = m_osc1_shape_effective[N] - (128 << 8);
+      // phase_modulation_depth_candidate = max(m_osc1_shape_effective[voice] - (128 << 8), 0)
+      volatile int32_t phase_modulation_depth_candidate = m_osc1_shape_effective[voice] - (128 << 8);
       phase_modulation_depth_candidate = (phase_modulation_depth_candidate > 0) * phase_modulation_depth_candidate;
 
       uint16_t m_osc1_phase_modulation_depth = phase_modulation_depth_candidate;
 
-      volatile int32_t phase_modulation_frequency_ratio_candidate = (((m_osc1_morph_control_effective + 2) >> 2) << 1) + 2;
-      m_osc1_phase_modulation_frequency_ratio[N] = (m_osc1_phase_modulation_frequency_ratio[N] * (1 - new_period_osc1)) + (phase_modulation_frequency_ratio_candidate * new_period_osc1);
+      volatile int32_t phase_modulation_frequency_ratio_candidate = (((m_osc1_morph_control_effective[voice] + 2) >> 2) << 1) + 2;
+      m_osc1_phase_modulation_frequency_ratio[voice] = (m_osc1_phase_modulation_frequency_ratio[voice] * (1 - new_period_osc1)) + (phase_modulation_frequency_ratio_candidate * new_period_osc1);
 
-      uint32_t phase_3 = (((m_phase[N] >> 1) & 0x01FFFFFF) * m_osc1_phase_modulation_frequency_ratio[N]) >> 1;
+      uint32_t phase_3 = (((m_phase[voice] >> 1) & 0x01FFFFFF) * m_osc1_phase_modulation_frequency_ratio[voice]) >> 1;
       const int16_t* wave_table_sine = get_wave_table(WAVEFORM_SINE, 60);
       int16_t wave_3 = get_wave_level(wave_table_sine, phase_3);
 
-      uint32_t phase_0 = m_phase[N] + ((wave_3 * m_osc1_phase_modulation_depth) >> 4);
+      uint32_t phase_0 = m_phase[voice] + ((wave_3 * m_osc1_phase_modulation_depth) >> 4);
       int32_t wave_0 = get_wave_level(wave_table_sine, phase_0);
-      result += (wave_0 * osc1_gain * m_osc_gain_effective[N]) >> 10;
+      result += (wave_0 * osc1_gain * m_osc_gain_effective[voice]) >> 10;
     } else if (m_waveform[0] == WAVEFORM_SAW) {
-      // phase_modulation_depth_candidate = max(m_osc1_shape_effective[N] - (128 << 8), 0)
-      volatile int32_t phase_modulation_depth_candidate = m_osc1_shape_effective[N] - (128 << 8);
+      // phase_modulation_depth_candidate = max(m_osc1_shape_effective[voice] - (128 << 8), 0)
+      volatile int32_t phase_modulation_depth_candidate = m_osc1_shape_effective[voice] - (128 << 8);
       phase_modulation_depth_candidate = (phase_modulation_depth_candidate > 0) * phase_modulation_depth_candidate;
 
       uint32_t freq_shape_morph =
-        ((static_cast<int32_t>((m_freq[N] >> 1) * g_osc_tune_table[(((phase_modulation_depth_candidate + 512) >> 10) + 1 + 128) >> (8 - OSC_TUNE_TABLE_STEPS_BITS)]) >>
+        ((static_cast<int32_t>((m_freq[voice] >> 1) * g_osc_tune_table[(((phase_modulation_depth_candidate + 512) >> 10) + 1 + 128) >> (8 - OSC_TUNE_TABLE_STEPS_BITS)]) >>
           OSC_TUNE_DENOMINATOR_BITS) >> 0) << 1;
-      freq_shape_morph += (N + 4);
-      m_phase_shape_morph[N] += freq_shape_morph;
+      freq_shape_morph += (voice + 4);
+      m_phase_shape_morph[voice] += freq_shape_morph;
 
-      uint32_t phase_shift_base = (127 * (4 - N)) << (5 + 16 - 2);
+      uint32_t phase_shift_base = (127 * (VOICES - voice)) << (5 + 16 - 2);
 
-      int32_t wave_0   = get_wave_level(m_wave_table[N], m_phase[N]);
-      int32_t wave_0_0 = get_wave_level(m_wave_table[N + 16], m_phase[N]);
-      int32_t wave_0_1 = get_wave_level(m_wave_table[N + 16], m_phase[N] - (m_phase_shape_morph[N] * 1) - (phase_shift_base * 3));
-      int32_t wave_0_2 = get_wave_level(m_wave_table[N + 16], m_phase[N] + (m_phase_shape_morph[N] * 1) + (phase_shift_base * 5));
-      int32_t wave_0_3 = get_wave_level(m_wave_table[N + 16], m_phase[N] - (m_phase_shape_morph[N] * 3) - (phase_shift_base * 5));
-      int32_t wave_0_4 = get_wave_level(m_wave_table[N + 16], m_phase[N] + (m_phase_shape_morph[N] * 3) + (phase_shift_base * 1));
-      int32_t wave_0_5 = get_wave_level(m_wave_table[N + 16], m_phase[N] - (m_phase_shape_morph[N] * 5) - (phase_shift_base * 1));
-      int32_t wave_0_6 = get_wave_level(m_wave_table[N + 16], m_phase[N] + (m_phase_shape_morph[N] * 5) + (phase_shift_base * 3));
+      int32_t wave_0   = get_wave_level(m_wave_table[voice], m_phase[voice]);
+      int32_t wave_0_0 = get_wave_level(m_wave_table[voice + (VOICES * 4)], m_phase[voice]);
+      int32_t wave_0_1 = get_wave_level(m_wave_table[voice + (VOICES * 4)], m_phase[voice] - (m_phase_shape_morph[voice] * 1) - (phase_shift_base * 3));
+      int32_t wave_0_2 = get_wave_level(m_wave_table[voice + (VOICES * 4)], m_phase[voice] + (m_phase_shape_morph[voice] * 1) + (phase_shift_base * 5));
+      int32_t wave_0_3 = get_wave_level(m_wave_table[voice + (VOICES * 4)], m_phase[voice] - (m_phase_shape_morph[voice] * 3) - (phase_shift_base * 5));
+      int32_t wave_0_4 = get_wave_level(m_wave_table[voice + (VOICES * 4)], m_phase[voice] + (m_phase_shape_morph[voice] * 3) + (phase_shift_base * 1));
+      int32_t wave_0_5 = get_wave_level(m_wave_table[voice + (VOICES * 4)], m_phase[voice] - (m_phase_shape_morph[voice] * 5) - (phase_shift_base * 1));
+      int32_t wave_0_6 = get_wave_level(m_wave_table[voice + (VOICES * 4)], m_phase[voice] + (m_phase_shape_morph[voice] * 5) + (phase_shift_base * 3));
 
-      int32_t multi_saw_mix = (m_osc1_morph_control_effective + 1) >> 1;
+      int32_t multi_saw_mix = (m_osc1_morph_control_effective[voice] + 1) >> 1;
       result += (((  ( multi_saw_mix       * (((wave_0_0 + wave_0_1 + wave_0_2 + wave_0_3 + wave_0_4 + wave_0_5 + wave_0_6) << 1) / 5))
-                   + ((64 - multi_saw_mix) *    wave_0)) >> 6) * osc1_gain * m_osc_gain_effective[N]) >> 10;
+                   + ((64 - multi_saw_mix) *    wave_0)) >> 6) * osc1_gain * m_osc_gain_effective[voice]) >> 10;
     } else if (m_waveform[0] == WAVEFORM_SQUARE) {
-      // phase_modulation_depth_candidate = max(m_osc1_shape_effective[N] - (128 << 8), 0)
-      volatile int32_t phase_modulation_depth_candidate = m_osc1_shape_effective[N] - (128 << 8);
+      // phase_modulation_depth_candidate = max(m_osc1_shape_effective[voice] - (128 << 8), 0)
+      volatile int32_t phase_modulation_depth_candidate = m_osc1_shape_effective[voice] - (128 << 8);
       phase_modulation_depth_candidate = (phase_modulation_depth_candidate > 0) * phase_modulation_depth_candidate;
 
       uint32_t shape = phase_modulation_depth_candidate;
       const uint16_t (* wave_shape_table)[OSC_WAVE_SHAPE_TABLE_LEN_X][OSC_WAVE_SHAPE_TABLE_LEN_Y] = &g_osc_sqr_shape_table;
 
-      int32_t wave_0    = +get_wave_level(m_wave_table[N], m_phase[N]);
-      int32_t wave_0_0  = +get_wave_level(m_wave_table[N + 16], m_phase[N] - get_osc_wave_shape_data(wave_shape_table, shape, 0 ));
-      int32_t wave_0_1  = -get_wave_level(m_wave_table[N + 16], m_phase[N] - get_osc_wave_shape_data(wave_shape_table, shape, 1 ));
-      int32_t wave_0_2  = +get_wave_level(m_wave_table[N + 16], m_phase[N] - get_osc_wave_shape_data(wave_shape_table, shape, 2 ));
-      int32_t wave_0_3  = -get_wave_level(m_wave_table[N + 16], m_phase[N] - get_osc_wave_shape_data(wave_shape_table, shape, 3 ));
-      int32_t wave_0_4  = +get_wave_level(m_wave_table[N + 16], m_phase[N] - get_osc_wave_shape_data(wave_shape_table, shape, 4 ));
-      int32_t wave_0_5  = -get_wave_level(m_wave_table[N + 16], m_phase[N] - get_osc_wave_shape_data(wave_shape_table, shape, 5 ));
-      int32_t wave_0_6  = +get_wave_level(m_wave_table[N + 16], m_phase[N] - get_osc_wave_shape_data(wave_shape_table, shape, 6 ));
-      int32_t wave_0_7  = -get_wave_level(m_wave_table[N + 16], m_phase[N] - get_osc_wave_shape_data(wave_shape_table, shape, 7 ));
-      int32_t wave_0_8  = +get_wave_level(m_wave_table[N + 16], m_phase[N] - get_osc_wave_shape_data(wave_shape_table, shape, 8 ));
-      int32_t wave_0_9  = -get_wave_level(m_wave_table[N + 16], m_phase[N] - get_osc_wave_shape_data(wave_shape_table, shape, 9 ));
-      int32_t wave_0_10 = +get_wave_level(m_wave_table[N + 16], m_phase[N] - get_osc_wave_shape_data(wave_shape_table, shape, 10));
-      int32_t wave_0_11 = -get_wave_level(m_wave_table[N + 16], m_phase[N] - get_osc_wave_shape_data(wave_shape_table, shape, 11));
-      int32_t wave_0_12 = +get_wave_level(m_wave_table[N + 16], m_phase[N] - get_osc_wave_shape_data(wave_shape_table, shape, 12));
-      int32_t wave_0_13 = -get_wave_level(m_wave_table[N + 16], m_phase[N] - get_osc_wave_shape_data(wave_shape_table, shape, 13));
-      int32_t wave_0_14 = +get_wave_level(m_wave_table[N + 16], m_phase[N] - get_osc_wave_shape_data(wave_shape_table, shape, 14));
-      int32_t wave_0_15 = -get_wave_level(m_wave_table[N + 16], m_phase[N] - get_osc_wave_shape_data(wave_shape_table, shape, 15));
-
-      int32_t sqr_sync_mix = (m_osc1_morph_control_effective + 1) >> 1;
+      int32_t wave_0    = +get_wave_level(m_wave_table[voice], m_phase[voice]);
+      int32_t wave_0_0  = +get_wave_level(m_wave_table[voice + (VOICES * 4)], m_phase[voice] - get_osc_wave_shape_data(wave_shape_table, shape, 0 ));
+      int32_t wave_0_1  = -get_wave_level(m_wave_table[voice + (VOICES * 4)], m_phase[voice] - get_osc_wave_shape_data(wave_shape_table, shape, 1 ));
+      int32_t wave_0_2  = +get_wave_level(m_wave_table[voice + (VOICES * 4)], m_phase[voice] - get_osc_wave_shape_data(wave_shape_table, shape, 2 ));
+      int32_t wave_0_3  = -get_wave_level(m_wave_table[voice + (VOICES * 4)], m_phase[voice] - get_osc_wave_shape_data(wave_shape_table, shape, 3 ));
+      int32_t wave_0_4  = +get_wave_level(m_wave_table[voice + (VOICES * 4)], m_phase[voice] - get_osc_wave_shape_data(wave_shape_table, shape, 4 ));
+      int32_t wave_0_5  = -get_wave_level(m_wave_table[voice + (VOICES * 4)], m_phase[voice] - get_osc_wave_shape_data(wave_shape_table, shape, 5 ));
+      int32_t wave_0_6  = +get_wave_level(m_wave_table[voice + (VOICES * 4)], m_phase[voice] - get_osc_wave_shape_data(wave_shape_table, shape, 6 ));
+      int32_t wave_0_7  = -get_wave_level(m_wave_table[voice + (VOICES * 4)], m_phase[voice] - get_osc_wave_shape_data(wave_shape_table, shape, 7 ));
+      int32_t wave_0_8  = +get_wave_level(m_wave_table[voice + (VOICES * 4)], m_phase[voice] - get_osc_wave_shape_data(wave_shape_table, shape, 8 ));
+      int32_t wave_0_9  = -get_wave_level(m_wave_table[voice + (VOICES * 4)], m_phase[voice] - get_osc_wave_shape_data(wave_shape_table, shape, 9 ));
+      int32_t wave_0_10 = +get_wave_level(m_wave_table[voice + (VOICES * 4)], m_phase[voice] - get_osc_wave_shape_data(wave_shape_table, shape, 10));
+      int32_t wave_0_11 = -get_wave_level(m_wave_table[voice + (VOICES * 4)], m_phase[voice] - get_osc_wave_shape_data(wave_shape_table, shape, 11));
+      int32_t wave_0_12 = +get_wave_level(m_wave_table[voice + (VOICES * 4)], m_phase[voice] - get_osc_wave_shape_data(wave_shape_table, shape, 12));
+      int32_t wave_0_13 = -get_wave_level(m_wave_table[voice + (VOICES * 4)], m_phase[voice] - get_osc_wave_shape_data(wave_shape_table, shape, 13));
+      int32_t wave_0_14 = +get_wave_level(m_wave_table[voice + (VOICES * 4)], m_phase[voice] - get_osc_wave_shape_data(wave_shape_table, shape, 14));
+      int32_t wave_0_15 = -get_wave_level(m_wave_table[voice + (VOICES * 4)], m_phase[voice] - get_osc_wave_shape_data(wave_shape_table, shape, 15));
+
+      int32_t sqr_sync_mix = (m_osc1_morph_control_effective[voice] + 1) >> 1;
       result += (((  ( sqr_sync_mix       * (wave_0_0  + wave_0_1  + wave_0_2  + wave_0_3  + wave_0_4  + wave_0_5  + wave_0_6  + wave_0_7  +
                                              wave_0_8  + wave_0_9  + wave_0_10 + wave_0_11 + wave_0_12 + wave_0_13 + wave_0_14 + wave_0_15))
-                   + ((64 - sqr_sync_mix) *  wave_0)) >> 6) * osc1_gain * m_osc_gain_effective[N]) >> 10;
+                   + ((64 - sqr_sync_mix) *  wave_0)) >> 6) * osc1_gain * m_osc_gain_effective[voice]) >> 10;
     } else if (m_waveform[0] == WAVEFORM_1_WAVE_TABLE) {
-      // phase_modulation_depth_candidate = max(m_osc1_shape_effective[N] - (128 << 8), 0)
-      volatile int32_t phase_modulation_depth_candidate = m_osc1_shape_effective[N] - (128 << 8);
+      // phase_modulation_depth_candidate = max(m_osc1_shape_effective[voice] - (128 << 8), 0)
+      volatile int32_t phase_modulation_depth_candidate = m_osc1_shape_effective[voice] - (128 << 8);
       phase_modulation_depth_candidate = (phase_modulation_depth_candidate > 0) * phase_modulation_depth_candidate;
 
       uint32_t shape = phase_modulation_depth_candidate;
       const uint16_t (* wave_shape_table)[OSC_WAVE_SHAPE_TABLE_LEN_X][OSC_WAVE_SHAPE_TABLE_LEN_Y] = get_wave_shape_table(m_osc1_morph_control);
 
-      int32_t wave_0_0  = +get_wave_level(m_wave_table[N + 16], m_phase[N] - get_osc_wave_shape_data(wave_shape_table, shape, 0 ));
-      int32_t wave_0_1  = -get_wave_level(m_wave_table[N + 16], m_phase[N] - get_osc_wave_shape_data(wave_shape_table, shape, 1 ));
-      int32_t wave_0_2  = +get_wave_level(m_wave_table[N + 16], m_phase[N] - get_osc_wave_shape_data(wave_shape_table, shape, 2 ));
-      int32_t wave_0_3  = -get_wave_level(m_wave_table[N + 16], m_phase[N] - get_osc_wave_shape_data(wave_shape_table, shape, 3 ));
-      int32_t wave_0_4  = +get_wave_level(m_wave_table[N + 16], m_phase[N] - get_osc_wave_shape_data(wave_shape_table, shape, 4 ));
-      int32_t wave_0_5  = -get_wave_level(m_wave_table[N + 16], m_phase[N] - get_osc_wave_shape_data(wave_shape_table, shape, 5 ));
-      int32_t wave_0_6  = +get_wave_level(m_wave_table[N + 16], m_phase[N] - get_osc_wave_shape_data(wave_shape_table, shape, 6 ));
-      int32_t wave_0_7  = -get_wave_level(m_wave_table[N + 16], m_phase[N] - get_osc_wave_shape_data(wave_shape_table, shape, 7 ));
-      int32_t wave_0_8  = +get_wave_level(m_wave_table[N + 16], m_phase[N] - get_osc_wave_shape_data(wave_shape_table, shape, 8 ));
-      int32_t wave_0_9  = -get_wave_level(m_wave_table[N + 16], m_phase[N] - get_osc_wave_shape_data(wave_shape_table, shape, 9 ));
-      int32_t wave_0_10 = +get_wave_level(m_wave_table[N + 16], m_phase[N] - get_osc_wave_shape_data(wave_shape_table, shape, 10));
-      int32_t wave_0_11 = -get_wave_level(m_wave_table[N + 16], m_phase[N] - get_osc_wave_shape_data(wave_shape_table, shape, 11));
-      int32_t wave_0_12 = +get_wave_level(m_wave_table[N + 16], m_phase[N] - get_osc_wave_shape_data(wave_shape_table, shape, 12));
-      int32_t wave_0_13 = -get_wave_level(m_wave_table[N + 16], m_phase[N] - get_osc_wave_shape_data(wave_shape_table, shape, 13));
-      int32_t wave_0_14 = +get_wave_level(m_wave_table[N + 16], m_phase[N] - get_osc_wave_shape_data(wave_shape_table, shape, 14));
-      int32_t wave_0_15 = -get_wave_level(m_wave_table[N + 16], m_phase[N] - get_osc_wave_shape_data(wave_shape_table, shape, 15));
+      int32_t wave_0_0  = +get_wave_level(m_wave_table[voice + (VOICES * 4)], m_phase[voice] - get_osc_wave_shape_data(wave_shape_table, shape, 0 ));
+      int32_t wave_0_1  = -get_wave_level(m_wave_table[voice + (VOICES * 4)], m_phase[voice] - get_osc_wave_shape_data(wave_shape_table, shape, 1 ));
+      int32_t wave_0_2  = +get_wave_level(m_wave_table[voice + (VOICES * 4)], m_phase[voice] - get_osc_wave_shape_data(wave_shape_table, shape, 2 ));
+      int32_t wave_0_3  = -get_wave_level(m_wave_table[voice + (VOICES * 4)], m_phase[voice] - get_osc_wave_shape_data(wave_shape_table, shape, 3 ));
+      int32_t wave_0_4  = +get_wave_level(m_wave_table[voice + (VOICES * 4)], m_phase[voice] - get_osc_wave_shape_data(wave_shape_table, shape, 4 ));
+      int32_t wave_0_5  = -get_wave_level(m_wave_table[voice + (VOICES * 4)], m_phase[voice] - get_osc_wave_shape_data(wave_shape_table, shape, 5 ));
+      int32_t wave_0_6  = +get_wave_level(m_wave_table[voice + (VOICES * 4)], m_phase[voice] - get_osc_wave_shape_data(wave_shape_table, shape, 6 ));
+      int32_t wave_0_7  = -get_wave_level(m_wave_table[voice + (VOICES * 4)], m_phase[voice] - get_osc_wave_shape_data(wave_shape_table, shape, 7 ));
+      int32_t wave_0_8  = +get_wave_level(m_wave_table[voice + (VOICES * 4)], m_phase[voice] - get_osc_wave_shape_data(wave_shape_table, shape, 8 ));
+      int32_t wave_0_9  = -get_wave_level(m_wave_table[voice + (VOICES * 4)], m_phase[voice] - get_osc_wave_shape_data(wave_shape_table, shape, 9 ));
+      int32_t wave_0_10 = +get_wave_level(m_wave_table[voice + (VOICES * 4)], m_phase[voice] - get_osc_wave_shape_data(wave_shape_table, shape, 10));
+      int32_t wave_0_11 = -get_wave_level(m_wave_table[voice + (VOICES * 4)], m_phase[voice] - get_osc_wave_shape_data(wave_shape_table, shape, 11));
+      int32_t wave_0_12 = +get_wave_level(m_wave_table[voice + (VOICES * 4)], m_phase[voice] - get_osc_wave_shape_data(wave_shape_table, shape, 12));
+      int32_t wave_0_13 = -get_wave_level(m_wave_table[voice + (VOICES * 4)], m_phase[voice] - get_osc_wave_shape_data(wave_shape_table, shape, 13));
+      int32_t wave_0_14 = +get_wave_level(m_wave_table[voice + (VOICES * 4)], m_phase[voice] - get_osc_wave_shape_data(wave_shape_table, shape, 14));
+      int32_t wave_0_15 = -get_wave_level(m_wave_table[voice + (VOICES * 4)], m_phase[voice] - get_osc_wave_shape_data(wave_shape_table, shape, 15));
 
       result += (((64 * (wave_0_0  + wave_0_1  + wave_0_2  + wave_0_3  + wave_0_4  + wave_0_5  + wave_0_6  + wave_0_7  +
                          wave_0_8  + wave_0_9  + wave_0_10 + wave_0_11 + wave_0_12 + wave_0_13 + wave_0_14 + wave_0_15)
-                   ) >> 6) * osc1_gain * m_osc_gain_effective[N]) >> 10;
+                   ) >> 6) * osc1_gain * m_osc_gain_effective[voice]) >> 10;
     } else if (m_waveform[0] == WAVEFORM_1_PULSE) {
-      int32_t wave_0 = get_wave_level(m_wave_table[N + 16], m_phase[N]);
-      result += (wave_0 * osc1_gain * m_osc_gain_effective[N]) >> 10;
+      int32_t wave_0 = get_wave_level(m_wave_table[voice + (VOICES * 4)], m_phase[voice]);
+      result += (wave_0 * osc1_gain * m_osc_gain_effective[voice]) >> 10;
 
       // For Pulse Wave (wave_3)
-      uint32_t phase_3 = m_phase[N] + (m_osc1_shape_effective[N] << 8);
+      uint32_t phase_3 = m_phase[voice] + (m_osc1_shape_effective[voice] << 8);
 #if 1
-      int16_t wave_3 = get_wave_level(m_wave_table[N + 16], phase_3);
+      int16_t wave_3 = get_wave_level(m_wave_table[voice + (VOICES * 4)], phase_3);
 #else
-      boolean new_period_osc1_add = ((phase_3 + 0x00800000) & 0x00FFFFFF) < (m_freq[N] + 0x00010000); // crossing the middle of a saw wave
-      m_wave_table[N + 8] = reinterpret_cast<const int16_t*>((reinterpret_cast<const uintptr_t>(m_wave_table[N + 8]) * (1 - new_period_osc1_add)));
-      m_wave_table[N + 8] = reinterpret_cast<const int16_t*>( reinterpret_cast<const uint8_t*>( m_wave_table[N + 8]) +
-                                                             (reinterpret_cast<const uintptr_t>(m_wave_table_temp[N + 8]) * new_period_osc1_add));
-      int16_t wave_3 = get_wave_level(m_wave_table[N + 8], phase_3);
+      boolean new_period_osc1_add = ((phase_3 + 0x00800000) & 0x00FFFFFF) < (m_freq[voice] + 0x00010000); // crossing the middle of a saw wave
+      m_wave_table[voice + (VOICES * 2)] = reinterpret_cast<const int16_t*>((reinterpret_cast<const uintptr_t>(m_wave_table[voice + (VOICES * 2)]) * (1 - new_period_osc1_add)));
+      m_wave_table[voice + (VOICES * 2)] = reinterpret_cast<const int16_t*>( reinterpret_cast<const uint8_t*>( m_wave_table[voice + (VOICES * 2)]) +
+                                                             (reinterpret_cast<const uintptr_t>(m_wave_table_temp[voice + (VOICES * 2)]) * new_period_osc1_add));
+      int16_t wave_3 = get_wave_level(m_wave_table[voice + (VOICES * 2)], phase_3);
 #endif
-      result += ((((wave_3 * osc1_gain * m_osc_gain_effective[N]) >> 10) * (((m_osc1_morph_control_effective - 63) >> 1) << 1)) >> 6);
+      result += ((((wave_3 * osc1_gain * m_osc_gain_effective[voice]) >> 10) * (((m_osc1_morph_control_effective[voice] - 63) >> 1) << 1)) >> 6);
     } else {
-      int32_t wave_0 = get_wave_level(m_wave_table[N], m_phase[N]);
-      result += (wave_0 * osc1_gain * m_osc_gain_effective[N]) >> 10;
+      int32_t wave_0 = get_wave_level(m_wave_table[voice], m_phase[voice]);
+      result += (wave_0 * osc1_gain * m_osc_gain_effective[voice]) >> 10;
     }
 
-    if (m_mixer_noise_sub_osc_control_effective >= 0) {
+    if (m_mixer_noise_sub_osc_control_effective[voice] >= 0) {
       // Sub Osc (wave_1)
-      int16_t wave_1 = get_wave_level(m_wave_table[N + 12], m_phase[N] >> 1);
-      result += (wave_1 * m_mixer_noise_sub_osc_control * m_osc_gain_effective[N]) >> 6;
+      int16_t wave_1 = get_wave_level(m_wave_table[voice + (VOICES * 3)], m_phase[voice] >> 1);
+      result += (wave_1 * m_mixer_noise_sub_osc_control * m_osc_gain_effective[voice]) >> 6;
     } else {
       // Noise (wave_1)
       int16_t wave_1 = noise_int15 >> 1;
-      result += (wave_1 * -m_mixer_noise_sub_osc_control_effective * m_osc_gain_effective[N]) >> 6;
+      result += (wave_1 * -m_mixer_noise_sub_osc_control_effective[voice] * m_osc_gain_effective[voice]) >> 6;
     }
 
-    m_phase[N + 4] += m_freq[N + 4];
-    boolean new_period_osc2 = (m_phase[N + 4] & 0x00FFFFFF) < m_freq[N + 4];
-    m_wave_table[N + 4] = reinterpret_cast<const int16_t*>((reinterpret_cast<const uintptr_t>(m_wave_table[N + 4]) * (1 - new_period_osc2)));
-    m_wave_table[N + 4] = reinterpret_cast<const int16_t*>( reinterpret_cast<const uint8_t*>( m_wave_table[N + 4]) +
-                                                           (reinterpret_cast<const uintptr_t>(m_wave_table_temp[N + 4]) * new_period_osc2));
+    m_phase[voice + VOICES] += m_freq[voice + VOICES];
+    boolean new_period_osc2 = (m_phase[voice + VOICES] & 0x00FFFFFF) < m_freq[voice + VOICES];
+    m_wave_table[voice + VOICES]       = reinterpret_cast<const int16_t*>((reinterpret_cast<const uintptr_t>(m_wave_table[voice + VOICES]) * (1 - new_period_osc2)));
+    m_wave_table[voice + VOICES]       = reinterpret_cast<const int16_t*>( reinterpret_cast<const uint8_t*>( m_wave_table[voice + VOICES]) +
+                                                           (reinterpret_cast<const uintptr_t>(m_wave_table_temp[voice + VOICES]) * new_period_osc2));
     if (m_waveform[1] != WAVEFORM_2_NOISE) {
-      int16_t wave_2 = get_wave_level(m_wave_table[N + 4], m_phase[N + 4]);
-      result += (wave_2 * osc2_gain * m_osc_gain_effective[N]) >> 10;
+      int16_t wave_2 = get_wave_level(m_wave_table[voice + VOICES], m_phase[voice + VOICES]);
+      result += (wave_2 * osc2_gain * m_osc_gain_effective[voice]) >> 10;
     } else {
       // Noise (wave_2)
       int16_t wave_2 = noise_int15 >> 1;
-      result += (wave_2 * osc2_gain * m_osc_gain_effective[N]) >> 10;
+      result += (wave_2 * osc2_gain * m_osc_gain_effective[voice]) >> 10;
     }
 
     return result;
   }
 
-  template <uint8_t N>
-  INLINE void update_pitch_current() {
-    if (m_osc_on[N]) {
-      if (m_pitch_current[N] <= m_pitch_target[N]) {
-        m_pitch_current[N] = m_pitch_target[N]  - mul_s32_s32_h32((m_pitch_target[N] - m_pitch_current[N]) << 2,             m_portamento_coef[N]);
+  INLINE void update_pitch_current(uint8_t voice) {
+    if (m_osc_on[voice]) {
+      if (m_pitch_current[voice] <= m_pitch_target[voice]) {
+        m_pitch_current[voice] = m_pitch_target[voice]  - mul_s32_s32_h32((m_pitch_target[voice] - m_pitch_current[voice]) << 2,             m_portamento_coef[voice]);
       } else {
-        m_pitch_current[N] = m_pitch_current[N] + mul_s32_s32_h32((m_pitch_target[N] - m_pitch_current[N]) << 2, (1 << 30) - m_portamento_coef[N]);
+        m_pitch_current[voice] = m_pitch_current[voice] + mul_s32_s32_h32((m_pitch_target[voice] - m_pitch_current[voice]) << 2, (1 << 30) - m_portamento_coef[voice]);
       }
     }
   }
 
-  template <uint8_t N>
-  INLINE void update_freq_base(int16_t lfo_level, int16_t eg_level) {
-    int16_t pitch_eg_amt;
-    if (N >= 4) {
-      pitch_eg_amt = m_pitch_eg_amt[1];
-    } else {
-      pitch_eg_amt = m_pitch_eg_amt[0];
-    }
-    uint16_t pitch_temp =  (64 << 8) + (m_pitch_current[N & 0x03] >> 16) + m_pitch_bend_normalized + ((eg_level * pitch_eg_amt) >> 14);
+  // OSC is 0 for Osc 1 and 1 for Osc 2
+  template <uint8_t OSC>
+  INLINE void update_freq_base(uint8_t voice, int16_t lfo_level, int16_t eg_level) {
+    const uint8_t i = voice + (VOICES * OSC);
+
+    int16_t pitch_eg_amt = m_pitch_eg_amt[OSC];
+    uint16_t pitch_temp =  (64 << 8) + (m_pitch_current[voice] >> 16) + m_pitch_bend_normalized + ((eg_level * pitch_eg_amt) >> 14);
 
     uint8_t coarse = high_byte(pitch_temp);
     if (coarse < (NOTE_NUMBER_MIN + 64)) {
@@ -707,7 +635,7 @@ private:
       pitch_temp = ((NOTE_NUMBER_MAX + 64) << 8);
     }
 
-    if (N >= 4) {
+    if (OSC == 1) {
       pitch_temp += (lfo_level * m_pitch_lfo_amt[1]) >> 14;
       pitch_temp += (m_osc2_pitch << 8) + m_osc2_detune;
     } else {
@@ -727,83 +655,82 @@ private:
 
 
     coarse = high_byte(pitch_temp);
-    m_freq_base[N] = g_osc_freq_table[coarse - NOTE_NUMBER_MIN];
-    if (N >= 4) {
-      m_wave_table_temp[N]      = get_wave_table(m_waveform[1], coarse);
+    m_freq_base[i] = g_osc_freq_table[coarse - NOTE_NUMBER_MIN];
+    if (OSC == 1) {
+      m_wave_table_temp[i]                = get_wave_table(m_waveform[1], coarse);
     } else {
-      m_wave_table_temp[N]      = get_wave_table(m_waveform[0], coarse);
-      m_wave_table_temp[N + 8]  = get_wave_table(WAVEFORM_SAW,  coarse);
-      m_wave_table_temp[N + 16] = get_wave_table(WAVEFORM_SAW,  coarse);
+      m_wave_table_temp[i]                = get_wave_table(m_waveform[0], coarse);
+      m_wave_table_temp[i + (VOICES * 2)] = get_wave_table(WAVEFORM_SAW,  coarse);
+      m_wave_table_temp[i + (VOICES * 4)] = get_wave_table(WAVEFORM_SAW,  coarse);
 
       // coarse_sub = max((coarse - 12), NOTE_NUMBER_MIN)
       volatile int32_t coarse_sub = (coarse - 12) - NOTE_NUMBER_MIN;
       coarse_sub = (coarse_sub > 0) * coarse_sub + NOTE_NUMBER_MIN;
 
-      m_wave_table_temp[N + 12] = get_wave_table(WAVEFORM_SINE, coarse_sub);
+      m_wave_table_temp[i + (VOICES * 3)] = get_wave_table(WAVEFORM_SINE, coarse_sub);
     }
 
 
     uint8_t fine = low_byte(pitch_temp);
     int32_t offset =
-      ((static_cast<int32_t>((m_freq_base[N] >> 1) * g_osc_tune_table[fine >> (8 - OSC_TUNE_TABLE_STEPS_BITS)]) >>
+      ((static_cast<int32_t>((m_freq_base[i] >> 1) * g_osc_tune_table[fine >> (8 - OSC_TUNE_TABLE_STEPS_BITS)]) >>
         OSC_TUNE_DENOMINATOR_BITS) >> 0) << 1;
-    m_freq_base[N] += offset;
-    m_freq[N] = m_freq_base[N] + m_freq_offset[N];
+    m_freq_base[i] += offset;
+    m_freq[i] = m_freq_base[i] + m_freq_offset[i];
   }
 
-  template <uint8_t N>
-  INLINE void update_freq_offset(int16_t noise_int15) {
+  template <uint8_t OSC>
+  INLINE void update_freq_offset(uint8_t voice, int16_t noise_int15) {
     static_cast<void>(noise_int15);
-    m_freq_offset[N] = (N >> 2) << 1;
-    m_freq[N] = m_freq_base[N] + m_freq_offset[N];
+    const uint8_t i = voice + (VOICES * OSC);
+    m_freq_offset[i] = OSC << 1;
+    m_freq[i] = m_freq_base[i] + m_freq_offset[i];
   }
 
-  template <uint8_t N>
-  INLINE void update_gate() {
+  INLINE void update_gate(uint8_t voice) {
     if (m_gate_enabled) {
-      if (m_osc_on[N]) {
+      if (m_osc_on[voice]) {
         const int8_t half_level = (m_osc_level >> 1) + 1;
 
-        if (m_osc_gain_effective[N] >= (m_osc_level - half_level)) {
-          m_osc_gain_effective[N] = m_osc_level;
+        if (m_osc_gain_effective[voice] >= (m_osc_level - half_level)) {
+          m_osc_gain_effective[voice] = m_osc_level;
         } else {
-          m_osc_gain_effective[N] += half_level;
+          m_osc_gain_effective[voice] += half_level;
         }
       } else {
         const int8_t one_fourth_level = (m_osc_level >> 2) + 1;
 
-        if (m_osc_gain_effective[N] <= one_fourth_level) {
-          m_osc_gain_effective[N] = 0;
+        if (m_osc_gain_effective[voice] <= one_fourth_level) {
+          m_osc_gain_effective[voice] = 0;
         } else {
-          m_osc_gain_effective[N] -= one_fourth_level;
+          m_osc_gain_effective[voice] -= one_fourth_level;
         }
       }
     } else {
-      m_osc_gain_effective[N] = m_osc_level;
+      m_osc_gain_effective[voice] = m_osc_level;
     }
   }
 
-  INLINE void update_osc1_shape_control_effective() {
-    m_osc1_shape_control_effective += (m_osc1_shape_control_effective < m_osc1_shape_control);
-    m_osc1_shape_control_effective -= (m_osc1_shape_control_effective > m_osc1_shape_control);
+  INLINE void update_osc1_shape_control_effective(uint8_t voice) {
+    m_osc1_shape_control_effective[voice] += (m_osc1_shape_control_effective[voice] < m_osc1_shape_control);
+    m_osc1_shape_control_effective[voice] -= (m_osc1_shape_control_effective[voice] > m_osc1_shape_control);
   }
 
-  INLINE void update_osc1_morph_control_effective() {
-    m_osc1_morph_control_effective += (m_osc1_morph_control_effective < m_osc1_morph_control);
-    m_osc1_morph_control_effective -= (m_osc1_morph_control_effective > m_osc1_morph_control);
+  INLINE void update_osc1_morph_control_effective(uint8_t voice) {
+    m_osc1_morph_control_effective[voice] += (m_osc1_morph_control_effective[voice] < m_osc1_morph_control);
+    m_osc1_morph_control_effective[voice] -= (m_osc1_morph_control_effective[voice] > m_osc1_morph_control);
   }
 
-  INLINE void update_mixer_control_effective() {
-    m_mixer_osc_mix_control_effective       += (m_mixer_osc_mix_control_effective < m_mixer_osc_mix_control);
-    m_mixer_osc_mix_control_effective       -= (m_mixer_osc_mix_control_effective > m_mixer_osc_mix_control);
+  INLINE void update_mixer_control_effective(uint8_t voice) {
+    m_mixer_osc_mix_control_effective[voice]       += (m_mixer_osc_mix_control_effective[voice] < m_mixer_osc_mix_control);
+    m_mixer_osc_mix_control_effective[voice]       -= (m_mixer_osc_mix_control_effective[voice] > m_mixer_osc_mix_control);
 
-    m_mixer_noise_sub_osc_control_effective += (m_mixer_noise_sub_osc_control_effective < m_mixer_noise_sub_osc_control);
-    m_mixer_noise_sub_osc_control_effective -= (m_mixer_noise_sub_osc_control_effective > m_mixer_noise_sub_osc_control);
+    m_mixer_noise_sub_osc_control_effective[voice] += (m_mixer_noise_sub_osc_control_effective[voice] < m_mixer_noise_sub_osc_control);
+    m_mixer_noise_sub_osc_control_effective[voice] -= (m_mixer_noise_sub_osc_control_effective[voice] > m_mixer_noise_sub_osc_control);
   }
 
-  template <uint8_t N>
-  INLINE void update_osc1_shape(int16_t lfo_level, int16_t eg_level) {
-    volatile int32_t osc1_shape = (128 << 8) + (m_osc1_shape_control_effective << (8 - 3))
+  INLINE void update_osc1_shape(uint8_t voice, int16_t lfo_level, int16_t eg_level) {
+    volatile int32_t osc1_shape = (128 << 8) + (m_osc1_shape_control_effective[voice] << (8 - 3))
                                   + ((eg_level * m_shape_eg_amt) >> 5) - ((lfo_level * m_shape_lfo_amt) >> 5);
 
     // osc1_shape = clamp(y_0, (0 << 8), (256 << 8))
@@ -811,16 +738,15 @@ private:
     osc1_shape = (osc1_shape < 0) * osc1_shape + (256 << 8) - (0 << 8);
     osc1_shape = (osc1_shape > 0) * osc1_shape + (0 << 8);
 
-    m_osc1_shape[N] = osc1_shape;
+    m_osc1_shape[voice] = osc1_shape;
   }
 
-  template <uint8_t N>
-  INLINE void update_osc1_shape_effective() {
-    // effective_new = clamp(m_osc1_shape[N], (m_osc1_shape_effective[N] - 0x0100), (m_osc1_shape_effective[N] + 0x0100))
-    volatile int32_t effective_new = m_osc1_shape[N] - (m_osc1_shape_effective[N] + 0x0100);
-    effective_new = (effective_new < 0) * effective_new + (m_osc1_shape_effective[N] + 0x0100) - (m_osc1_shape_effective[N] - 0x0100);
-    effective_new = (effective_new > 0) * effective_new + (m_osc1_shape_effective[N] - 0x0100);
-    m_osc1_shape_effective[N] = effective_new;
+  INLINE void update_osc1_shape_effective(uint8_t voice) {
+    // effective_new = clamp(m_osc1_shape[voice], (m_osc1_shape_effective[voice] - 0x0100), (m_osc1_shape_effective[voice] + 0x0100))
+    volatile int32_t effective_new = m_osc1_shape[voice] - (m_osc1_shape_effective[voice] + 0x0100);
+    effective_new = (effective_new < 0) * effective_new + (m_osc1_shape_effective[voice] + 0x0100) - (m_osc1_shape_effective[voice] - 0x0100);
+    effective_new = (effective_new > 0) * effective_new + (m_osc1_shape_effective[voice] - 0x0100);
+    m_osc1_shape_effective[voice] = effective_new;
   }
 
   INLINE void update_pitch_bend() {
@@ -20,6 +20,18 @@ extern I2S g_i2s_output;
 #include <algorithm>
 #include <cstring>
 
+#if !defined(PRA32_U2_NUM_VOICES)
+#define PRA32_U2_NUM_VOICES (4)  // Number of voices of PRA32_U2_Synth, 3 or more
+#endif  // !defined(PRA32_U2_NUM_VOICES)
+
+#if !defined(PRA32_U2_VOICE_SILENCE_LEVEL)
+#define PRA32_U2_VOICE_SILENCE_LEVEL (0)  // A voice is not rendered while its amp EG is released and at or below this level
+#endif  // !defined(PRA32_U2_VOICE_SILENCE_LEVEL)
+
+#if !defined(PRA32_U2_RENDER_BLOCK_FRAMES_MAX)
+#define PRA32_U2_RENDER_BLOCK_FRAMES_MAX (64)  // Multiple of 4, longer blocks are split by render_block()
+#endif  // !defined(PRA32_U2_RENDER_BLOCK_FRAMES_MAX)
+
 static uint8_t s_program_table_parameters[] = {
   OSC_1_WAVE     ,
   OSC_1_SHAPE    ,
@@ -181,20 +193,33 @@ const uint8_t   DEFAULT_SEQ_TRX_ST_SP   = 0  ;
 
 
 
-class PRA32_U2_Synth {
-  PRA32_U2_Osc       m_osc;
-  PRA32_U2_Filter    m_filter[4];
-  PRA32_U2_Amp       m_amp[4];
+// The voice state is kept in one array per field (osc state inside
+// PRA32_U2_Osc, m_eg, m_amp_eg, m_filter, m_amp, m_note_on_number, ...),
+// indexed by voice, so that the per-voice loops walk contiguous memory.
+// Voice N gets its control-rate update at phase (N % 4) of each 4-sample
+// control period.
+template <uint8_t VOICES>
+class PRA32_U2_SynthN {
+  static_assert(VOICES >= 3, "The monophonic modes use osc 0 and osc 2");
+
+  // render_block() renders the voices from this one on with secondary_core_process()
+  static const uint8_t SECONDARY_CORE_FIRST_VOICE = VOICES / 2;
+
+  PRA32_U2_Osc<VOICES> m_osc;
+  PRA32_U2_Filter    m_filter[VOICES];
+  PRA32_U2_Amp       m_amp[VOICES];
   PRA32_U2_NoiseGen  m_noise_gen;
   PRA32_U2_LFO       m_lfo;
-  PRA32_U2_EG        m_eg[2 * 4];
+  PRA32_U2_EG        m_eg[VOICES];      // Filter/pitch/shape EG
+  PRA32_U2_EG        m_amp_eg[VOICES];
   PRA32_U2_ChorusFx  m_chorus_fx;
   PRA32_U2_DelayFx   m_delay_fx;
 
   uint32_t          m_count;
 
-  uint8_t           m_note_queue[4];
-  uint8_t           m_note_on_number[4];
+  uint8_t           m_note_queue[VOICES];
+  uint8_t           m_note_on_number[VOICES];
+  boolean           m_voice_active[VOICES];
   uint8_t           m_note_on_count[128];
   uint8_t           m_note_on_total_count;
   uint8_t           m_last_note_on_index;
@@ -230,12 +255,17 @@ class PRA32_U2_Synth {
   uint8_t           m_program_table[128][PROGRAM_NUMBER_MAX + 1];
   uint8_t           m_program_table_panel[2][128 + 128];
 
-  volatile int32_t  m_secondary_core_processing_argument;
-  volatile uint32_t m_secondary_core_processing_request;
-  volatile int32_t  m_secondary_core_processing_result;
+  int16_t           m_block_noise_int15[PRA32_U2_RENDER_BLOCK_FRAMES_MAX];
+  int16_t           m_block_lfo_output[(PRA32_U2_RENDER_BLOCK_FRAMES_MAX / 4) * 2];
+  int32_t           m_block_voice_mixer_output[2][PRA32_U2_RENDER_BLOCK_FRAMES_MAX];
+  uint32_t          m_block_count_high;
+  uint32_t          m_block_sub_blocks;
+
+  volatile boolean  m_secondary_core_enabled;
+  volatile uint32_t m_secondary_core_processing_request;  // 0: none, 1: requested, 2: being rendered
 
 public:
-  PRA32_U2_Synth()
+  PRA32_U2_SynthN()
 
   : m_osc()
   , m_filter()
@@ -243,6 +273,7 @@ public:
   , m_noise_gen()
   , m_lfo()
   , m_eg()
+  , m_amp_eg()
   , m_chorus_fx()
   , m_delay_fx()
 
@@ -250,9 +281,10 @@ public:
 
   , m_note_queue()
   , m_note_on_number()
+  , m_voice_active()
   , m_note_on_count()
   , m_note_on_total_count()
-  , m_last_note_on_index(3)
+  , m_last_note_on_index(VOICES - 1)
   , m_sustain_pedal()
   , m_voice_mode(0xFF)
   , m_voice_asgn_mode(1)
@@ -285,25 +317,25 @@ public:
   , m_program_table()
   , m_program_table_panel()
 
-  , m_secondary_core_processing_argument()
+  , m_block_noise_int15()
+  , m_block_lfo_output()
+  , m_block_voice_mixer_output()
+  , m_block_count_high()
+  , m_block_sub_blocks()
+
+  , m_secondary_core_enabled(true)
   , m_secondary_core_processing_request()
-  , m_secondary_core_processing_result()
   {
-    m_note_queue[0] = 0;
-    m_note_queue[1] = 1;
-    m_note_queue[2] = 2;
-    m_note_queue[3] = 3;
-    m_note_on_number[0] = NOTE_NUMBER_INVALID;
-    m_note_on_number[1] = NOTE_NUMBER_INVALID;
-    m_note_on_number[2] = NOTE_NUMBER_INVALID;
-    m_note_on_number[3] = NOTE_NUMBER_INVALID;
+    for (uint8_t i = 0; i < VOICES; ++i) {
+      m_note_queue[i] = i;
+      m_note_on_number[i] = NOTE_NUMBER_INVALID;
+    }
 
     set_voice_mode(VOICE_POLYPHONIC);
 
-    m_amp[0].set_gain(127);
-    m_amp[1].set_gain(127);
-    m_amp[2].set_gain(127);
-    m_amp[3].set_gain(127);
+    for (uint8_t i = 0; i < VOICES; ++i) {
+      m_amp[i].set_gain(127);
+    }
 
     m_eg_osc_amt = 64;
     m_lfo_osc_amt = 64;
@@ -481,6 +513,8 @@ public:
 
     if ((m_voice_mode == VOICE_MONOPHONIC) ||
         (m_voice_mode == VOICE_LEGATO) || (m_voice_mode == VOICE_LEGATO_PORTA)) {
+      reset_voice_pressure(0);
+
       if ((m_voice_mode == VOICE_LEGATO) || (m_voice_mode == VOICE_LEGATO_PORTA)) {
         ++m_note_on_total_count;
         ++m_note_on_count[note_number];
@@ -489,213 +523,71 @@ public:
           m_note_on_number[0] = note_number;
 
           if (m_voice_mode == VOICE_LEGATO_PORTA) {
-            m_osc.set_portamento<0>(0);
-            m_osc.set_portamento<2>(0);
+            m_osc.set_portamento(0, 0);
+            m_osc.set_portamento(2, 0);
           } else {
-            m_osc.set_portamento<0>(m_portamento);
-            m_osc.set_portamento<2>(m_portamento);
+            m_osc.set_portamento(0, m_portamento);
+            m_osc.set_portamento(2, m_portamento);
           }
-          m_osc.note_on<0>(note_number);
-          m_osc.note_on<2>(note_number);
+          m_osc.note_on(0, note_number);
+          m_osc.note_on(2, note_number);
           m_lfo.trigger_lfo();
-          m_eg[0].note_on(velocity);
-          m_eg[1].note_on(velocity);
+          m_eg    [0].note_on(velocity);
+          m_amp_eg[0].note_on(velocity);
         } else {
-          m_note_on_number[3] = m_note_on_number[2];
-          m_note_on_number[2] = m_note_on_number[1];
-          m_note_on_number[1] = m_note_on_number[0];
-          m_note_on_number[0] = note_number;
+          note_stack_push(note_number);
 
-          m_osc.set_portamento<0>(m_portamento);
-          m_osc.set_portamento<2>(m_portamento);
-          m_osc.note_on<0>(note_number);
-          m_osc.note_on<2>(note_number);
+          m_osc.set_portamento(0, m_portamento);
+          m_osc.set_portamento(2, m_portamento);
+          m_osc.note_on(0, note_number);
+          m_osc.note_on(2, note_number);
         }
       } else {
         ++m_note_on_total_count;
         ++m_note_on_count[note_number];
 
-        m_note_on_number[3] = m_note_on_number[2];
-        m_note_on_number[2] = m_note_on_number[1];
-        m_note_on_number[1] = m_note_on_number[0];
-        m_note_on_number[0] = note_number;
+        note_stack_push(note_number);
 
-        m_osc.set_portamento<0>(m_portamento);
-        m_osc.set_portamento<2>(m_portamento);
-        m_osc.note_on<0>(note_number);
-        m_osc.note_on<2>(note_number);
+        m_osc.set_portamento(0, m_portamento);
+        m_osc.set_portamento(2, m_portamento);
+        m_osc.note_on(0, note_number);
+        m_osc.note_on(2, note_number);
         m_lfo.trigger_lfo();
-        m_eg[0].note_on(velocity);
-        m_eg[1].note_on(velocity);
-      }
-    } else if (m_note_on_number[0] == note_number) {
-      ++m_note_on_total_count;
-      ++m_note_on_count[note_number];
-
-      m_osc.set_portamento<0>(m_portamento);
-      m_osc.note_on<0>(note_number);
-      m_last_note_on_index = 0;
-
-      m_eg[0].note_on(velocity);
-      m_eg[1].note_on(velocity);
-    } else if (m_note_on_number[1] == note_number) {
-      ++m_note_on_total_count;
-      ++m_note_on_count[note_number];
-
-      m_osc.set_portamento<1>(m_portamento);
-      m_osc.note_on<1>(note_number);
-      m_last_note_on_index = 1;
-
-      if (m_voice_mode == VOICE_POLYPHONIC) {
-        m_eg[2].note_on(velocity);
-        m_eg[3].note_on(velocity);
-      } else {
-        m_eg[0].note_on(velocity);
-        m_eg[1].note_on(velocity);
-      }
-    } else if (m_note_on_number[2] == note_number) {
-      ++m_note_on_total_count;
-      ++m_note_on_count[note_number];
-
-      m_osc.set_portamento<2>(m_portamento);
-      m_osc.note_on<2>(note_number);
-      m_last_note_on_index = 2;
-
-      if (m_voice_mode == VOICE_POLYPHONIC) {
-        m_eg[4].note_on(velocity);
-        m_eg[5].note_on(velocity);
-      } else {
-        m_eg[0].note_on(velocity);
-        m_eg[1].note_on(velocity);
-      }
-    } else if (m_note_on_number[3] == note_number) {
-      ++m_note_on_total_count;
-      ++m_note_on_count[note_number];
-
-      m_osc.set_portamento<3>(m_portamento);
-      m_osc.note_on<3>(note_number);
-      m_last_note_on_index = 3;
-
-      if (m_voice_mode == VOICE_POLYPHONIC) {
-        m_eg[6].note_on(velocity);
-        m_eg[7].note_on(velocity);
-      } else {
-        m_eg[0].note_on(velocity);
-        m_eg[1].note_on(velocity);
+        m_eg    [0].note_on(velocity);
+        m_amp_eg[0].note_on(velocity);
       }
     } else {
-      uint8_t note_on_osc_index;
-
-      if (m_voice_asgn_mode == 1) {
-        switch (m_last_note_on_index) {
-        default:
-          if        (m_note_on_number[1] == NOTE_NUMBER_INVALID) {
-            note_on_osc_index = 1;
-          } else if (m_note_on_number[2] == NOTE_NUMBER_INVALID) {
-            note_on_osc_index = 2;
-          } else if (m_note_on_number[3] == NOTE_NUMBER_INVALID) {
-            note_on_osc_index = 3;
-          } else if (m_note_on_number[0] == NOTE_NUMBER_INVALID) {
-            note_on_osc_index = 0;
-          } else {
-            note_on_osc_index = m_note_queue[0];
-          }
-          break;
-        case 1:
-          if        (m_note_on_number[2] == NOTE_NUMBER_INVALID) {
-            note_on_osc_index = 2;
-          } else if (m_note_on_number[3] == NOTE_NUMBER_INVALID) {
-            note_on_osc_index = 3;
-          } else if (m_note_on_number[0] == NOTE_NUMBER_INVALID) {
-            note_on_osc_index = 0;
-          } else if (m_note_on_number[1] == NOTE_NUMBER_INVALID) {
-            note_on_osc_index = 1;
-          } else {
-            note_on_osc_index = m_note_queue[0];
-          }
-          break;
-        case 2:
-          if        (m_note_on_number[3] == NOTE_NUMBER_INVALID) {
-            note_on_osc_index = 3;
-          } else if (m_note_on_number[0] == NOTE_NUMBER_INVALID) {
-            note_on_osc_index = 0;
-          } else if (m_note_on_number[1] == NOTE_NUMBER_INVALID) {
-            note_on_osc_index = 1;
-          } else if (m_note_on_number[2] == NOTE_NUMBER_INVALID) {
-            note_on_osc_index = 2;
-          } else {
-            note_on_osc_index = m_note_queue[0];
-          }
-          break;
-        case 3:
-          if        (m_note_on_number[0] == NOTE_NUMBER_INVALID) {
-            note_on_osc_index = 0;
-          } else if (m_note_on_number[1] == NOTE_NUMBER_INVALID) {
-            note_on_osc_index = 1;
-          } else if (m_note_on_number[2] == NOTE_NUMBER_INVALID) {
-            note_on_osc_index = 2;
-          } else if (m_note_on_number[3] == NOTE_NUMBER_INVALID) {
-            note_on_osc_index = 3;
-          } else {
-            note_on_osc_index = m_note_queue[0];
-          }
-          break;
-        }
-      } else /* if (m_voice_asgn_mode == 2) */{
-        if        (m_note_on_number[0] == NOTE_NUMBER_INVALID) {
-          note_on_osc_index = 0;
-        } else if (m_note_on_number[1] == NOTE_NUMBER_INVALID) {
-          note_on_osc_index = 1;
-        } else if (m_note_on_number[2] == NOTE_NUMBER_INVALID) {
-          note_on_osc_index = 2;
-        } else if (m_note_on_number[3] == NOTE_NUMBER_INVALID) {
-          note_on_osc_index = 3;
-        } else {
-          note_on_osc_index = m_note_queue[0];
-        }
+      // Retrigger the voice that is already playing the note, if any
+      uint8_t note_on_osc_index = 0;
+      while ((note_on_osc_index < VOICES) && (m_note_on_number[note_on_osc_index] != note_number)) {
+        ++note_on_osc_index;
       }
 
-      note_queue_on(note_on_osc_index);
-
       uint8_t prev_note_on_total_count = m_note_on_total_count;
       ++m_note_on_total_count;
       ++m_note_on_count[note_number];
 
-      m_note_on_number[note_on_osc_index] = note_number;
-
-      switch (note_on_osc_index) {
-      default:
-        m_osc.set_portamento<0>(m_portamento);
-        m_osc.note_on<0>(note_number);
-        m_last_note_on_index = 0;
-        break;
-      case 1:
-        m_osc.set_portamento<1>(m_portamento);
-        m_osc.note_on<1>(note_number);
-        m_last_note_on_index = 1;
-        break;
-      case 2:
-        m_osc.set_portamento<2>(m_portamento);
-        m_osc.note_on<2>(note_number);
-        m_last_note_on_index = 2;
-        break;
-      case 3:
-        m_osc.set_portamento<3>(m_portamento);
-        m_osc.note_on<3>(note_number);
-        m_last_note_on_index = 3;
-        break;
-      }
+      if (note_on_osc_index == VOICES) {
+        note_on_osc_index = get_note_on_osc_index();
+        note_queue_on(note_on_osc_index);
+        m_note_on_number[note_on_osc_index] = note_number;
 
-      if (prev_note_on_total_count == 0) {
-        m_lfo.trigger_lfo();
+        if (prev_note_on_total_count == 0) {
+          m_lfo.trigger_lfo();
+        }
       }
 
+      reset_voice_pressure(note_on_osc_index);
+      m_osc.set_portamento(note_on_osc_index, m_portamento);
+      m_osc.note_on(note_on_osc_index, note_number);
+      m_last_note_on_index = note_on_osc_index;
+
       if (m_voice_mode == VOICE_POLYPHONIC) {
-        m_eg[(note_on_osc_index << 1) + 0].note_on(velocity);
-        m_eg[(note_on_osc_index << 1) + 1].note_on(velocity);
+        m_eg    [note_on_osc_index].note_on(velocity);
+        m_amp_eg[note_on_osc_index].note_on(velocity);
       } else {
-        m_eg[0].note_on(velocity);
-        m_eg[1].note_on(velocity);
+        m_eg    [0].note_on(velocity);
+        m_amp_eg[0].note_on(velocity);
       }
     }
   }
@@ -719,129 +611,71 @@ public:
     if ((m_voice_mode == VOICE_MONOPHONIC) ||
         (m_voice_mode == VOICE_LEGATO) || (m_voice_mode == VOICE_LEGATO_PORTA)) {
       if (m_note_on_total_count == 0) {
-        m_note_on_number[0] = NOTE_NUMBER_INVALID;
-        m_note_on_number[1] = NOTE_NUMBER_INVALID;
-        m_note_on_number[2] = NOTE_NUMBER_INVALID;
-        m_note_on_number[3] = NOTE_NUMBER_INVALID;
-        m_note_queue[0] = 0;
-        m_note_queue[1] = 1;
-        m_note_queue[2] = 2;
-        m_note_queue[3] = 3;
-        m_osc.note_off<0>();
-        m_osc.note_off<1>();
-        m_osc.note_off<2>();
-        m_osc.note_off<3>();
+        for (uint8_t i = 0; i < VOICES; ++i) {
+          m_note_on_number[i] = NOTE_NUMBER_INVALID;
+          m_note_queue[i] = i;
+          m_osc.note_off(i);
+        }
       } else if (m_note_on_number[0] == note_number) {
-        m_note_on_number[0] = m_note_on_number[1];
-        m_note_on_number[1] = m_note_on_number[2];
-        m_note_on_number[2] = m_note_on_number[3];
-        m_note_on_number[3] = NOTE_NUMBER_INVALID;
+        note_stack_remove(0);
 
         if (m_note_on_number[0] != NOTE_NUMBER_INVALID) {
-          m_osc.set_portamento<0>(m_portamento);
-          m_osc.set_portamento<2>(m_portamento);
-          m_osc.note_on<0>(m_note_on_number[0]);
-          m_osc.note_on<2>(m_note_on_number[0]);
+          m_osc.set_portamento(0, m_portamento);
+          m_osc.set_portamento(2, m_portamento);
+          m_osc.note_on(0, m_note_on_number[0]);
+          m_osc.note_on(2, m_note_on_number[0]);
 
           if (m_voice_mode == VOICE_MONOPHONIC) {
             m_lfo.trigger_lfo();
-            m_eg[0].note_on(255);
-            m_eg[1].note_on(255);
+            m_eg    [0].note_on(255);
+            m_amp_eg[0].note_on(255);
           }
         }
-      } else if (m_note_on_number[1] == note_number) {
-        m_note_on_number[1] = m_note_on_number[2];
-        m_note_on_number[2] = m_note_on_number[3];
-        m_note_on_number[3] = NOTE_NUMBER_INVALID;
-      } else if (m_note_on_number[2] == note_number) {
-        m_note_on_number[2] = m_note_on_number[3];
-        m_note_on_number[3] = NOTE_NUMBER_INVALID;
-      } else if (m_note_on_number[3] == note_number) {
-        m_note_on_number[3] = NOTE_NUMBER_INVALID;
-      }
-    } else if (m_note_on_number[0] == note_number) {
-      if (m_note_on_count[note_number] == 0) {
-        m_note_on_number[0] = NOTE_NUMBER_INVALID;
-        note_queue_off(0);
-        m_osc.note_off<0>();
-
-        if (m_voice_mode == VOICE_POLYPHONIC) {
-          m_eg[0].note_off();
-          m_eg[1].note_off();
-        }
-      }
-    } else if (m_note_on_number[1] == note_number) {
-      if (m_note_on_count[note_number] == 0) {
-        m_note_on_number[1] = NOTE_NUMBER_INVALID;
-        note_queue_off(1);
-        m_osc.note_off<1>();
-
-        if (m_voice_mode == VOICE_POLYPHONIC) {
-          m_eg[2].note_off();
-          m_eg[3].note_off();
-        }
-      }
-    } else if (m_note_on_number[2] == note_number) {
-      if (m_note_on_count[note_number] == 0) {
-        m_note_on_number[2] = NOTE_NUMBER_INVALID;
-        note_queue_off(2);
-        m_osc.note_off<2>();
-
-        if (m_voice_mode == VOICE_POLYPHONIC) {
-          m_eg[4].note_off();
-          m_eg[5].note_off();
+      } else {
+        for (uint8_t i = 1; i < VOICES; ++i) {
+          if (m_note_on_number[i] == note_number) {
+            note_stack_remove(i);
+            break;
+          }
         }
       }
-    } else if (m_note_on_number[3] == note_number) {
-      if (m_note_on_count[note_number] == 0) {
-        m_note_on_number[3] = NOTE_NUMBER_INVALID;
-        note_queue_off(3);
-        m_osc.note_off<3>();
-
-        if (m_voice_mode == VOICE_POLYPHONIC) {
-          m_eg[6].note_off();
-          m_eg[7].note_off();
+    } else {
+      for (uint8_t i = 0; i < VOICES; ++i) {
+        if (m_note_on_number[i] == note_number) {
+          if (m_note_on_count[note_number] == 0) {
+            voice_off(i);
+          }
+          break;
         }
       }
     }
 
     if (m_note_on_total_count == 0) {
       if (m_voice_mode != VOICE_POLYPHONIC) {
-        m_eg[0].note_off();
-        m_eg[1].note_off();
+        m_eg    [0].note_off();
+        m_amp_eg[0].note_off();
       }
     }
   }
 
   void all_notes_off() {
     m_sustain_pedal = false;
-    m_note_on_number[0] = NOTE_NUMBER_INVALID;
-    m_note_on_number[1] = NOTE_NUMBER_INVALID;
-    m_note_on_number[2] = NOTE_NUMBER_INVALID;
-    m_note_on_number[3] = NOTE_NUMBER_INVALID;
     for (uint8_t i = 0; i < sizeof(m_note_on_count); ++i) {
       m_note_on_count[i] = 0;
     }
     m_note_on_total_count = 0;
-    m_note_queue[0] = 0;
-    m_note_queue[1] = 1;
-    m_note_queue[2] = 2;
-    m_note_queue[3] = 3;
-    m_osc.note_off<0>();
-    m_osc.note_off<1>();
-    m_osc.note_off<2>();
-    m_osc.note_off<3>();
-
-    m_last_note_on_index = 3;
-
-    m_eg[0].note_off();
-    m_eg[1].note_off();
-    m_eg[2].note_off();
-    m_eg[3].note_off();
-    m_eg[4].note_off();
-    m_eg[5].note_off();
-    m_eg[6].note_off();
-    m_eg[7].note_off();
+    for (uint8_t i = 0; i < VOICES; ++i) {
+      m_note_on_number[i] = NOTE_NUMBER_INVALID;
+      m_note_queue[i] = i;
+      m_osc.note_off(i);
+    }
+
+    m_last_note_on_index = VOICES - 1;
+
+    for (uint8_t i = 0; i < VOICES; ++i) {
+      m_eg    [i].note_off();
+      m_amp_eg[i].note_off();
+    }
 
     control_change(SUSTAIN_PEDAL   , 0  );
   }
@@ -866,29 +700,26 @@ public:
       break;
 
     case FILTER_CUTOFF  :
-      m_filter[0].set_cutoff(controller_value);
-      m_filter[1].set_cutoff(controller_value);
-      m_filter[2].set_cutoff(controller_value);
-      m_filter[3].set_cutoff(controller_value);
+      for (uint8_t i = 0; i < VOICES; ++i) {
+        m_filter[i].set_cutoff(controller_value);
+      }
       break;
     case FILTER_RESO    :
-      m_filter[0].set_resonance(controller_value);
-      m_filter[1].set_resonance(controller_value);
-      m_filter[2].set_resonance(controller_value);
-      m_filter[3].set_resonance(controller_value);
+      for (uint8_t i = 0; i < VOICES; ++i) {
+        m_filter[i].set_resonance(controller_value);
+      }
       break;
     case FILTER_EG_AMT  :
-      m_filter[0].set_cutoff_eg_amt(0, controller_value);
-      m_filter[1].set_cutoff_eg_amt(0, controller_value);
-      m_filter[2].set_cutoff_eg_amt(0, controller_value);
-      m_filter[3].set_cutoff_eg_amt(0, controller_value);
+      for (uint8_t i = 0; i < VOICES; ++i) {
+        m_filter[i].set_cutoff_eg_amt(0, controller_value);
+      }
       break;
 
     case OSC_1_WAVE     :
-      m_osc.set_osc_waveform<0>(controller_value);
+      m_osc.set_osc_waveform(0, controller_value);
       break;
     case OSC_2_WAVE     :
-      m_osc.set_osc_waveform<1>(controller_value);
+      m_osc.set_osc_waveform(1, controller_value);
       break;
     case OSC_1_SHAPE    :
       m_osc.set_osc1_shape_control(controller_value);
@@ -911,10 +742,9 @@ public:
       update_lfo_osc_mod();
       break;
     case LFO_FILTER_AMT :
-      m_filter[0].set_cutoff_lfo_amt(0, controller_value);
-      m_filter[1].set_cutoff_lfo_amt(0, controller_value);
-      m_filter[2].set_cutoff_lfo_amt(0, controller_value);
-      m_filter[3].set_cutoff_lfo_amt(0, controller_value);
+      for (uint8_t i = 0; i < VOICES; ++i) {
+        m_filter[i].set_cutoff_lfo_amt(0, controller_value);
+      }
       break;
 
     case SUSTAIN_PEDAL   :
@@ -971,10 +801,9 @@ public:
       break;
 #endif
     case AMP_GAIN       :
-      m_amp[0].set_gain(controller_value);
-      m_amp[1].set_gain(controller_value);
-      m_amp[2].set_gain(controller_value);
-      m_amp[3].set_gain(controller_value);
+      for (uint8_t i = 0; i < VOICES; ++i) {
+        m_amp[i].set_gain(controller_value);
+      }
       break;
 
     case PORTAMENTO     :
@@ -1029,17 +858,15 @@ public:
       break;
 
     case FILTER_MODE    :
-      m_filter[0].set_filter_mode(controller_value);
-      m_filter[1].set_filter_mode(controller_value);
-      m_filter[2].set_filter_mode(controller_value);
-      m_filter[3].set_filter_mode(controller_value);
+      for (uint8_t i = 0; i < VOICES; ++i) {
+        m_filter[i].set_filter_mode(controller_value);
+      }
       break;
 
     case FILTER_KEY_TRK :
-      m_filter[0].set_cutoff_pitch_amt(controller_value);
-      m_filter[1].set_cutoff_pitch_amt(controller_value);
-      m_filter[2].set_cutoff_pitch_amt(controller_value);
-      m_filter[3].set_cutoff_pitch_amt(controller_value);
+      for (uint8_t i = 0; i < VOICES; ++i) {
+        m_filter[i].set_cutoff_pitch_amt(controller_value);
+      }
       break;
 
     case VOICE_MODE     :
@@ -1064,28 +891,24 @@ public:
       break;
 
     case BTH_FILTER_AMT    :
-      m_filter[0].set_cutoff_breath_amt(controller_value);
-      m_filter[1].set_cutoff_breath_amt(controller_value);
-      m_filter[2].set_cutoff_breath_amt(controller_value);
-      m_filter[3].set_cutoff_breath_amt(controller_value);
+      for (uint8_t i = 0; i < VOICES; ++i) {
+        m_filter[i].set_cutoff_breath_amt(controller_value);
+      }
       break;
     case BTH_AMP_MOD    :
-      m_amp[0].set_breath_mod(controller_value);
-      m_amp[1].set_breath_mod(controller_value);
-      m_amp[2].set_breath_mod(controller_value);
-      m_amp[3].set_breath_mod(controller_value);
+      for (uint8_t i = 0; i < VOICES; ++i) {
+        m_amp[i].set_breath_mod(controller_value);
+      }
       break;
     case EG_VEL_SENS    :
-      m_eg[0].set_velocity_sensitivity(controller_value);
-      m_eg[2].set_velocity_sensitivity(controller_value);
-      m_eg[4].set_velocity_sensitivity(controller_value);
-      m_eg[6].set_velocity_sensitivity(controller_value);
+      for (uint8_t i = 0; i < VOICES; ++i) {
+        m_eg[i].set_velocity_sensitivity(controller_value);
+      }
       break;
     case AMP_VEL_SENS   :
-      m_eg[1].set_velocity_sensitivity(controller_value);
-      m_eg[3].set_velocity_sensitivity(controller_value);
-      m_eg[5].set_velocity_sensitivity(controller_value);
-      m_eg[7].set_velocity_sensitivity(controller_value);
+      for (uint8_t i = 0; i < VOICES; ++i) {
+        m_amp_eg[i].set_velocity_sensitivity(controller_value);
+      }
       break;
 
     case BTH_CONTROLLER    :
@@ -1149,6 +972,17 @@ public:
     m_osc.set_pitch_bend(pitch_bend);
   }
 
+  // Acts as the breath controller of the voices playing the note, so that
+  // BTH_FILTER_AMT and BTH_AMP_MOD shape each note by its own pressure
+  /* INLINE */ void polyphonic_key_pressure(uint8_t note_number, uint8_t value) {
+    for (uint8_t i = 0; i < VOICES; ++i) {
+      if (m_note_on_number[i] == note_number) {
+        m_filter[i].set_breath_controller(value);
+        m_amp   [i].set_breath_controller(value);
+      }
+    }
+  }
+
   /* INLINE */ void program_change(uint8_t program_number) {
     if (program_number > PROGRAM_NUMBER_MAX) {
       if ((program_number == 128) || (program_number == 129)) {
@@ -1242,117 +1076,155 @@ public:
 
     int16_t noise_int15 = m_noise_gen.process();
 
-    switch (m_count & (0x04 - 1)) {
-    case 0x00:
-      m_eg[0].process_at_low_rate();
-      m_eg[1].process_at_low_rate();
-      break;
-    case 0x01:
-      m_eg[2].process_at_low_rate();
-      m_eg[3].process_at_low_rate();
-      break;
-    case 0x02:
-      m_eg[4].process_at_low_rate();
-      m_eg[5].process_at_low_rate();
-      break;
-    case 0x03:
-      m_eg[6].process_at_low_rate();
-      m_eg[7].process_at_low_rate();
+    uint8_t phase = m_count & (0x04 - 1);
+
+    if (phase == 0x00) {
+      for (uint8_t i = 1; i < VOICES; ++i) {
+        m_osc.process_at_low_rate_b(i, m_count >> 2, noise_int15);
+      }
+    }
+
+    for (uint8_t i = phase; i < VOICES; i += 4) {
+      process_voice_eg_at_low_rate(i);
+    }
+
+    if (phase == 0x03) {
       m_lfo.process_at_low_rate(m_count >> 2, noise_int15);
-      break;
     }
 
     int16_t lfo_output = m_lfo.get_output();
 
-    switch (m_count & (0x04 - 1)) {
-    case 0x00:
-      {
-        m_osc.process_at_low_rate_a<0>(lfo_output, m_eg[0].get_output());
-        m_osc.process_at_low_rate_b(m_count >> 2, noise_int15);
-        uint16_t osc_pitch_0 = (60 << 8);
-        osc_pitch_0 = m_osc.get_osc_pitch(0);
-        m_filter[0].process_at_low_rate(m_count >> 2, m_eg[0].get_output(), lfo_output, osc_pitch_0);
-        m_amp[0].process_at_low_rate(m_eg[1].get_output());
-      }
-      break;
-    case 0x01:
-      m_osc.process_at_low_rate_a<1>(lfo_output, m_eg[2].get_output());
-      m_filter[1].process_at_low_rate(m_count >> 2, m_eg[2].get_output(), lfo_output, m_osc.get_osc_pitch(1));
-      m_amp[1].process_at_low_rate(m_eg[3].get_output());
-      break;
-    case 0x02:
-      m_osc.process_at_low_rate_a<2>(lfo_output, m_eg[4].get_output());
-      m_filter[2].process_at_low_rate(m_count >> 2, m_eg[4].get_output(), lfo_output, m_osc.get_osc_pitch(2));
-      m_amp[2].process_at_low_rate(m_eg[5].get_output());
+    for (uint8_t i = phase; i < VOICES; i += 4) {
+      process_voice_at_low_rate(i, m_count >> 2, lfo_output, noise_int15);
+    }
+
+    if (phase == 0x02) {
       m_delay_fx.process_at_low_rate(m_count >> 2);
-      break;
-    case 0x03:
-      m_osc.process_at_low_rate_a<3>(lfo_output, m_eg[6].get_output());
-      m_filter[3].process_at_low_rate(m_count >> 2, m_eg[6].get_output(), lfo_output, m_osc.get_osc_pitch(3));
-      m_amp[3].process_at_low_rate(m_eg[7].get_output());
+    } else if (phase == 0x03) {
       m_chorus_fx.process_at_low_rate(m_count >> 2);
-      break;
     }
 
-    int32_t osc_output   [4];
-    int32_t filter_output[4];
-    int32_t amp_output   [4];
-    int32_t voice_mixer_output;
+    int32_t voice_mixer_output = 0;
     if (m_voice_mode == VOICE_POLYPHONIC) {
-#if defined(PRA32_U2_USE_2_CORES_FOR_SIGNAL_PROCESSING)
-      m_secondary_core_processing_argument = noise_int15;
-      m_secondary_core_processing_request = 1;
-#endif  // defined(PRA32_U2_USE_2_CORES_FOR_SIGNAL_PROCESSING)
+      for (uint8_t i = 0; i < VOICES; ++i) {
+        if (m_voice_active[i]) {
+          int32_t osc_output    = m_osc      .process(i, noise_int15);
+          int32_t filter_output = m_filter[i].process(osc_output);
+          voice_mixer_output   += m_amp   [i].process(filter_output);
+        }
+      }
+    } else if (m_voice_active[0]) {
+      int32_t osc_output    = m_osc      .process(0, noise_int15);
+      int32_t filter_output = m_filter[0].process(osc_output);
+      int32_t amp_output    = m_amp   [0].process(filter_output);
 
-      osc_output   [0] = m_osc      .process<0>(noise_int15);
-      filter_output[0] = m_filter[0].process(osc_output   [0]);
-      amp_output   [0] = m_amp   [0].process(filter_output[0]);
+      voice_mixer_output = amp_output + (amp_output >> 1);
+    }
 
-      osc_output   [1] = m_osc      .process<1>(noise_int15);
-      filter_output[1] = m_filter[1].process(osc_output   [1]);
-      amp_output   [1] = m_amp   [1].process(filter_output[1]);
+    int16_t synth_output_r_int16;
+    int16_t synth_output_l_int16 = process_fx(voice_mixer_output, synth_output_r_int16);
+    return process_output(synth_output_l_int16, synth_output_r_int16, noise_int15, right_output_int16);
+  }
 
-      int32_t amp_output_sum_a = amp_output[0] + amp_output[1];
+  // Same output as calling process() `frames` times. The control-rate updates
+  // run once per 4-sample sub-block and each voice is rendered over the whole
+  // block by a tight loop, instead of dispatching on m_count for every sample.
+  // With PRA32_U2_USE_2_CORES_FOR_SIGNAL_PROCESSING, the upper half of the
+  // voices is rendered by secondary_core_process() on the other core, with a
+  // single handshake per block.
+  INLINE void render_block(int16_t* left_output_int16, int16_t* right_output_int16, size_t frames) {
+    size_t i = 0;
+
+    // Align to the start of a control period
+    for (; (i < frames) && ((m_count & (0x04 - 1)) != (0x04 - 1)); ++i) {
+      process_to(left_output_int16, right_output_int16, i);
+    }
 
-#if defined(PRA32_U2_USE_2_CORES_FOR_SIGNAL_PROCESSING)
-      while (m_secondary_core_processing_request) {
-        ;
+    while (i + 4 <= frames) {
+      size_t block_frames = frames - i;
+      if (block_frames > PRA32_U2_RENDER_BLOCK_FRAMES_MAX) {
+        block_frames = PRA32_U2_RENDER_BLOCK_FRAMES_MAX;
       }
-      int32_t amp_output_sum_b = m_secondary_core_processing_result;
-#else  // defined(PRA32_U2_USE_2_CORES_FOR_SIGNAL_PROCESSING)
-      osc_output   [2] = m_osc      .process<2>(noise_int15);
-      filter_output[2] = m_filter[2].process(osc_output   [2]);
-      amp_output   [2] = m_amp   [2].process(filter_output[2]);
+      block_frames &= ~static_cast<size_t>(0x04 - 1);
 
-      osc_output   [3] = m_osc      .process<3>(noise_int15);
-      filter_output[3] = m_filter[3].process(osc_output   [3]);
-      amp_output   [3] = m_amp   [3].process(filter_output[3]);
+      render_sub_blocks(left_output_int16 + i, right_output_int16 ? (right_output_int16 + i) : nullptr, block_frames >> 2);
+      i += block_frames;
+    }
 
-      int32_t amp_output_sum_b = amp_output[2] + amp_output[3];
-#endif  // defined(PRA32_U2_USE_2_CORES_FOR_SIGNAL_PROCESSING)
+    for (; i < frames; ++i) {
+      process_to(left_output_int16, right_output_int16, i);
+    }
+  }
 
-      voice_mixer_output = amp_output_sum_a + amp_output_sum_b;
-    } else {
-#if defined(PRA32_U2_USE_2_CORES_FOR_SIGNAL_PROCESSING)
-      m_secondary_core_processing_argument = 0;
-      m_secondary_core_processing_request = 1;
-#endif  // defined(PRA32_U2_USE_2_CORES_FOR_SIGNAL_PROCESSING)
+  INLINE void render_block(int16_t* output_int16, size_t frames) {
+    render_block(output_int16, nullptr, frames);
+  }
 
-      osc_output[0] = m_osc.process<0>(noise_int15);
-      int32_t osc_mixer_output = osc_output[0];
+  // Renders the upper half of the voices of the block requested by
+  // render_block() on the primary core. Returns true if a block has been
+  // processed.
+  INLINE boolean secondary_core_process() {
+    boolean processed = false;
 
-      filter_output[0] = m_filter[0].process(osc_mixer_output);
-      amp_output   [0] = m_amp   [0].process(filter_output[0]);
+#if defined(PRA32_U2_USE_2_CORES_FOR_SIGNAL_PROCESSING)
+    if (claim_secondary_core_request(2)) {
+      __sync_synchronize();
 
-      voice_mixer_output = amp_output[0] + (amp_output[0] >> 1);
+      int32_t* voice_mixer_output = m_block_voice_mixer_output[1];
+      for (uint32_t i = 0; i < (m_block_sub_blocks * 4); ++i) {
+        voice_mixer_output[i] = 0;
+      }
 
-#if defined(PRA32_U2_USE_2_CORES_FOR_SIGNAL_PROCESSING)
-      while (m_secondary_core_processing_request) {
-        ;
+      for (uint8_t i = SECONDARY_CORE_FIRST_VOICE; i < VOICES; ++i) {
+        render_voice_block(i, voice_mixer_output);
       }
+
+      __sync_synchronize();
+      m_secondary_core_processing_request = 0;
+      processed = true;
+    }
 #endif  // defined(PRA32_U2_USE_2_CORES_FOR_SIGNAL_PROCESSING)
+
+    return processed;
+  }
+
+  // While disabled, render_block() renders all the voices on the primary core.
+  // A block that has already been requested still has to be processed, see
+  // is_secondary_core_busy().
+  INLINE void set_secondary_core_enabled(boolean enabled) {
+    m_secondary_core_enabled = enabled;
+  }
+
+  INLINE boolean is_secondary_core_busy() {
+    return m_secondary_core_processing_request != 0;
+  }
+
+  INLINE void get_rand_uint8_array(uint8_t array[8]) {
+    m_noise_gen.get_rand_uint8_array(array);
+  }
+
+private:
+
+  // Moves a pending request on to the given state, atomically with respect to
+  // the other core and to interrupts if PRA32_U2_SECONDARY_CORE_CLAIM_BEGIN()
+  // and PRA32_U2_SECONDARY_CORE_CLAIM_END() are defined. Without them, the
+  // primary core never takes a request back and waits for the secondary core.
+  INLINE boolean claim_secondary_core_request(uint32_t state) {
+    boolean claimed = false;
+#if defined(PRA32_U2_SECONDARY_CORE_CLAIM_BEGIN)
+    PRA32_U2_SECONDARY_CORE_CLAIM_BEGIN();
+#endif  // defined(PRA32_U2_SECONDARY_CORE_CLAIM_BEGIN)
+    if (m_secondary_core_processing_request == 1) {
+      m_secondary_core_processing_request = state;
+      claimed = true;
     }
+#if defined(PRA32_U2_SECONDARY_CORE_CLAIM_BEGIN)
+    PRA32_U2_SECONDARY_CORE_CLAIM_END();
+#endif  // defined(PRA32_U2_SECONDARY_CORE_CLAIM_BEGIN)
+    return claimed;
+  }
 
+  INLINE int16_t process_fx(int32_t voice_mixer_output, int16_t& right_output_int16) {
     int32_t chorus_fx_output_r;
     int32_t chorus_fx_output_l = m_chorus_fx.process(voice_mixer_output, voice_mixer_output, chorus_fx_output_r);
 
@@ -1374,9 +1246,20 @@ public:
     synth_output_r_clamped = (synth_output_r_clamped > 0) * synth_output_r_clamped + (-(INT16_MAX << 8));
     synth_output_r = synth_output_r_clamped;
 
-    int16_t synth_output_l_int16 = (synth_output_l >> 8);
-    int16_t synth_output_r_int16 = (synth_output_r >> 8);
+    right_output_int16 = (synth_output_r >> 8);
+    return               (synth_output_l >> 8);
+  }
+
+  INLINE void process_to(int16_t* left_output_int16, int16_t* right_output_int16, size_t i) {
+    int16_t right_output;
+    left_output_int16[i] = process(right_output);
+    if (right_output_int16) {
+      right_output_int16[i] = right_output;
+    }
+  }
 
+  INLINE int16_t process_output(int16_t synth_output_l_int16, int16_t synth_output_r_int16, int16_t noise_int15,
+                                int16_t& right_output_int16) {
 #if defined(PRA32_U2_USE_PWM_AUDIO_INSTEAD_OF_I2S)
 #if defined(PRA32_U2_USE_PWM_AUDIO_DITHERING_INSTEAD_OF_ERROR_DIFFUSION)
     // Dithering
@@ -1405,84 +1288,262 @@ public:
     return               synth_output_l_int16 + (prev_output_error_l > s_output_error_l) * 22;
 #endif  // defined(PRA32_U2_USE_PWM_AUDIO_DITHERING_INSTEAD_OF_ERROR_DIFFUSION)
 #else  // defined(PRA32_U2_USE_PWM_AUDIO_INSTEAD_OF_I2S)
+    static_cast<void>(noise_int15);
     right_output_int16 = synth_output_r_int16;
     return               synth_output_l_int16;
 #endif  // defined(PRA32_U2_USE_PWM_AUDIO_INSTEAD_OF_I2S)
   }
 
-  INLINE boolean secondary_core_process() {
-    boolean processed = false;
+  INLINE void process_voice_eg_at_low_rate(uint8_t voice) {
+    m_eg    [voice].process_at_low_rate();
+    m_amp_eg[voice].process_at_low_rate();
+  }
 
-#if defined(PRA32_U2_USE_2_CORES_FOR_SIGNAL_PROCESSING)
-    if (m_secondary_core_processing_request == 1) {
-      int16_t noise_int15 = static_cast<int16_t>(m_secondary_core_processing_argument);
+  // Control-rate update of a voice after the one of its EGs, including the
+  // osc update of phase 0 for voice 0. A voice becomes inactive once its amp EG
+  // is silent and is then skipped until the next note on, which resets the
+  // state that would have moved on in the meantime.
+  INLINE void process_voice_at_low_rate(uint8_t voice, uint32_t count_high, int16_t lfo_output, int16_t noise_int15) {
+    boolean active = !m_amp_eg[voice].is_silent(PRA32_U2_VOICE_SILENCE_LEVEL);
 
-      int32_t osc_output   [4];
-      int32_t filter_output[4];
-      int32_t amp_output   [4];
+    if (active) {
+      if (m_voice_active[voice] == false) {
+        m_osc.reset(voice, lfo_output, m_eg[voice].get_output());
+      }
+      m_osc.process_at_low_rate_a(voice, lfo_output, m_eg[voice].get_output());
+    }
 
-      if (m_voice_mode == VOICE_POLYPHONIC) {
-        osc_output   [2] = m_osc      .process<2>(noise_int15);
-        filter_output[2] = m_filter[2].process(osc_output   [2]);
-        amp_output   [2] = m_amp   [2].process(filter_output[2]);
+    if (voice == 0) {
+      m_osc.process_at_low_rate_b(0, count_high, noise_int15);
+    }
 
-        osc_output   [3] = m_osc      .process<3>(noise_int15);
-        filter_output[3] = m_filter[3].process(osc_output   [3]);
-        amp_output   [3] = m_amp   [3].process(filter_output[3]);
+    if (active) {
+      uint16_t osc_pitch = m_osc.get_osc_pitch(voice);
+      if (m_voice_active[voice] == false) {
+        m_filter[voice].reset(m_eg[voice].get_output(), lfo_output, osc_pitch);
+        m_amp   [voice].reset();
+      }
+      m_filter[voice].process_at_low_rate(count_high, m_eg[voice].get_output(), lfo_output, osc_pitch);
+      m_amp   [voice].process_at_low_rate(m_amp_eg[voice].get_output());
+    }
 
-        m_secondary_core_processing_result = amp_output[2] + amp_output[3];
-      } else {
-        m_secondary_core_processing_result = 0;
+    m_voice_active[voice] = active;
+  }
+
+  INLINE void render_voice_samples(uint8_t voice, const int16_t noise_int15[], int32_t output[], uint32_t begin, uint32_t end) {
+    for (uint32_t j = begin; j < end; ++j) {
+      int32_t osc_output    = m_osc          .process(voice, noise_int15[j]);
+      int32_t filter_output = m_filter[voice].process(osc_output);
+      output[j]            += m_amp   [voice].process(filter_output);
+    }
+  }
+
+  // Renders a voice over the block prepared by render_sub_blocks() and adds it
+  // to voice_mixer_output. As in process(), the voice gets its control-rate
+  // update right before sample (voice % 4) of each control period, and the
+  // voices other than voice 0 see the osc update of phase 0 before their own
+  // one. Voices only depend on the shared noise and LFO values, so they can be
+  // rendered in any order.
+  INLINE void render_voice_block(uint8_t voice, int32_t voice_mixer_output[]) {
+    boolean audible = (voice == 0) || (m_voice_mode == VOICE_POLYPHONIC);
+    uint8_t phase   = voice & (0x04 - 1);
+
+    for (uint32_t s = 0; s < m_block_sub_blocks; ++s) {
+      uint32_t       count_high  = m_block_count_high + s;
+      const int16_t* noise_int15 = &m_block_noise_int15[s * 4];
+      int16_t        lfo_output  = m_block_lfo_output[(s * 2) + (phase == 0x03)];
+      int32_t*       output      = &voice_mixer_output[s * 4];
+
+      if (voice != 0) {
+        m_osc.process_at_low_rate_b(voice, count_high, noise_int15[0]);
       }
 
-      m_secondary_core_processing_request = 0;
-      processed = true;
+      if (audible && m_voice_active[voice]) {
+        render_voice_samples(voice, noise_int15, output, 0, phase);
+      }
+
+      process_voice_eg_at_low_rate(voice);
+      process_voice_at_low_rate(voice, count_high, lfo_output, noise_int15[0]);
+
+      if (audible && m_voice_active[voice]) {
+        render_voice_samples(voice, noise_int15, output, phase, 4);
+      }
+    }
+  }
+
+  // Renders `sub_blocks` control periods, starting at phase 0
+  INLINE void render_sub_blocks(int16_t* left_output_int16, int16_t* right_output_int16, uint32_t sub_blocks) {
+    uint32_t count_high = (m_count >> 2) + 1;
+    uint32_t frames = sub_blocks * 4;
+
+    // The noise and the LFO are shared by all the voices. The LFO is updated at
+    // phase 3, after the control-rate updates of the voices of phases 0 to 2
+    // but before the ones of phase 3.
+    for (uint32_t s = 0; s < sub_blocks; ++s) {
+      for (uint32_t j = 0; j < 4; ++j) {
+        m_block_noise_int15[(s * 4) + j] = m_noise_gen.process();
+      }
+
+      m_block_lfo_output[(s * 2) + 0] = m_lfo.get_output();
+      m_lfo.process_at_low_rate(count_high + s, m_block_noise_int15[(s * 4) + 3]);
+      m_block_lfo_output[(s * 2) + 1] = m_lfo.get_output();
+    }
+
+    m_count += frames;
+    m_block_count_high = count_high;
+    m_block_sub_blocks = sub_blocks;
+
+    int32_t* voice_mixer_output = m_block_voice_mixer_output[0];
+    for (uint32_t i = 0; i < frames; ++i) {
+      voice_mixer_output[i] = 0;
     }
+
+#if defined(PRA32_U2_USE_2_CORES_FOR_SIGNAL_PROCESSING)
+    boolean secondary_core_requested = m_secondary_core_enabled;
+    if (secondary_core_requested) {
+      __sync_synchronize();
+      m_secondary_core_processing_request = 1;
+#if defined(PRA32_U2_SECONDARY_CORE_NOTIFY)
+      PRA32_U2_SECONDARY_CORE_NOTIFY();
+#endif  // defined(PRA32_U2_SECONDARY_CORE_NOTIFY)
+    }
+#else  // defined(PRA32_U2_USE_2_CORES_FOR_SIGNAL_PROCESSING)
+    boolean secondary_core_requested = false;
 #endif  // defined(PRA32_U2_USE_2_CORES_FOR_SIGNAL_PROCESSING)
 
-    return processed;
-  }
+    for (uint8_t i = 0; i < SECONDARY_CORE_FIRST_VOICE; ++i) {
+      render_voice_block(i, voice_mixer_output);
+    }
 
-  INLINE void get_rand_uint8_array(uint8_t array[8]) {
-    m_noise_gen.get_rand_uint8_array(array);
+#if defined(PRA32_U2_SECONDARY_CORE_CLAIM_BEGIN)
+    // The secondary core has not started on its half, such as while it runs
+    // with interrupts disabled: take the half back rather than wait on it
+    if (secondary_core_requested && claim_secondary_core_request(0)) {
+      secondary_core_requested = false;
+    }
+#endif  // defined(PRA32_U2_SECONDARY_CORE_CLAIM_BEGIN)
+
+    if (secondary_core_requested) {
+      while (m_secondary_core_processing_request) {
+        ;
+      }
+      __sync_synchronize();
+
+      for (uint32_t i = 0; i < frames; ++i) {
+        voice_mixer_output[i] += m_block_voice_mixer_output[1][i];
+      }
+    } else {
+      for (uint8_t i = SECONDARY_CORE_FIRST_VOICE; i < VOICES; ++i) {
+        render_voice_block(i, voice_mixer_output);
+      }
+    }
+
+    if (m_voice_mode != VOICE_POLYPHONIC) {
+      for (uint32_t i = 0; i < frames; ++i) {
+        voice_mixer_output[i] += (voice_mixer_output[i] >> 1);
+      }
+    }
+
+    for (uint32_t s = 0; s < sub_blocks; ++s) {
+      for (uint32_t j = 0; j < 4; ++j) {
+        uint32_t i = (s * 4) + j;
+
+        if (j == 2) {
+          m_delay_fx.process_at_low_rate(count_high + s);
+        } else if (j == 3) {
+          m_chorus_fx.process_at_low_rate(count_high + s);
+        }
+
+        int16_t synth_output_r_int16;
+        int16_t synth_output_l_int16 = process_fx(voice_mixer_output[i], synth_output_r_int16);
+
+        int16_t right_output;
+        left_output_int16[i] = process_output(synth_output_l_int16, synth_output_r_int16, m_block_noise_int15[i], right_output);
+        if (right_output_int16) {
+          right_output_int16[i] = right_output;
+        }
+      }
+    }
   }
 
-private:
+  // Voice assignment of a new note, see VOICE_ASGN_MODE
+  INLINE uint8_t get_note_on_osc_index() {
+    uint8_t first_index = 0;
+    if (m_voice_asgn_mode == 1) {
+      first_index = m_last_note_on_index + 1;
+      if (first_index >= VOICES) {
+        first_index = 0;
+      }
+    }
+
+    for (uint8_t i = 0; i < VOICES; ++i) {
+      uint8_t index = first_index + i;
+      if (index >= VOICES) {
+        index -= VOICES;
+      }
 
+      if (m_note_on_number[index] == NOTE_NUMBER_INVALID) {
+        return index;
+      }
+    }
+
+    return m_note_queue[0];
+  }
+
+  // m_note_queue[] lists the voices from the least recently to the most recently used one
   INLINE void note_queue_on(uint8_t note_on_osc_index) {
-    if        (m_note_queue[3] == note_on_osc_index) {
-      m_note_queue[3] = note_on_osc_index;
-    } else if (m_note_queue[2] == note_on_osc_index) {
-      m_note_queue[2] = m_note_queue[3];
-      m_note_queue[3] = note_on_osc_index;
-    } else if (m_note_queue[1] == note_on_osc_index) {
-      m_note_queue[1] = m_note_queue[2];
-      m_note_queue[2] = m_note_queue[3];
-      m_note_queue[3] = note_on_osc_index;
-    } else {
-      m_note_queue[0] = m_note_queue[1];
-      m_note_queue[1] = m_note_queue[2];
-      m_note_queue[2] = m_note_queue[3];
-      m_note_queue[3] = note_on_osc_index;
+    uint8_t i = VOICES - 1;
+    while ((i > 0) && (m_note_queue[i] != note_on_osc_index)) {
+      --i;
+    }
+
+    for (; i < VOICES - 1; ++i) {
+      m_note_queue[i] = m_note_queue[i + 1];
     }
+    m_note_queue[VOICES - 1] = note_on_osc_index;
   }
 
   INLINE void note_queue_off(uint8_t note_off_osc_index) {
-    if        (m_note_queue[1] == note_off_osc_index) {
-      m_note_queue[1] = m_note_queue[0];
-      m_note_queue[0] = note_off_osc_index;
-    } else if (m_note_queue[2] == note_off_osc_index) {
-      m_note_queue[2] = m_note_queue[1];
-      m_note_queue[1] = m_note_queue[0];
-      m_note_queue[0] = note_off_osc_index;
-    } else if (m_note_queue[3] == note_off_osc_index) {
-      m_note_queue[3] = m_note_queue[2];
-      m_note_queue[2] = m_note_queue[1];
-      m_note_queue[1] = m_note_queue[0];
+    uint8_t i = 1;
+    while ((i < VOICES) && (m_note_queue[i] != note_off_osc_index)) {
+      ++i;
+    }
+
+    if (i < VOICES) {
+      for (; i > 0; --i) {
+        m_note_queue[i] = m_note_queue[i - 1];
+      }
       m_note_queue[0] = note_off_osc_index;
     }
   }
 
+  INLINE void voice_off(uint8_t note_off_osc_index) {
+    m_note_on_number[note_off_osc_index] = NOTE_NUMBER_INVALID;
+    note_queue_off(note_off_osc_index);
+    m_osc.note_off(note_off_osc_index);
+
+    if (m_voice_mode == VOICE_POLYPHONIC) {
+      m_eg    [note_off_osc_index].note_off();
+      m_amp_eg[note_off_osc_index].note_off();
+    }
+  }
+
+  // In the monophonic modes, m_note_on_number[] is the stack of the held notes
+  // (the last one first)
+  INLINE void note_stack_push(uint8_t note_number) {
+    for (uint8_t i = VOICES - 1; i > 0; --i) {
+      m_note_on_number[i] = m_note_on_number[i - 1];
+    }
+    m_note_on_number[0] = note_number;
+  }
+
+  INLINE void note_stack_remove(uint8_t index) {
+    for (uint8_t i = index; i < VOICES - 1; ++i) {
+      m_note_on_number[i] = m_note_on_number[i + 1];
+    }
+    m_note_on_number[VOICES - 1] = NOTE_NUMBER_INVALID;
+  }
+
   INLINE void set_voice_mode(uint8_t controller_value) {
 #if defined(PRA32_U2_USE_2_CORES_FOR_SIGNAL_PROCESSING)
     static uint8_t voice_mode_table[6] = {
@@ -1524,14 +1585,18 @@ private:
   }
 
   INLINE void set_breath_controller(uint8_t controller_value) {
-    m_filter[0].set_breath_controller(controller_value);
-    m_filter[1].set_breath_controller(controller_value);
-    m_filter[2].set_breath_controller(controller_value);
-    m_filter[3].set_breath_controller(controller_value);
-    m_amp[0].set_breath_controller(controller_value);
-    m_amp[1].set_breath_controller(controller_value);
-    m_amp[2].set_breath_controller(controller_value);
-    m_amp[3].set_breath_controller(controller_value);
+    for (uint8_t i = 0; i < VOICES; ++i) {
+      m_filter[i].set_breath_controller(controller_value);
+      m_amp   [i].set_breath_controller(controller_value);
+    }
+  }
+
+  // A note starts from the channel breath controller, not from the pressure
+  // left on its voice by the note played before, see polyphonic_key_pressure()
+  INLINE void reset_voice_pressure(uint8_t index) {
+    uint8_t controller_value = m_current_controller_value_table[BTH_CONTROLLER];
+    m_filter[index].set_breath_controller(controller_value);
+    m_amp   [index].set_breath_controller(controller_value);
   }
 
   INLINE void set_sustain_pedal(uint8_t controller_value) {
@@ -1540,62 +1605,18 @@ private:
     } else if (m_sustain_pedal && (controller_value < 64)) {
       m_sustain_pedal = false;
 
-      if (m_note_on_number[0] != NOTE_NUMBER_INVALID) {
-        if (m_note_on_count[m_note_on_number[0]] == 0) {
-          m_note_on_number[0] = NOTE_NUMBER_INVALID;
-          note_queue_off(0);
-          m_osc.note_off<0>();
-
-          if (m_voice_mode == VOICE_POLYPHONIC) {
-            m_eg[0].note_off();
-            m_eg[1].note_off();
-          }
-        }
-      }
-
-      if (m_note_on_number[1] != NOTE_NUMBER_INVALID) {
-        if (m_note_on_count[m_note_on_number[1]] == 0) {
-          m_note_on_number[1] = NOTE_NUMBER_INVALID;
-          note_queue_off(1);
-          m_osc.note_off<1>();
-
-          if (m_voice_mode == VOICE_POLYPHONIC) {
-            m_eg[2].note_off();
-            m_eg[3].note_off();
-          }
-        }
-      }
-
-      if (m_note_on_number[2] != NOTE_NUMBER_INVALID) {
-        if (m_note_on_count[m_note_on_number[2]] == 0) {
-          m_note_on_number[2] = NOTE_NUMBER_INVALID;
-          note_queue_off(2);
-          m_osc.note_off<2>();
-
-          if (m_voice_mode == VOICE_POLYPHONIC) {
-            m_eg[4].note_off();
-            m_eg[5].note_off();
-          }
-        }
-      }
-
-      if (m_note_on_number[3] != NOTE_NUMBER_INVALID) {
-        if (m_note_on_count[m_note_on_number[3]] == 0) {
-          m_note_on_number[3] = NOTE_NUMBER_INVALID;
-          note_queue_off(3);
-          m_osc.note_off<3>();
-
-          if (m_voice_mode == VOICE_POLYPHONIC) {
-            m_eg[6].note_off();
-            m_eg[7].note_off();
+      for (uint8_t i = 0; i < VOICES; ++i) {
+        if (m_note_on_number[i] != NOTE_NUMBER_INVALID) {
+          if (m_note_on_count[m_note_on_number[i]] == 0) {
+            voice_off(i);
           }
         }
       }
 
       if (m_note_on_total_count == 0) {
         if (m_voice_mode != VOICE_POLYPHONIC) {
-          m_eg[0].note_off();
-          m_eg[1].note_off();
+          m_eg    [0].note_off();
+          m_amp_eg[0].note_off();
         }
       }
     }
@@ -1603,171 +1624,98 @@ private:
 
   INLINE void update_eg_osc_mod() {
     if        (m_eg_osc_dst >= 89) {  /* MOD_DST_SHAPE_1 */
-      m_osc.set_pitch_eg_amt<0>(64);
-      m_osc.set_pitch_eg_amt<1>(64);
+      m_osc.set_pitch_eg_amt(0, 64);
+      m_osc.set_pitch_eg_amt(1, 64);
       m_osc.set_shape_eg_amt(m_eg_osc_amt);
-      m_filter[0].set_cutoff_eg_amt(1, 64);
-      m_filter[1].set_cutoff_eg_amt(1, 64);
-      m_filter[2].set_cutoff_eg_amt(1, 64);
-      m_filter[3].set_cutoff_eg_amt(1, 64);
+      for (uint8_t i = 0; i < VOICES; ++i) {
+        m_filter[i].set_cutoff_eg_amt(1, 64);
+      }
     } else if (m_eg_osc_dst >= 39) {  /* MOD_DST_PITCH_2 */
-      m_osc.set_pitch_eg_amt<0>(64);
-      m_osc.set_pitch_eg_amt<1>(m_eg_osc_amt);
+      m_osc.set_pitch_eg_amt(0, 64);
+      m_osc.set_pitch_eg_amt(1, m_eg_osc_amt);
       m_osc.set_shape_eg_amt(64);
-      m_filter[0].set_cutoff_eg_amt(1, 64);
-      m_filter[1].set_cutoff_eg_amt(1, 64);
-      m_filter[2].set_cutoff_eg_amt(1, 64);
-      m_filter[3].set_cutoff_eg_amt(1, 64);
+      for (uint8_t i = 0; i < VOICES; ++i) {
+        m_filter[i].set_cutoff_eg_amt(1, 64);
+      }
     } else if (m_eg_osc_dst >= 13) {  /* MOD_DST_CUTOFF */
-      m_osc.set_pitch_eg_amt<0>(64);
-      m_osc.set_pitch_eg_amt<1>(64);
+      m_osc.set_pitch_eg_amt(0, 64);
+      m_osc.set_pitch_eg_amt(1, 64);
       m_osc.set_shape_eg_amt(64);
-      m_filter[0].set_cutoff_eg_amt(1, m_eg_osc_amt);
-      m_filter[1].set_cutoff_eg_amt(1, m_eg_osc_amt);
-      m_filter[2].set_cutoff_eg_amt(1, m_eg_osc_amt);
-      m_filter[3].set_cutoff_eg_amt(1, m_eg_osc_amt);
+      for (uint8_t i = 0; i < VOICES; ++i) {
+        m_filter[i].set_cutoff_eg_amt(1, m_eg_osc_amt);
+      }
     } else {                          /* MOD_DST_PITCH */
-      m_osc.set_pitch_eg_amt<0>(m_eg_osc_amt);
-      m_osc.set_pitch_eg_amt<1>(m_eg_osc_amt);
+      m_osc.set_pitch_eg_amt(0, m_eg_osc_amt);
+      m_osc.set_pitch_eg_amt(1, m_eg_osc_amt);
       m_osc.set_shape_eg_amt(64);
-      m_filter[0].set_cutoff_eg_amt(1, 64);
-      m_filter[1].set_cutoff_eg_amt(1, 64);
-      m_filter[2].set_cutoff_eg_amt(1, 64);
-      m_filter[3].set_cutoff_eg_amt(1, 64);
+      for (uint8_t i = 0; i < VOICES; ++i) {
+        m_filter[i].set_cutoff_eg_amt(1, 64);
+      }
     }
   }
 
   INLINE void update_lfo_osc_mod() {
     if        (m_lfo_osc_dst >= 89) {  /* MOD_DST_SHAPE_1 */
-      m_osc.set_pitch_lfo_amt<0>(64);
-      m_osc.set_pitch_lfo_amt<1>(64);
+      m_osc.set_pitch_lfo_amt(0, 64);
+      m_osc.set_pitch_lfo_amt(1, 64);
       m_osc.set_shape_lfo_amt(m_lfo_osc_amt);
-      m_filter[0].set_cutoff_lfo_amt(1, 64);
-      m_filter[1].set_cutoff_lfo_amt(1, 64);
-      m_filter[2].set_cutoff_lfo_amt(1, 64);
-      m_filter[3].set_cutoff_lfo_amt(1, 64);
+      for (uint8_t i = 0; i < VOICES; ++i) {
+        m_filter[i].set_cutoff_lfo_amt(1, 64);
+      }
     } else if (m_lfo_osc_dst >= 39) {  /* MOD_DST_PITCH_2 */
-      m_osc.set_pitch_lfo_amt<0>(64);
-      m_osc.set_pitch_lfo_amt<1>(m_lfo_osc_amt);
+      m_osc.set_pitch_lfo_amt(0, 64);
+      m_osc.set_pitch_lfo_amt(1, m_lfo_osc_amt);
       m_osc.set_shape_lfo_amt(64);
-      m_filter[0].set_cutoff_lfo_amt(1, 64);
-      m_filter[1].set_cutoff_lfo_amt(1, 64);
-      m_filter[2].set_cutoff_lfo_amt(1, 64);
-      m_filter[3].set_cutoff_lfo_amt(1, 64);
+      for (uint8_t i = 0; i < VOICES; ++i) {
+        m_filter[i].set_cutoff_lfo_amt(1, 64);
+      }
     } else if (m_lfo_osc_dst >= 13) {  /* MOD_DST_CUTOFF */
-      m_osc.set_pitch_lfo_amt<0>(64);
-      m_osc.set_pitch_lfo_amt<1>(64);
+      m_osc.set_pitch_lfo_amt(0, 64);
+      m_osc.set_pitch_lfo_amt(1, 64);
       m_osc.set_shape_lfo_amt(64);
-      m_filter[0].set_cutoff_lfo_amt(1, m_lfo_osc_amt);
-      m_filter[1].set_cutoff_lfo_amt(1, m_lfo_osc_amt);
-      m_filter[2].set_cutoff_lfo_amt(1, m_lfo_osc_amt);
-      m_filter[3].set_cutoff_lfo_amt(1, m_lfo_osc_amt);
+      for (uint8_t i = 0; i < VOICES; ++i) {
+        m_filter[i].set_cutoff_lfo_amt(1, m_lfo_osc_amt);
+      }
     } else {                           /* MOD_DST_PITCH */
-      m_osc.set_pitch_lfo_amt<0>(m_lfo_osc_amt);
-      m_osc.set_pitch_lfo_amt<1>(m_lfo_osc_amt);
+      m_osc.set_pitch_lfo_amt(0, m_lfo_osc_amt);
+      m_osc.set_pitch_lfo_amt(1, m_lfo_osc_amt);
       m_osc.set_shape_lfo_amt(64);
-      m_filter[0].set_cutoff_lfo_amt(1, 64);
-      m_filter[1].set_cutoff_lfo_amt(1, 64);
-      m_filter[2].set_cutoff_lfo_amt(1, 64);
-      m_filter[3].set_cutoff_lfo_amt(1, 64);
+      for (uint8_t i = 0; i < VOICES; ++i) {
+        m_filter[i].set_cutoff_lfo_amt(1, 64);
+      }
     }
   }
 
   INLINE void update_eg_and_amp_eg() {
+    uint8_t amp_attack  = m_controller_value_amp_attack;
+    uint8_t amp_decay   = m_controller_value_amp_decay;
+    uint8_t amp_sustain = m_controller_value_amp_sustain;
+    uint8_t amp_release = m_controller_value_amp_release;
     if (m_controller_value_eg_amp_mod >= 64) {
-      m_eg[0].set_attack  (m_controller_value_eg_attack);
-      m_eg[1].set_attack  (m_controller_value_eg_attack);
-      m_eg[2].set_attack  (m_controller_value_eg_attack);
-      m_eg[3].set_attack  (m_controller_value_eg_attack);
-      m_eg[4].set_attack  (m_controller_value_eg_attack);
-      m_eg[5].set_attack  (m_controller_value_eg_attack);
-      m_eg[6].set_attack  (m_controller_value_eg_attack);
-      m_eg[7].set_attack  (m_controller_value_eg_attack);
-
-      m_eg[0].set_decay   (m_controller_value_eg_decay);
-      m_eg[1].set_decay   (m_controller_value_eg_decay);
-      m_eg[2].set_decay   (m_controller_value_eg_decay);
-      m_eg[3].set_decay   (m_controller_value_eg_decay);
-      m_eg[4].set_decay   (m_controller_value_eg_decay);
-      m_eg[5].set_decay   (m_controller_value_eg_decay);
-      m_eg[6].set_decay   (m_controller_value_eg_decay);
-      m_eg[7].set_decay   (m_controller_value_eg_decay);
-
-      m_eg[0].set_sustain (m_controller_value_eg_sustain);
-      m_eg[1].set_sustain (m_controller_value_eg_sustain);
-      m_eg[2].set_sustain (m_controller_value_eg_sustain);
-      m_eg[3].set_sustain (m_controller_value_eg_sustain);
-      m_eg[4].set_sustain (m_controller_value_eg_sustain);
-      m_eg[5].set_sustain (m_controller_value_eg_sustain);
-      m_eg[6].set_sustain (m_controller_value_eg_sustain);
-      m_eg[7].set_sustain (m_controller_value_eg_sustain);
-
-      if (m_controller_value_rel_eq_decay >= 64) {
-        m_eg[0].set_release (m_controller_value_eg_decay);
-        m_eg[1].set_release (m_controller_value_eg_decay);
-        m_eg[2].set_release (m_controller_value_eg_decay);
-        m_eg[3].set_release (m_controller_value_eg_decay);
-        m_eg[4].set_release (m_controller_value_eg_decay);
-        m_eg[5].set_release (m_controller_value_eg_decay);
-        m_eg[6].set_release (m_controller_value_eg_decay);
-        m_eg[7].set_release (m_controller_value_eg_decay);
-      } else {
-        m_eg[0].set_release (m_controller_value_eg_release);
-        m_eg[1].set_release (m_controller_value_eg_release);
-        m_eg[2].set_release (m_controller_value_eg_release);
-        m_eg[3].set_release (m_controller_value_eg_release);
-        m_eg[4].set_release (m_controller_value_eg_release);
-        m_eg[5].set_release (m_controller_value_eg_release);
-        m_eg[6].set_release (m_controller_value_eg_release);
-        m_eg[7].set_release (m_controller_value_eg_release);
-      }
-    } else {
-      m_eg[0].set_attack  (m_controller_value_eg_attack);
-      m_eg[1].set_attack  (m_controller_value_amp_attack);
-      m_eg[2].set_attack  (m_controller_value_eg_attack);
-      m_eg[3].set_attack  (m_controller_value_amp_attack);
-      m_eg[4].set_attack  (m_controller_value_eg_attack);
-      m_eg[5].set_attack  (m_controller_value_amp_attack);
-      m_eg[6].set_attack  (m_controller_value_eg_attack);
-      m_eg[7].set_attack  (m_controller_value_amp_attack);
-
-      m_eg[0].set_decay   (m_controller_value_eg_decay);
-      m_eg[1].set_decay   (m_controller_value_amp_decay);
-      m_eg[2].set_decay   (m_controller_value_eg_decay);
-      m_eg[3].set_decay   (m_controller_value_amp_decay);
-      m_eg[4].set_decay   (m_controller_value_eg_decay);
-      m_eg[5].set_decay   (m_controller_value_amp_decay);
-      m_eg[6].set_decay   (m_controller_value_eg_decay);
-      m_eg[7].set_decay   (m_controller_value_amp_decay);
-
-      m_eg[0].set_sustain (m_controller_value_eg_sustain);
-      m_eg[1].set_sustain (m_controller_value_amp_sustain);
-      m_eg[2].set_sustain (m_controller_value_eg_sustain);
-      m_eg[3].set_sustain (m_controller_value_amp_sustain);
-      m_eg[4].set_sustain (m_controller_value_eg_sustain);
-      m_eg[5].set_sustain (m_controller_value_amp_sustain);
-      m_eg[6].set_sustain (m_controller_value_eg_sustain);
-      m_eg[7].set_sustain (m_controller_value_amp_sustain);
-
-      if (m_controller_value_rel_eq_decay >= 64) {
-        m_eg[0].set_release (m_controller_value_eg_decay);
-        m_eg[1].set_release (m_controller_value_amp_decay);
-        m_eg[2].set_release (m_controller_value_eg_decay);
-        m_eg[3].set_release (m_controller_value_amp_decay);
-        m_eg[4].set_release (m_controller_value_eg_decay);
-        m_eg[5].set_release (m_controller_value_amp_decay);
-        m_eg[6].set_release (m_controller_value_eg_decay);
-        m_eg[7].set_release (m_controller_value_amp_decay);
-      } else {
-        m_eg[0].set_release (m_controller_value_eg_release);
-        m_eg[1].set_release (m_controller_value_amp_release);
-        m_eg[2].set_release (m_controller_value_eg_release);
-        m_eg[3].set_release (m_controller_value_amp_release);
-        m_eg[4].set_release (m_controller_value_eg_release);
-        m_eg[5].set_release (m_controller_value_amp_release);
-        m_eg[6].set_release (m_controller_value_eg_release);
-        m_eg[7].set_release (m_controller_value_amp_release);
-      }
+      amp_attack  = m_controller_value_eg_attack;
+      amp_decay   = m_controller_value_eg_decay;
+      amp_sustain = m_controller_value_eg_sustain;
+      amp_release = m_controller_value_eg_release;
+    }
+
+    uint8_t eg_release = m_controller_value_eg_release;
+    if (m_controller_value_rel_eq_decay >= 64) {
+      eg_release  = m_controller_value_eg_decay;
+      amp_release = amp_decay;
+    }
+
+    for (uint8_t i = 0; i < VOICES; ++i) {
+      m_eg    [i].set_attack  (m_controller_value_eg_attack);
+      m_eg    [i].set_decay   (m_controller_value_eg_decay);
+      m_eg    [i].set_sustain (m_controller_value_eg_sustain);
+      m_eg    [i].set_release (eg_release);
+
+      m_amp_eg[i].set_attack  (amp_attack);
+      m_amp_eg[i].set_decay   (amp_decay);
+      m_amp_eg[i].set_sustain (amp_sustain);
+      m_amp_eg[i].set_release (amp_release);
     }
   }
 };
+
+typedef PRA32_U2_SynthN<PRA32_U2_NUM_VOICES> PRA32_U2_Synth;
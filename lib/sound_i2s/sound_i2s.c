@@ -7,6 +7,7 @@
 #include "hardware/pio.h"
 #include "hardware/dma.h"
 #include "hardware/irq.h"
+#include "hardware/sync.h"
 
 #include "sound_i2s.h"
 #include "sound_i2s_16bits.pio.h"
@@ -23,10 +24,14 @@ static void *sound_sample_buffers[2];
 
 static void __isr __time_critical_func(dma_handler)(void)
 {
+  // count the buffer before swapping, so that a core that sees the new
+  // buffer also sees the updated count
+  sound_i2s_num_buffers_played++;
+  __dmb();
+
   // swap buffers
   uint cur_buf = !sound_cur_buffer_num;
   sound_cur_buffer_num = cur_buf;
-  sound_i2s_num_buffers_played++;
 
   // set dma dest to new buffer and re-trigger dma:
   dma_hw->ch[sound_dma_chan].al3_read_addr_trig = (uintptr_t) sound_sample_buffers[cur_buf];
@@ -96,3 +101,27 @@ int16_t *sound_i2s_get_buffer(int buffer_num)
 {
   return sound_sample_buffers[buffer_num];
 }
+
+uint32_t sound_i2s_get_sample_clock()
+{
+  // number of samples played so far, including the part of the buffer
+  // already consumed by the dma. Retry if the buffer was swapped meanwhile.
+  unsigned int played;
+  uint32_t remaining;
+  uintptr_t read_addr;
+  do {
+    played = sound_i2s_num_buffers_played;
+    remaining = dma_channel_hw_addr(sound_dma_chan)->transfer_count;
+    read_addr = dma_channel_hw_addr(sound_dma_chan)->read_addr;
+  } while (played != sound_i2s_num_buffers_played);
+
+  if (remaining == 0) {
+    // between the end of a buffer and the re-trigger, the count may or may
+    // not have been incremented yet. buffer n plays sound_sample_buffers[n & 1],
+    // so the buffer that ended tells which one it was.
+    uintptr_t end = (uintptr_t) sound_sample_buffers[played & 1] + 4 * config.samples_per_buffer;
+    unsigned int ended = (read_addr == end) ? played : played - 1;
+    return (ended + 1) * config.samples_per_buffer;
+  }
+  return played * config.samples_per_buffer + (config.samples_per_buffer - remaining);
+}
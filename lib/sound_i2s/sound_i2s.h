@@ -23,6 +23,7 @@ struct sound_i2s_config {
 int sound_i2s_init(const struct sound_i2s_config *cfg);
 int16_t *sound_i2s_get_next_buffer();
 int16_t *sound_i2s_get_buffer(int buffer_num);
+uint32_t sound_i2s_get_sample_clock();
 
 extern volatile unsigned int sound_i2s_num_buffers_played;
 
@@ -1,46 +1,420 @@
 #include "pico/stdlib.h"
 #include <stdlib.h>
+#include <string.h>
 #include "config.h"
 #include "state.h"
 #include "looper.h"
+#include "synth_events.h"
+#include "tempo.h"
 #include "display/display.h"
 
-// Display refresh interval in milliseconds
-#define LOOPER_DISPLAY_REFRESH_MS 100
-
 // Single global looper instance
 static looper_t looper;
 
+static inline uint32_t samples_to_ms(uint32_t samples) {
+    return (uint32_t)(((uint64_t)samples * 1000) / SOUND_OUTPUT_FREQUENCY);
+}
+
+static void looper_drop_take(void) {
+    looper.take.length = 0;
+    looper.take.split = 0;
+    looper.take.event_count = 0;
+    looper.take.notes_held = 0;
+}
+
 static void looper_clear_internal(void) {
+    looper.length = 0;
     looper.event_count = 0;
-    looper.play_index = 0;
-    looper.loop_length_ms = 0;
+    looper.layer_count = 0;
+    looper.loop_length = 0;
+    looper.loop_ticks = 0;
     looper.has_loop = false;
+    looper_drop_take();
+}
+
+static void looper_cursor_rewind(looper_cursor_t *cursor) {
+    cursor->offset = 0;
+    cursor->index = 0;
+    cursor->coder.time = 0;
+    cursor->coder.pitch = 0;
+}
+
+// Starts encoding a new run of events, and the filtering of unchanged values
+static void looper_start_run(void) {
+    looper.rec.time = 0;
+    looper.rec.pitch = 0;
+    looper.rec_pitch_valid = false;
+    memset(looper.rec_cc, 0xFF, sizeof(looper.rec_cc));
+}
+
+static uint8_t *put_varint(uint8_t *p, uint32_t value) {
+    while (value >= 0x80) {
+        *p++ = (value & 0x7F) | 0x80;
+        value >>= 7;
+    }
+    *p++ = value;
+    return p;
+}
+
+static const uint8_t *get_varint(const uint8_t *p, uint32_t *value) {
+    uint32_t v = 0;
+    uint8_t shift = 0;
+    uint8_t byte;
+    do {
+        byte = *p++;
+        v |= (uint32_t)(byte & 0x7F) << shift;
+        shift += 7;
+    } while (byte & 0x80);
+    *value = v;
+    return p;
+}
+
+static uint8_t *encode_event(uint8_t *p, const looper_event_t *evt, looper_coder_t *coder) {
+    *p++ = (evt->layer << 6) | (evt->type << 4) | (evt->channel & 0x0F);
+    p = put_varint(p, evt->time - coder->time);
+    coder->time = evt->time;
+    switch (evt->type) {
+        case LOOPER_EVENT_NOTE_ON:
+            *p++ = evt->data1;
+            *p++ = evt->data2;
+            break;
+        case LOOPER_EVENT_NOTE_OFF:
+            *p++ = evt->data1;
+            break;
+        case LOOPER_EVENT_CC:
+            *p++ = evt->data1;
+            *p++ = evt->data2;
+            break;
+        case LOOPER_EVENT_PITCH: {
+            int32_t change = (int32_t)evt->pitch - coder->pitch;
+            p = put_varint(p, ((uint32_t)change << 1) ^ (uint32_t)(change >> 31)); // Zigzag, small changes of either sign take a byte
+            coder->pitch = evt->pitch;
+            break;
+        }
+    }
+    return p;
+}
+
+static const uint8_t *decode_event(const uint8_t *p, looper_event_t *evt, looper_coder_t *coder) {
+    uint8_t header = *p++;
+    uint32_t delta;
+    p = get_varint(p, &delta);
+    coder->time += delta;
+    evt->time = coder->time;
+    evt->layer = header >> 6;
+    evt->type = (looper_event_type_t)((header >> 4) & 0x03);
+    evt->channel = header & 0x0F;
+    evt->data1 = 0;
+    evt->data2 = 0;
+    evt->pitch = 0;
+    switch (evt->type) {
+        case LOOPER_EVENT_NOTE_ON:
+            evt->data1 = *p++;
+            evt->data2 = *p++;
+            break;
+        case LOOPER_EVENT_NOTE_OFF:
+            evt->data1 = *p++;
+            break;
+        case LOOPER_EVENT_CC:
+            evt->data1 = *p++;
+            evt->data2 = *p++;
+            break;
+        case LOOPER_EVENT_PITCH: {
+            uint32_t zigzag;
+            p = get_varint(p, &zigzag);
+            coder->pitch += (int16_t)((zigzag >> 1) ^ -(zigzag & 1));
+            evt->pitch = coder->pitch;
+            break;
+        }
+    }
+    return p;
+}
+
+// Reads the events of one or two runs, see looper_take_t
+typedef struct {
+    const uint8_t *p;
+    const uint8_t *end;
+    const uint8_t *next;        // Second run, if any
+    const uint8_t *next_end;
+    looper_coder_t coder;
+    looper_event_t evt;
+    bool valid;
+} looper_reader_t;
+
+static void looper_reader_next(looper_reader_t *reader) {
+    if (reader->p >= reader->end && reader->next != NULL) {
+        reader->p = reader->next;
+        reader->end = reader->next_end;
+        reader->next = NULL;
+        reader->coder.time = 0;
+        reader->coder.pitch = 0;
+    }
+    reader->valid = reader->p < reader->end;
+    if (reader->valid) {
+        reader->p = decode_event(reader->p, &reader->evt, &reader->coder);
+    }
+}
+
+static void looper_reader_init(looper_reader_t *reader, const uint8_t *p, const uint8_t *end,
+                               const uint8_t *next, const uint8_t *next_end) {
+    reader->p = p;
+    reader->end = end;
+    reader->next = next;
+    reader->next_end = next_end;
+    reader->coder.time = 0;
+    reader->coder.pitch = 0;
+    looper_reader_next(reader);
+}
+
+// Places the cursor in the rewritten loop before the first event it has not
+// played yet: an event of the loop it had not reached, or one of the take that
+// comes round in this pass after its horizon. The others play from the next pass.
+static bool looper_cursor_due(const looper_cursor_t *cursor, bool from_loop, uint16_t loop_index, uint32_t time) {
+    if (from_loop) { return loop_index >= cursor->index; }
+    return (int32_t)(cursor->loop_start + time * LOOPER_TIME_UNIT - cursor->horizon) >= 0;
+}
+
+// The loop and the take start at base, one after the other
+static void looper_merge_init(looper_reader_t *loop, looper_reader_t *take, const uint8_t *base) {
+    const uint8_t *take_start = base + looper.length;
+    looper_reader_init(loop, base, take_start, NULL, NULL);
+    looper_reader_init(take, take_start + looper.take.split, take_start + looper.take.length,
+                       looper.take.split > 0 ? take_start : NULL, take_start + looper.take.split);
+}
+
+// First byte the reader has yet to decode, or NULL once it has decoded them all
+static const uint8_t *looper_reader_unread(const looper_reader_t *reader) {
+    if (reader->next != NULL) {
+        return reader->next < reader->p ? reader->next : reader->p;
+    }
+    return reader->p < reader->end ? reader->p : NULL;
+}
+
+// Takes the next event of the loop and the take, in time order. On equal
+// times, the older layers come first.
+static bool looper_merge_next(looper_reader_t *loop, looper_reader_t *take, looper_event_t *evt, bool *from_loop) {
+    if (!loop->valid && !take->valid) { return false; }
+    *from_loop = loop->valid && (!take->valid || loop->evt.time <= take->evt.time);
+    looper_reader_t *reader = *from_loop ? loop : take;
+    *evt = reader->evt;
+    looper_reader_next(reader);
+    return true;
+}
+
+// The time and pitch changes are coded again between the events that end up
+// next to each other, so the result can take more bytes than loop and take
+// together. The merge is written from the start of the arena, while the loop
+// and the take are read from base, at its top. Returns false if it doesn't
+// fit, or if it would catch up with the events still to be read.
+static bool looper_rewrite_fits(uint8_t drop_layer, const uint8_t *base) {
+    looper_reader_t loop;
+    looper_reader_t take;
+    looper_merge_init(&loop, &take, base);
+
+    uint8_t buffer[LOOPER_EVENT_MAX_SIZE];
+    looper_coder_t coder = { 0, 0 };
+    uint32_t length = 0;
+    uint32_t count = 0;
+    looper_event_t evt;
+    bool from_loop;
+    while (looper_merge_next(&loop, &take, &evt, &from_loop)) {
+        if (evt.layer == drop_layer) { continue; }
+        length += encode_event(buffer, &evt, &coder) - buffer;
+        count++;
+        for (uint8_t i = 0; i < 2; i++) {
+            const uint8_t *unread = looper_reader_unread(i == 0 ? &loop : &take);
+            if (unread != NULL && length > (uint32_t)(unread - looper.arena)) { return false; }
+        }
+    }
+    return length <= looper.arena_size && count <= UINT16_MAX;
+}
+
+// Merges the take into the loop and leaves out the events of drop_layer, in
+// a single pass within the arena: both are moved to its top first, and the
+// result is written below them into the room they leave. The cursors keep
+// their place, and the events already handed to the synth stay in time order.
+// Returns false, with nothing changed, if the result doesn't fit.
+static bool looper_rewrite(uint8_t drop_layer) {
+    uint16_t used = looper.length + looper.take.length;
+    uint8_t *base = &looper.arena[looper.arena_size - used];
+    memmove(base, looper.arena, used);
+    if (!looper_rewrite_fits(drop_layer, base)) {
+        memmove(looper.arena, base, used);
+        return false;
+    }
+
+    looper_reader_t loop;
+    looper_reader_t take;
+    looper_merge_init(&loop, &take, base);
+
+    looper_cursor_t *cursors[2] = { &looper.synth_cursor, &looper.midi_cursor };
+    looper_cursor_t placed[2];
+    bool is_placed[2] = { false, false };
+
+    uint8_t *out = looper.arena;
+    looper_coder_t coder = { 0, 0 };
+    uint16_t count = 0;
+    uint16_t loop_index = 0;
+    looper_event_t evt;
+    bool from_loop;
+    while (looper_merge_next(&loop, &take, &evt, &from_loop)) {
+        for (uint8_t i = 0; i < 2; i++) {
+            if (!is_placed[i] && looper_cursor_due(cursors[i], from_loop, loop_index, evt.time)) {
+                placed[i].offset = out - looper.arena;
+                placed[i].index = count;
+                placed[i].coder = coder;
+                placed[i].loop_start = cursors[i]->loop_start;
+                placed[i].horizon = cursors[i]->horizon;
+                placed[i].pass_tick = cursors[i]->pass_tick;
+                is_placed[i] = true;
+            }
+        }
+
+        if (evt.layer != drop_layer) {
+            out = encode_event(out, &evt, &coder);
+            count++;
+        }
+        if (from_loop) {
+            loop_index++;
+        }
+    }
+
+    looper.length = out - looper.arena;
+    looper.event_count = count;
+    looper.has_loop = (count > 0);
+    looper_drop_take();
+
+    // A cursor past the last event that is left waits for the end of the pass
+    for (uint8_t i = 0; i < 2; i++) {
+        if (!is_placed[i]) {
+            placed[i].offset = looper.length;
+            placed[i].index = count;
+            placed[i].coder = coder;
+            placed[i].loop_start = cursors[i]->loop_start;
+            placed[i].horizon = cursors[i]->horizon;
+            placed[i].pass_tick = cursors[i]->pass_tick;
+        }
+        *cursors[i] = placed[i];
+    }
+    return true;
+}
+
+// Makes room for a new layer by merging the two oldest ones, in place
+static void looper_merge_oldest_layers(void) {
+    uint8_t *p = looper.arena;
+    uint8_t *end = looper.arena + looper.length;
+    looper_coder_t coder = { 0, 0 };
+    looper_event_t evt;
+    while (p < end) {
+        uint8_t *header = p;
+        p = (uint8_t *)decode_event(p, &evt, &coder);
+        if (evt.layer > 0) {
+            *header -= (1 << 6);
+        }
+    }
+    looper.layer_count--;
+}
+
+// Position of what is heard now in the loop, in samples. The MIDI cursor
+// follows it, but may not have moved on to the next pass yet.
+static uint32_t looper_position(uint32_t now) {
+    int32_t position = (int32_t)(now + SYNTH_EVENTS_LATENCY - looper.midi_cursor.loop_start);
+    while (position < 0) { position += looper.loop_length; }
+    return (uint32_t)position % looper.loop_length;
+}
+
+// Starts a take on the given layer: a new one, or the last one of the loop
+// for a take that carries it on
+static void looper_begin_take(uint8_t layer) {
+    looper_drop_take();
+    looper.take.layer = layer;
+    looper.take.split = 0;
+    // A loop from now, unless the first event sets it, see looper_append_event()
+    looper.take.deadline = synth_events_now() + SYNTH_EVENTS_LATENCY + looper.loop_length;
+    looper_start_run();
+    looper.state = LOOP_OVERDUB;
+    display_invalidate(DISPLAY_REGION_LOOPER);
+}
+
+static void looper_start_take(void) {
+    if (looper.layer_count >= LOOPER_MAX_LAYERS) {
+        looper_merge_oldest_layers();
+    }
+    looper_begin_take(looper.layer_count);
+}
+
+// Leaves out the last layer, with the take carrying it on if any. Returns
+// false, with nothing changed, if the loop without it doesn't fit.
+static bool looper_remove_last_layer(void) {
+    if (!looper_rewrite(looper.layer_count - 1)) { return false; }
+    looper.layer_count--;
+    if (looper_is_playing()) {
+        // Replay from what is heard, so nothing of the layer is left in the synth queue
+        synth_events_cancel_scheduled(SYNTH_LANE_LOOPER);
+        looper.synth_cursor = looper.midi_cursor;
+        looper.state = LOOP_PLAYING;
+    }
+    all_notes_off();
+    return true;
+}
+
+// Ends the take. The overdub carries on while notes are held, with a take on
+// the same layer, so their note offs are recorded and undone along with their
+// note ons. A take that doesn't fit is left out whole, rather than in part,
+// and so is the layer it carries on.
+static void looper_commit_take(bool carry_on) {
+    uint8_t notes_held = looper.take.notes_held;
+    uint8_t layer = looper.take.layer;
+    bool merged = true;
+    if (looper.take.event_count > 0) {
+        merged = looper_rewrite(LOOPER_MAX_LAYERS);
+        if (merged) {
+            looper.layer_count = layer + 1;
+        } else if (layer < looper.layer_count) {
+            looper_remove_last_layer();
+        }
+    }
+    looper_drop_take();
+    looper.state = LOOP_PLAYING;
+    if (carry_on && merged && notes_held > 0) {
+        looper_begin_take(layer);
+        looper.take.notes_held = notes_held;
+    }
+    display_invalidate(DISPLAY_REGION_LOOPER);
 }
 
-static void looper_restart_playback(void) {
-    looper.play_index = 0;
-    looper.play_start_us = time_us_64();
+// Plays the loop from its start, with the first pass beginning at loop_start,
+// on the given tempo tick
+static void looper_restart_playback(uint32_t loop_start, uint32_t pass_tick) {
+    looper_cursor_rewind(&looper.synth_cursor);
+    looper.synth_cursor.loop_start = loop_start;
+    looper.synth_cursor.horizon = loop_start;
+    looper.synth_cursor.pass_tick = pass_tick;
+    looper.midi_cursor = looper.synth_cursor;
     looper.state = LOOP_PLAYING;
 }
 
-void looper_init(uint16_t max_events, uint32_t max_length_ms) {
+void looper_init(uint16_t arena_size, uint32_t max_length_ms) {
     looper.state = LOOP_DISABLED;
-    looper.events = (looper_event_t *)calloc(max_events, sizeof(looper_event_t));
+    looper.arena = (uint8_t *)malloc(arena_size);
     
-    if (!looper.events) {
-        looper.max_events = 0;
-        looper.max_length_ms = 0;
+    if (!looper.arena) {
+        looper.arena_size = 0;
+        looper.max_length = 0;
         return;
     }
     
-    looper.max_events = max_events;
-    looper.max_length_ms = max_length_ms;
+    looper.arena_size = arena_size;
+    looper.max_length = (uint32_t)(((uint64_t)max_length_ms * SOUND_OUTPUT_FREQUENCY) / 1000);
+    // Times since the previous event have to fit in a 3 byte varint
+    if (looper.max_length >= (1u << 21) * LOOPER_TIME_UNIT) {
+        looper.max_length = (1u << 21) * LOOPER_TIME_UNIT - 1;
+    }
     looper_clear_internal();
 }
 
 void looper_enable() {
-    if (looper.events && looper_is_disabled()) {
+    if (looper.arena && looper_is_disabled()) {
         looper.state = LOOP_IDLE;
     }
 }
@@ -48,18 +422,24 @@ void looper_enable() {
 void looper_disable() {
     looper.state = LOOP_DISABLED;
     looper_clear_internal();
+    synth_events_cancel_scheduled(SYNTH_LANE_LOOPER);
+    tempo_stop();
     all_notes_off();
 }
 
 void looper_clear() {
+    if (looper_is_recording() || looper_is_playing()) {
+        tempo_stop();
+    }
     looper_clear_internal();
+    synth_events_cancel_scheduled(SYNTH_LANE_LOOPER);
     if (!looper_is_disabled()) {
         looper.state = LOOP_IDLE;
     }
 }
 
 bool looper_is_disabled() {
-    return (looper.state == LOOP_DISABLED || looper.events == NULL);
+    return (looper.state == LOOP_DISABLED || looper.arena == NULL);
 }
 
 bool looper_is_recording() {
@@ -67,65 +447,114 @@ bool looper_is_recording() {
 }
 
 bool looper_is_playing() {
-    return (looper.state == LOOP_PLAYING);
+    return (looper.state == LOOP_PLAYING || looper.state == LOOP_OVERDUB);
+}
+
+bool looper_is_overdubbing() {
+    return (looper.state == LOOP_OVERDUB);
 }
 
 bool looper_has_loop() {
-    return looper.has_loop && looper.loop_length_ms > 0 && looper.event_count > 0;
+    return looper.has_loop && looper.loop_length > 0 && looper.event_count > 0;
 }
 
 bool looper_has_events() {
     return looper.event_count > 0;
 }
 
-// Display throttle using 32-bit timestamps (faster, 71min wrap is fine for throttle)
-static uint32_t last_display_refresh_ms_rec = 0;
-static uint32_t last_display_refresh_ms_play = 0;
-
 void looper_start_record() {
     if (looper_is_disabled()) { return; }
     looper_clear_internal();
-    looper.rec_start_us = time_us_64();
-    last_display_refresh_ms_rec = 0;  // Reset display throttle
-    last_display_refresh_ms_play = 0;
+    synth_events_cancel_scheduled(SYNTH_LANE_LOOPER);
+    looper.rec_start = synth_events_now();
+    // The bars of the tempo clock, and of the Midi transport, start with the recording
+    looper.rec_tick = tempo_start(looper.rec_start + SYNTH_EVENTS_LATENCY);
+    looper_start_run();
+    looper.take.layer = 0;
     looper.state = LOOP_RECORDING;
+    // Recording can start from a touch, while the looper screen is shown.
+    // The display keeps redrawing the clock while recording or playing.
+    display_invalidate(DISPLAY_REGION_LOOPER);
 }
 
 void looper_stop_record_and_play() {
     if (looper_is_disabled()) { return; }
     if (looper.state != LOOP_RECORDING) { return; }
 
-    uint64_t now_us = time_us_64();
-    uint32_t elapsed_ms = (uint32_t)((now_us - looper.rec_start_us) / 1000);
-    if (elapsed_ms == 0) {
+    uint32_t elapsed = synth_events_now() - looper.rec_start;
+    if (elapsed == 0) {
         looper_clear();
         return;
     }
-    if (elapsed_ms > looper.max_length_ms) {
-        elapsed_ms = looper.max_length_ms;
+    if (elapsed > looper.max_length) {
+        elapsed = looper.max_length;
+    }
+#if LOOPER_QUANTIZE_BARS
+    // The nearest number of whole bars, unless that cuts off the last event
+    uint32_t bar = tempo_ticks_to_samples(TEMPO_TICKS_PER_BAR);
+    uint32_t last = looper.rec.time * LOOPER_TIME_UNIT;
+    uint32_t bars = (elapsed + bar / 2) / bar;
+    if (bars == 0 || bars * bar <= last) {
+        bars = last / bar + 1;
+    }
+    if (bars * bar <= looper.max_length) {
+        looper.loop_ticks = bars * TEMPO_TICKS_PER_BAR;
+        elapsed = tempo_ticks_to_samples(looper.loop_ticks);
     }
-    looper.loop_length_ms = elapsed_ms;
+#endif
+    looper.loop_length = elapsed;
     looper.has_loop = (looper.event_count > 0);
+    looper.layer_count = 1;
 
     if (looper.has_loop) {
-        looper_restart_playback();
+        // Recorded events sounded SYNTH_EVENTS_LATENCY after their timestamp.
+        // The second pass follows on from the first without a gap.
+        looper_restart_playback(looper.rec_start + SYNTH_EVENTS_LATENCY + looper.loop_length,
+                                looper.rec_tick + looper.loop_ticks);
     } else {
         looper.state = LOOP_IDLE;
     }
+    display_invalidate(DISPLAY_REGION_LOOPER);
 }
 
 void looper_stop() {
     if (looper_is_disabled()) { return; }
+    if (looper.state == LOOP_OVERDUB) {
+        looper_commit_take(false);
+    }
+    synth_events_cancel_scheduled(SYNTH_LANE_LOOPER);
+    tempo_stop();
     looper.state = looper_has_loop() ? LOOP_PAUSED : LOOP_IDLE;
+    display_invalidate(DISPLAY_REGION_LOOPER);
 }
 
 void looper_restart_from_start() {
     if (looper_is_disabled()) { return; }
     if (!looper_has_loop()) { return; }
+    if (looper.state == LOOP_OVERDUB) {
+        looper_commit_take(false);
+    }
+    synth_events_cancel_scheduled(SYNTH_LANE_LOOPER);
     all_notes_off();
-    looper.play_index = 0;
-    looper.play_start_us = time_us_64();
-    looper.state = LOOP_PLAYING;
+    uint32_t tick = tempo_start(synth_events_now() + SYNTH_EVENTS_LATENCY);
+    looper_restart_playback(tempo_tick_time(tick), tick);
+}
+
+void looper_undo() {
+    if (looper_is_disabled()) { return; }
+    if (looper.state == LOOP_OVERDUB && looper.take.layer == looper.layer_count) {
+        // Drop the take that is being recorded
+        looper_drop_take();
+        looper.state = LOOP_PLAYING;
+        all_notes_off();
+    } else if (looper.layer_count > 1) {
+        // The first layer is the loop itself, clear it instead. A take still
+        // carrying on the last layer goes with it.
+        if (!looper_remove_last_layer()) { return; }
+    } else {
+        return;
+    }
+    display_invalidate(DISPLAY_REGION_LOOPER);
 }
 
 void looper_onpress() {
@@ -140,29 +569,69 @@ void looper_onpress() {
             looper_stop_record_and_play();
             break;
         case LOOP_PLAYING:
+        case LOOP_OVERDUB:
             looper_stop();
             break;
     }
 }
 
 static void looper_append_event(looper_event_type_t type, uint8_t d1, uint8_t d2, int16_t pitch) {
-    // Combined check: must be recording with valid events buffer
-    if (looper.state != LOOP_RECORDING || looper.events == NULL) return;
-    if (looper.event_count >= looper.max_events) return; // Drop extra events silently
-
-    uint64_t now_us = time_us_64();
-    uint32_t ts_ms = (uint32_t)((now_us - looper.rec_start_us) / 1000);
-    if (ts_ms > looper.max_length_ms) {
-        looper_stop_record_and_play();
-        return;
+    // Combined check: must be recording with a valid arena
+    if ((looper.state != LOOP_RECORDING && looper.state != LOOP_OVERDUB) || looper.arena == NULL) return;
+
+    uint32_t now = synth_events_now();
+    uint32_t position;
+    if (looper.state == LOOP_RECORDING) {
+        position = now - looper.rec_start;
+        if (position > looper.max_length) {
+            looper_stop_record_and_play();
+            return;
+        }
+    } else {
+        position = looper_position(now);
+    }
+    // Whole units since the start, so that the rounding doesn't add up
+    uint32_t time = position / LOOPER_TIME_UNIT;
+
+    if (looper.state == LOOP_OVERDUB && time < looper.rec.time) {
+        // The take crossed the end of the loop, the rest of it is a second run
+        looper.take.split = looper.take.length;
+        looper.rec.time = 0;
+        looper.rec.pitch = 0;
     }
 
-    looper_event_t *evt = &looper.events[looper.event_count++];
-    evt->timestamp_ms = ts_ms;
-    evt->type = type;
-    evt->data1 = d1;
-    evt->data2 = d2;
-    evt->pitch = pitch;
+    // Drop extra events silently. A take keeps as much room again free, which
+    // looper_rewrite() needs to merge it in place.
+    uint16_t used = looper.length + looper.take.length;
+    uint16_t needed = LOOPER_EVENT_MAX_SIZE;
+    if (looper.state == LOOP_OVERDUB) {
+        needed += looper.take.length + LOOPER_EVENT_MAX_SIZE;
+    }
+    if (looper.arena_size - used < needed) return;
+    if (looper.event_count + looper.take.event_count >= UINT16_MAX) return;
+
+    looper_event_t evt = {
+        .time = time,
+        .type = type,
+        .layer = looper.take.layer,
+        .channel = PRA32_U_MIDI_CH,
+        .data1 = d1,
+        .data2 = d2,
+        .pitch = pitch,
+    };
+    uint8_t *end = encode_event(&looper.arena[used], &evt, &looper.rec);
+    if (looper.state == LOOP_RECORDING) {
+        looper.length = end - looper.arena;
+        looper.event_count++;
+    } else {
+        if (looper.take.event_count == 0) {
+            // The first event comes round again a loop later, at its stored
+            // time. It has to be merged before the synth cursor gets there.
+            looper.take.deadline = now + SYNTH_EVENTS_LATENCY - (position - time * LOOPER_TIME_UNIT) + looper.loop_length;
+        }
+        looper.take.length = end - &looper.arena[looper.length];
+        looper.take.event_count++;
+    }
 }
 
 void looper_record_note(uint8_t note, uint8_t velocity, bool is_on) {
@@ -171,86 +640,151 @@ void looper_record_note(uint8_t note, uint8_t velocity, bool is_on) {
     
     if (looper.state == LOOP_IDLE || looper.state == LOOP_PAUSED) {
         looper_start_record();
+    } else if (looper.state == LOOP_PLAYING && is_on) {
+        // Playing along overdubs a new take
+        looper_start_take();
+    }
+    if (looper.state == LOOP_OVERDUB) {
+        if (is_on) {
+            looper.take.notes_held++;
+        } else if (looper.take.notes_held > 0) {
+            looper.take.notes_held--;
+        }
     }
     looper_append_event(is_on ? LOOPER_EVENT_NOTE_ON : LOOPER_EVENT_NOTE_OFF, note, velocity, 0);
 }
 
 void looper_record_cc(uint8_t cc_number, uint8_t value) {
-    if (looper_is_disabled()) return;
+    if (looper_is_disabled() || (looper.state != LOOP_RECORDING && looper.state != LOOP_OVERDUB)) return;
+    cc_number &= 0x7F;
+    if (looper.rec_cc[cc_number] == value) return;
     looper_append_event(LOOPER_EVENT_CC, cc_number, value, 0);
+    looper.rec_cc[cc_number] = value;
 }
 
 void looper_record_pitch(int16_t pitch_bend) {
-    if (looper_is_disabled()) return;
+    if (looper_is_disabled() || (looper.state != LOOP_RECORDING && looper.state != LOOP_OVERDUB)) return;
+    if (looper.rec_pitch_valid && looper.rec_pitch == pitch_bend) return;
     looper_append_event(LOOPER_EVENT_PITCH, 0, 0, pitch_bend);
+    looper.rec_pitch = pitch_bend;
+    looper.rec_pitch_valid = true;
 }
 
-static void looper_dispatch_event(const looper_event_t *evt) {
+static void looper_schedule_event(const looper_event_t *evt, uint32_t time) {
     switch (evt->type) {
         case LOOPER_EVENT_NOTE_ON:
-            looper_send_note_on(evt->data1, evt->data2);
+            synth_events_post_at(SYNTH_LANE_LOOPER, time, SYNTH_EVENT_NOTE_ON, evt->data1, evt->data2);
             break;
         case LOOPER_EVENT_NOTE_OFF:
-            looper_send_note_off(evt->data1);
+            synth_events_post_at(SYNTH_LANE_LOOPER, time, SYNTH_EVENT_NOTE_OFF, evt->data1, 0);
             break;
         case LOOPER_EVENT_CC:
-            looper_send_cc(evt->data1, evt->data2);
+            synth_events_post_at(SYNTH_LANE_LOOPER, time, SYNTH_EVENT_CONTROL_CHANGE, evt->data1, evt->data2);
             break;
-        case LOOPER_EVENT_PITCH:
-            looper_send_pitch(evt->pitch);
+        case LOOPER_EVENT_PITCH: {
+            int16_t bend = evt->pitch + 8192; // Convert signed back to 14-bit MIDI range
+            if (bend < 0) bend = 0;
+            if (bend > 16383) bend = 16383;
+            synth_events_post_at(SYNTH_LANE_LOOPER, time, SYNTH_EVENT_PITCH_BEND, bend & 0x7F, (bend >> 7) & 0x7F);
             break;
+        }
         default:
             break;
     }
 }
 
-void looper_task() {
-    // Early exit when disabled - avoid all work including time_us_64 call
-    if (looper_is_disabled()) return;
+static void looper_send_event_midi(const looper_event_t *evt) {
+    switch (evt->type) {
+        case LOOPER_EVENT_NOTE_ON:
+            looper_send_midi(0x90 | evt->channel, evt->data1, evt->data2);
+            break;
+        case LOOPER_EVENT_NOTE_OFF:
+            looper_send_midi(0x80 | evt->channel, evt->data1, 0);
+            break;
+        case LOOPER_EVENT_CC:
+            looper_send_midi(0xB0 | evt->channel, evt->data1, evt->data2);
+            break;
+        case LOOPER_EVENT_PITCH: {
+            int16_t bend = evt->pitch + 8192;
+            if (bend < 0) bend = 0;
+            if (bend > 16383) bend = 16383;
+            looper_send_midi(0xE0 | evt->channel, bend & 0x7F, (bend >> 7) & 0x7F);
+            break;
+        }
+        default:
+            break;
+    }
+}
 
-    // Refresh display periodically during recording to advance the clock
-    if (looper.state == LOOP_RECORDING) {
-        uint32_t now_ms = time_us_32() / 1000;
-        if ((now_ms - last_display_refresh_ms_rec) >= LOOPER_DISPLAY_REFRESH_MS) {
-            display_request_refresh();
-            last_display_refresh_ms_rec = now_ms;
+// Start of the pass after the one of the cursor, which has played all of it.
+// Under an external clock, the passes of a loop quantized to bars start on
+// its ticks, so the loop keeps in step with it however the two clocks drift.
+static uint32_t looper_next_pass_start(const looper_cursor_t *cursor) {
+    uint32_t loop_start = cursor->loop_start + looper.loop_length;
+    if (looper.loop_ticks > 0 && tempo_is_external()) {
+        uint32_t tick_start = tempo_tick_time(cursor->pass_tick + looper.loop_ticks);
+        // Never before the last event of the pass, should the tempo jump
+        uint32_t last = cursor->loop_start + cursor->coder.time * LOOPER_TIME_UNIT;
+        if ((int32_t)(tick_start - last) > 0) {
+            loop_start = tick_start;
         }
-        return;
     }
+    return loop_start;
+}
 
-    if (!looper_is_playing() || !looper_has_loop()) {
-        return;
+// Decodes the event at the cursor if it falls before horizon, and moves the cursor
+// past it. Moves on to the next pass at the end of the loop. Returns false when
+// there is nothing more to play before horizon.
+static bool looper_cursor_next(looper_cursor_t *cursor, uint32_t horizon, looper_event_t *evt, uint32_t *time) {
+    cursor->horizon = horizon;
+    if (cursor->offset >= looper.length) {
+        uint32_t loop_start = looper_next_pass_start(cursor);
+        if ((int32_t)(horizon - loop_start) <= 0) { return false; }
+        looper_cursor_rewind(cursor);
+        cursor->loop_start = loop_start;
+        cursor->pass_tick += looper.loop_ticks;
     }
 
-    uint64_t now_us = time_us_64();
-    uint32_t elapsed_ms = (uint32_t)((now_us - looper.play_start_us) / 1000);
+    looper_coder_t coder = cursor->coder;
+    const uint8_t *p = decode_event(&looper.arena[cursor->offset], evt, &coder);
+    uint32_t clock_time = cursor->loop_start + evt->time * LOOPER_TIME_UNIT;
+    if ((int32_t)(horizon - clock_time) <= 0) { return false; }
+
+    *time = clock_time;
+    cursor->coder = coder;
+    cursor->offset = p - looper.arena;
+    cursor->index++;
+    return true;
+}
+
+void looper_task() {
+    // Early exit when disabled - avoid all work including the audio clock read
+    if (looper_is_disabled()) return;
 
-    // Restart loop when reaching end
-    if (elapsed_ms >= looper.loop_length_ms) {
-        looper_restart_playback();
-        elapsed_ms = 0;
+    if (!looper_is_playing() || !looper_has_loop()) {
+        return;
     }
 
-    // Dispatch any due events
-    while (looper.play_index < looper.event_count) {
-        const looper_event_t *evt = &looper.events[looper.play_index];
-        if (evt->timestamp_ms <= elapsed_ms) {
-            looper_dispatch_event(evt);
-            looper.play_index++;
-        } else {
-            break;
-        }
+    // Playback follows the audio clock, not this task. Events are handed to the
+    // synth SEQUENCER_LOOKAHEAD ahead, and it applies them at their exact sample,
+    // however late core0 gets here.
+    uint32_t now = synth_events_now();
+    if (looper.state == LOOP_OVERDUB && (int32_t)(now + SEQUENCER_LOOKAHEAD - looper.take.deadline) >= 0) {
+        looper_commit_take(true);
     }
 
-    uint32_t now_ms = time_us_32() / 1000;
-    if ((now_ms - last_display_refresh_ms_play) >= LOOPER_DISPLAY_REFRESH_MS) {
-        display_request_refresh();
-        last_display_refresh_ms_play = now_ms;
+    uint32_t time;
+    looper_event_t evt;
+    while (looper_cursor_next(&looper.synth_cursor, now + SEQUENCER_LOOKAHEAD, &evt, &time)) {
+        looper_schedule_event(&evt, time);
+    }
+    while (looper_cursor_next(&looper.midi_cursor, now + SYNTH_EVENTS_LATENCY, &evt, &time)) {
+        looper_send_event_midi(&evt);
     }
 }
 
 uint32_t looper_get_loop_length_ms() {
-    return looper.loop_length_ms;
+    return samples_to_ms(looper.loop_length);
 }
 
 uint16_t looper_get_event_count() {
@@ -258,7 +792,17 @@ uint16_t looper_get_event_count() {
 }
 
 uint16_t looper_get_play_index() {
-    return looper.play_index;
+    return looper.synth_cursor.index;
+}
+
+uint8_t looper_get_memory_percent() {
+    if (looper.arena_size == 0) { return 0; }
+    // Counting the room a take keeps for its merge
+    return (uint8_t)(((uint32_t)(looper.length + 2 * looper.take.length) * 100) / looper.arena_size);
+}
+
+uint8_t looper_get_layer_count() {
+    return looper.layer_count;
 }
 
 looper_state_t looper_get_state() {
@@ -266,15 +810,15 @@ looper_state_t looper_get_state() {
 }
 
 uint32_t looper_get_elapsed_ms() {
-    if (looper.state == LOOP_PLAYING && looper.loop_length_ms > 0) {
-        return (uint32_t)((time_us_64() - looper.play_start_us) / 1000);
+    if (looper_is_playing() && looper.loop_length > 0) {
+        return samples_to_ms(looper_position(synth_events_now()));
     }
     if (looper.state == LOOP_RECORDING) {
-        return (uint32_t)((time_us_64() - looper.rec_start_us) / 1000);
+        return samples_to_ms(synth_events_now() - looper.rec_start);
     }
     return 0;
 }
 
 uint32_t looper_get_max_length_ms() {
-    return looper.max_length_ms;
+    return samples_to_ms(looper.max_length);
 }
\ No newline at end of file
@@ -12,6 +12,7 @@ typedef enum {
     LOOP_RECORDING,
     LOOP_PLAYING,
     LOOP_PAUSED,
+    LOOP_OVERDUB,           // Playing, and recording a take on top
 } looper_state_t;
 
 typedef enum {
@@ -21,28 +22,85 @@ typedef enum {
     LOOPER_EVENT_PITCH = 3,
 } looper_event_type_t;
 
+// Events are packed in a byte arena, one after the other:
+//   - a header byte, with the layer in bits 7-6, the type in bits 5-4
+//     and the Midi channel in the low nibble
+//   - the time since the previous event, in LOOPER_TIME_UNIT samples, as a varint
+//   - note on: note, velocity. Note off: note. Cc: number, value.
+//     Pitch: the change since the previous pitch event, as a zigzag varint.
+// Pitch and cc events are only recorded when the value changes.
+// Delta coding starts again from zero at the start of every run of events.
+#define LOOPER_TIME_UNIT        4   // Samples. The synth applies events at this resolution
+#define LOOPER_EVENT_MAX_SIZE   7   // Header, 3 byte time, 3 byte pitch change
+
+// Layer 0 is the first recording, every overdubbed take adds one that can be
+// undone. Past the last layer, the two oldest ones are merged for good.
+#define LOOPER_MAX_LAYERS       4
+
+// Decoded event
 typedef struct {
-    uint32_t timestamp_ms;  // Time since start of loop
+    uint32_t time;          // Since start of loop, in LOOPER_TIME_UNIT
     looper_event_type_t type;
+    uint8_t layer;
+    uint8_t channel;
     uint8_t data1;          // note or cc number
     uint8_t data2;          // velocity or cc value
     int16_t pitch;          // pitch bend (-8192..8191) when type == LOOPER_EVENT_PITCH
 } looper_event_t;
 
+// Delta coding state, at the start of a run or after the last event
+typedef struct {
+    uint32_t time;          // In LOOPER_TIME_UNIT
+    int16_t pitch;
+} looper_coder_t;
+
+// Playback position, and the decoder state at it. loop_start is the audio
+// sample clock value at which the pass of the loop that holds the next event
+// starts, and every event before horizon has been played.
+typedef struct {
+    uint16_t offset;        // Next event in the arena, or the end of the pass
+    uint16_t index;
+    looper_coder_t coder;
+    uint32_t loop_start;
+    uint32_t horizon;
+    uint32_t pass_tick;     // Tempo tick at loop_start
+} looper_cursor_t;
+
+// An overdubbed take is recorded after the loop in the arena, and merged into
+// it once it spans a whole pass. It is in time order, or in two runs if it
+// crossed the end of the loop: [split, length) comes before [0, split).
+typedef struct {
+    uint16_t length;        // Bytes
+    uint16_t split;
+    uint16_t event_count;
+    uint8_t layer;
+    uint8_t notes_held;
+    uint32_t deadline;      // Audio sample clock by which the take has to be merged
+} looper_take_t;
+
 typedef struct looper {
     looper_state_t state;
-    looper_event_t *events;
+    uint8_t *arena;
+    uint16_t arena_size;    // In bytes
+    uint16_t length;        // Bytes used by the recorded events
     uint16_t event_count;
-    uint16_t max_events;
-    uint16_t play_index;
-    uint32_t loop_length_ms;   // Duration of loop in ms
-    uint32_t max_length_ms;    // Clamp for loop length
-    uint64_t rec_start_us;
-    uint64_t play_start_us;
+    uint8_t layer_count;
+    uint32_t loop_length;   // Duration of loop in audio samples
+    uint32_t loop_ticks;    // Duration in tempo ticks if quantized to bars, 0 otherwise
+    uint32_t max_length;    // Clamp for loop length, in audio samples
+    uint32_t rec_start;     // Audio sample clock at the start of the recording
+    uint32_t rec_tick;      // Tempo tick at which the recording is heard
+    looper_coder_t rec;     // Encoder state of the recording or the take
+    int16_t rec_pitch;      // Last recorded pitch, if rec_pitch_valid
+    bool rec_pitch_valid;
+    uint8_t rec_cc[128];    // Last recorded value of each cc, 0xFF if none
+    looper_take_t take;
+    looper_cursor_t synth_cursor;   // Runs SEQUENCER_LOOKAHEAD ahead of the audio clock
+    looper_cursor_t midi_cursor;    // Runs SYNTH_EVENTS_LATENCY ahead, like live notes
     bool has_loop;
 } looper_t;
 
-void looper_init(uint16_t max_events, uint32_t max_length_ms);
+void looper_init(uint16_t arena_size, uint32_t max_length_ms);
 void looper_onpress();
 void looper_enable();
 void looper_disable();
@@ -50,6 +108,7 @@ void looper_clear();
 bool looper_is_disabled();
 bool looper_is_recording();
 bool looper_is_playing();
+bool looper_is_overdubbing();
 bool looper_has_loop();
 bool looper_has_events();
 void looper_start_record();
@@ -59,19 +118,21 @@ void looper_record_note(uint8_t note, uint8_t velocity, bool is_on);
 void looper_record_cc(uint8_t cc_number, uint8_t value);
 void looper_record_pitch(int16_t pitch_bend);
 void looper_restart_from_start();
+void looper_undo();
 uint32_t looper_get_loop_length_ms();
 uint16_t looper_get_event_count();
 uint16_t looper_get_play_index();
+uint8_t looper_get_memory_percent();
+uint8_t looper_get_layer_count();
 looper_state_t looper_get_state();
 uint32_t looper_get_elapsed_ms();
 uint32_t looper_get_max_length_ms();
 void looper_task();
 
-// Looper playback hooks - implemented in main.cpp with C linkage
-void looper_send_note_on(uint8_t note, uint8_t velocity);
-void looper_send_note_off(uint8_t note);
-void looper_send_cc(uint8_t cc_number, uint8_t value);
-void looper_send_pitch(int16_t pitch_bend);
+// Looper playback hooks - implemented in main.cpp with C linkage.
+// The synth gets the events directly, scheduled at the audio sample
+// they were recorded at. The Midi output gets them when they are due.
+void looper_send_midi(uint8_t status, uint8_t data1, uint8_t data2);
 void all_notes_off(void);
 
 // Legacy compatibility (kept for display/UI expectations)
@@ -12,9 +12,22 @@ typedef uint8_t byte;
 #include "hardware/gpio.h"
 #include "hardware/adc.h"   // Used for low battery detection
 #include "hardware/flash.h"
+#include "hardware/irq.h"
+#include "hardware/sync.h"
 #include "pico/binary_info.h"
 #include "pico/multicore.h"
 #include "sound_i2s.h"
+#if defined (PRA32_U2_USE_2_CORES_FOR_SIGNAL_PROCESSING)
+// Wake up core0 to render its share of the block, see core0_render_irq()
+#define PRA32_U2_SECONDARY_CORE_NOTIFY() multicore_fifo_push_timeout_us(0, 0)
+// Core1 renders the share itself if core0 has not started on it by the time
+// core1 is done with its own, so audio never waits on core0 having
+// interrupts enabled. The claim is made under a spin lock, which also masks
+// the interrupts of the core holding it.
+static spin_lock_t *render_claim_lock;
+#define PRA32_U2_SECONDARY_CORE_CLAIM_BEGIN() uint32_t render_claim_irq = spin_lock_blocking(render_claim_lock)
+#define PRA32_U2_SECONDARY_CORE_CLAIM_END() spin_unlock(render_claim_lock, render_claim_irq)
+#endif
 #include "pra32-u2-common.h" // https://github.com/risgk/digital-synth-pra32-u2
 #include "pra32-u2-synth.h"  // PRA32-U2 version 1.5.0 (optimized for RP2350)
 #include "instrument_preset.h"
@@ -30,7 +43,15 @@ typedef uint8_t byte;
 #include "arpeggiator.h"
 #include "display/display.h"
 #include "state.h"
-#include "i2c_mutex.h"
+#include "i2c1_bus.h"
+#include "synth_events.h"
+#include "tempo.h"
+#include "midi_in.h"
+#include "midi_out.h"
+#include "settings_store.h"
+#include "scheduler.h"
+
+static_assert(SETTINGS_PRESET_LENGTH == PROGRAM_PARAMS_NUM, "Settings preset length mismatch");
 
 /* Globals */
 
@@ -55,6 +76,11 @@ static alarm_id_t flash_write_alarm_id;
 static volatile int8_t encoder_direction = 0;  // 0 = no change, 1 = up, -1 = down
 static volatile bool button_pressed = false;
 static volatile bool button_long_press_pending = false;
+static volatile bool flash_write_pending = false;
+
+// Handshake between write_flash_data() on core0 and the audio task on core1
+static volatile bool audio_mute_request = false; // Set by core0
+static volatile bool audio_muted = false;        // Set by core1 once both audio buffers are silent
 
 void core1_main();
 
@@ -76,12 +102,13 @@ static inline void update_degree() {
     set_extended_scale(step, degree);
     set_scale_unsaved(true); // Used when the user modifies a scale but does not save it,
                              // and the name of the scale must be changed to "Custom"
+    arpeggiator_scale_changed();
 }
 
 void load_user_preset(uint8_t instrument) {
     uint8_t preset_num = instrument - 12; // Subtracting the 12 default presets (Dodepan + 3 child + 8 PRA32-U)
     for (uint32_t i = 0; i < PROGRAM_PARAMS_NUM; i++) {
-        g_synth.control_change(dodepan_program_parameters[i], user_presets[preset_num][i]);
+        synth_events_post(SYNTH_EVENT_CONTROL_CHANGE, dodepan_program_parameters[i], user_presets[preset_num][i]);
     }
 }
 
@@ -89,7 +116,7 @@ static inline void sync_control_change() {
     uint8_t parameter = get_parameter();
     uint8_t control_number = dodepan_program_parameters[parameter];
     uint8_t argument = get_argument();
-    g_synth.control_change(control_number, argument);
+    synth_events_post(SYNTH_EVENT_CONTROL_CHANGE, control_number, argument);
 }
 
 void update_instrument() {
@@ -97,37 +124,37 @@ void update_instrument() {
     switch (instrument) {
         case 0: // Load custom Dodepan preset
             for (uint32_t i = 0; i < PROGRAM_PARAMS_NUM; i++) {
-                g_synth.control_change(dodepan_program_parameters[i], dodepan_preset[i]);
+                synth_events_post(SYNTH_EVENT_CONTROL_CHANGE, dodepan_program_parameters[i], dodepan_preset[i]);
             }
             set_preset_slot(-1); // No slot selected
         break;
         case 1: // Magic Bell - child-friendly preset
             for (uint32_t i = 0; i < PROGRAM_PARAMS_NUM; i++) {
-                g_synth.control_change(dodepan_program_parameters[i], magic_bell_preset[i]);
+                synth_events_post(SYNTH_EVENT_CONTROL_CHANGE, dodepan_program_parameters[i], magic_bell_preset[i]);
             }
             set_preset_slot(-1);
         break;
         case 2: // Space Piano - child-friendly preset
             for (uint32_t i = 0; i < PROGRAM_PARAMS_NUM; i++) {
-                g_synth.control_change(dodepan_program_parameters[i], space_piano_preset[i]);
+                synth_events_post(SYNTH_EVENT_CONTROL_CHANGE, dodepan_program_parameters[i], space_piano_preset[i]);
             }
             set_preset_slot(-1);
         break;
         case 3: // Robot Voice - child-friendly preset
             for (uint32_t i = 0; i < PROGRAM_PARAMS_NUM; i++) {
-                g_synth.control_change(dodepan_program_parameters[i], robot_voice_preset[i]);
+                synth_events_post(SYNTH_EVENT_CONTROL_CHANGE, dodepan_program_parameters[i], robot_voice_preset[i]);
             }
             set_preset_slot(-1);
         break;
         case 4: // Synthwave - lush 80s style pad
             for (uint32_t i = 0; i < PROGRAM_PARAMS_NUM; i++) {
-                g_synth.control_change(dodepan_program_parameters[i], synthwave_preset[i]);
+                synth_events_post(SYNTH_EVENT_CONTROL_CHANGE, dodepan_program_parameters[i], synthwave_preset[i]);
             }
             set_preset_slot(-1);
         break;
         case 5: // Bleep Bloop - Adventure Time style beeps
             for (uint32_t i = 0; i < PROGRAM_PARAMS_NUM; i++) {
-                g_synth.control_change(dodepan_program_parameters[i], bleep_bloop_preset[i]);
+                synth_events_post(SYNTH_EVENT_CONTROL_CHANGE, dodepan_program_parameters[i], bleep_bloop_preset[i]);
             }
             set_preset_slot(-1);
         break;
@@ -140,7 +167,7 @@ void update_instrument() {
             set_preset_slot(instrument - 14);
         break;
         default: // case 6-13: load PRA32-U presets (shifted by 6)
-            g_synth.program_change(instrument - 6);
+            synth_events_post(SYNTH_EVENT_PROGRAM_CHANGE, instrument - 6, 0);
             set_preset_slot(-1); // No slot selected
         break;
     }
@@ -148,44 +175,38 @@ void update_instrument() {
     // Force polyphonic mode for chord support (required for chords to work)
     // This overrides any preset's voice mode setting
     if (get_chord_mode() != CHORD_OFF) {
-        g_synth.control_change(VOICE_MODE, VOICE_POLYPHONIC);
+        synth_events_post(SYNTH_EVENT_CONTROL_CHANGE, VOICE_MODE, VOICE_POLYPHONIC);
     }
 }
 
 bool load_flash_data() { // Only called at startup
-    // Read address is different than write address
-    const uint8_t *stored_data = (const uint8_t *) (XIP_BASE + FLASH_TARGET_OFFSET);
+    settings_t settings;
+    if (!settings_store_load(&settings)) { return false; } // Nothing stored
+    const uint8_t *globals = settings.globals;
 
     // Validation
-    uint8_t magic[MAGIC_NUMBER_LENGTH] = MAGIC_NUMBER;
-    bool invalid_data = false;
-    for(uint8_t i=0; i<MAGIC_NUMBER_LENGTH; i++){
-        if(stored_data[i] != magic[i]){ return false; } // Invalid data
-    }
-    
-    if((stored_data[MAGIC_NUMBER_LENGTH + 0] > HIGHEST_KEY)          || // Validate key
-       (stored_data[MAGIC_NUMBER_LENGTH + 1] > NUM_SCALES -1)        || // Validate scale
-       (stored_data[MAGIC_NUMBER_LENGTH + 2] > 13 + NUM_PRESET_SLOTS) || // Validate instrument
-       (stored_data[MAGIC_NUMBER_LENGTH + 3] > 0x03)                 || // Validate IMU configuration
-       (stored_data[MAGIC_NUMBER_LENGTH + 4] > 8)                    || // Validate volume
-       (stored_data[MAGIC_NUMBER_LENGTH + 5] > CONTRAST_AUTO)        || // Validate contrast
-       (stored_data[MAGIC_NUMBER_LENGTH + 6] >= NUM_CHORD_MODES)        // Validate chord mode
+    if((globals[0] > HIGHEST_KEY)          || // Validate key
+       (globals[1] > NUM_SCALES -1)        || // Validate scale
+       (globals[2] > 13 + NUM_PRESET_SLOTS) || // Validate instrument
+       (globals[3] > 0x03)                 || // Validate IMU configuration
+       (globals[4] > 8)                    || // Validate volume
+       (globals[5] > CONTRAST_AUTO)        || // Validate contrast
+       (globals[6] >= NUM_CHORD_MODES)        // Validate chord mode
     ) { return false; } // Invalid data
 
     // Data is valid and can be loaded safely
-    set_key(             stored_data[MAGIC_NUMBER_LENGTH + 0]);
-    uint8_t scale =      stored_data[MAGIC_NUMBER_LENGTH + 1] ;
-    set_instrument(      stored_data[MAGIC_NUMBER_LENGTH + 2]);
-    set_imu_axes(        stored_data[MAGIC_NUMBER_LENGTH + 3]);
-    set_volume(          stored_data[MAGIC_NUMBER_LENGTH + 4]);
-    set_contrast(        stored_data[MAGIC_NUMBER_LENGTH + 5]);
-    set_chord_mode(      stored_data[MAGIC_NUMBER_LENGTH + 6]);
+    set_key(             globals[0]);
+    uint8_t scale =      globals[1] ;
+    set_instrument(      globals[2]);
+    set_imu_axes(        globals[3]);
+    set_volume(          globals[4]);
+    set_contrast(        globals[5]);
+    set_chord_mode(      globals[6]);
 
     // Load user presets
-    uint8_t offset = MAGIC_NUMBER_LENGTH + 12;
     for (uint8_t i = 0; i < NUM_PRESET_SLOTS; i++) {
         for (uint8_t j = 0; j < PROGRAM_PARAMS_NUM; j++) {
-            user_presets[i][j] = stored_data[offset++];
+            user_presets[i][j] = settings.presets[i][j];
         }
     }
     update_instrument();
@@ -193,7 +214,7 @@ bool load_flash_data() { // Only called at startup
     // Load user scales
     for (uint8_t i = 0; i < NUM_SCALE_SLOTS; i++) {
         for (uint8_t j = 0; j < 12; j++) {
-            user_scales[i][j] = stored_data[offset++];
+            user_scales[i][j] = settings.scales[i][j];
         }
     }
     set_and_extend_scale(scale);
@@ -205,71 +226,94 @@ bool load_flash_data() { // Only called at startup
     return true;
 }
 
-int64_t write_flash_data(alarm_id_t id, void *) {
-    // Initialize the buffer with a signature
-    uint8_t flash_buffer[FLASH_PAGE_SIZE] = MAGIC_NUMBER;
-    uint8_t index = MAGIC_NUMBER_LENGTH;
-
-    // Gather the rest of the data
-    flash_buffer[MAGIC_NUMBER_LENGTH + 0] = get_key();
-    flash_buffer[MAGIC_NUMBER_LENGTH + 1] = get_scale();
-    flash_buffer[MAGIC_NUMBER_LENGTH + 2] = get_instrument();
-    flash_buffer[MAGIC_NUMBER_LENGTH + 3] = get_imu_axes();
-    flash_buffer[MAGIC_NUMBER_LENGTH + 4] = get_volume();
-    flash_buffer[MAGIC_NUMBER_LENGTH + 5] = get_contrast();
-    flash_buffer[MAGIC_NUMBER_LENGTH + 6] = get_chord_mode();
-
-    // Stop here if the stored data is the same as what we're about to write
-    const uint8_t *stored_data = (const uint8_t *) (XIP_BASE + FLASH_TARGET_OFFSET);
-    if( stored_data[MAGIC_NUMBER_LENGTH + 0] == flash_buffer[MAGIC_NUMBER_LENGTH + 0] &&
-        stored_data[MAGIC_NUMBER_LENGTH + 1] == flash_buffer[MAGIC_NUMBER_LENGTH + 1] &&
-        stored_data[MAGIC_NUMBER_LENGTH + 2] == flash_buffer[MAGIC_NUMBER_LENGTH + 2] &&
-        stored_data[MAGIC_NUMBER_LENGTH + 3] == flash_buffer[MAGIC_NUMBER_LENGTH + 3] &&
-        stored_data[MAGIC_NUMBER_LENGTH + 4] == flash_buffer[MAGIC_NUMBER_LENGTH + 4] &&
-        stored_data[MAGIC_NUMBER_LENGTH + 5] == flash_buffer[MAGIC_NUMBER_LENGTH + 5] &&
-        stored_data[MAGIC_NUMBER_LENGTH + 6] == flash_buffer[MAGIC_NUMBER_LENGTH + 6] &&
-        get_preset_has_changes() == false &&
-        get_scale_has_changes()  == false) { return 0; }
-
-    // Reserving bytes MAGIC_NUMBER_LENGTH + [7-11] for future firmware versions
-
-    // Add user presets to the write buffer
-    uint8_t offset = MAGIC_NUMBER_LENGTH + 12;
+// Settings store flash hook, see settings_flash_write_t
+static void write_flash_range(uint32_t offset, const uint8_t *data, size_t length, bool erase) {
+    // Turn on built-in LED
+    gpio_put(PICO_DEFAULT_LED_PIN, 1);
+
+    // Core1 renders the whole synth on its own from now on, then fades the
+    // output out and fills both audio buffers with silence. The synth keeps
+    // running, so no notes or looper events are lost.
+    g_synth.set_secondary_core_enabled(false);
+    __dmb();
+    audio_mute_request = true;
+
+#if defined (PRA32_U2_USE_2_CORES_FOR_SIGNAL_PROCESSING)
+    // A render request still in flight is taken here rather than in the
+    // interrupt, which would otherwise render the same voices again on top
+    // of this loop. The lockout handshake goes through the inter-core FIFO too.
+    irq_set_enabled(SIO_FIFO_IRQ_NUM(0), false);
+#endif
+    while (!audio_muted) {
+        g_synth.secondary_core_process();
+    }
+#if defined (PRA32_U2_USE_2_CORES_FOR_SIGNAL_PROCESSING)
+    multicore_fifo_drain();
+#endif
+
+    // Park core1 in RAM while flash is not readable, disable interrupts,
+    // write, and restore interrupts
+    multicore_lockout_start_blocking();
+    uint32_t ints_id = save_and_disable_interrupts();
+    if (erase) {
+        flash_range_erase(offset, FLASH_SECTOR_SIZE); // Required for flash_range_program to work
+    }
+    flash_range_program(offset, data, length);
+    restore_interrupts (ints_id);
+    multicore_lockout_end_blocking();
+
+#if defined (PRA32_U2_USE_2_CORES_FOR_SIGNAL_PROCESSING)
+    multicore_fifo_drain();
+    multicore_fifo_clear_irq();
+    irq_set_enabled(SIO_FIFO_IRQ_NUM(0), true);
+#endif
+
+    // Fade the output back in and share the rendering between cores again
+    audio_mute_request = false;
+    g_synth.set_secondary_core_enabled(true);
+
+    // Turn off built-in LED
+    gpio_put(PICO_DEFAULT_LED_PIN, 0);
+}
+
+// Write the settings to flash. Runs in the main loop, see flash_write_pending
+void write_flash_data() {
+    static settings_t settings;
+
+    // Gather the data
+    settings.globals[0] = get_key();
+    settings.globals[1] = get_scale();
+    settings.globals[2] = get_instrument();
+    settings.globals[3] = get_imu_axes();
+    settings.globals[4] = get_volume();
+    settings.globals[5] = get_contrast();
+    settings.globals[6] = get_chord_mode();
+
     for (uint8_t i = 0; i < NUM_PRESET_SLOTS; i++) {
         for (uint8_t j = 0; j < PROGRAM_PARAMS_NUM; j++) {
-            flash_buffer[offset++] = user_presets[i][j];
+            settings.presets[i][j] = user_presets[i][j];
         }
     }
 
-    // Add user scales to the write buffer
     for (uint8_t i = 0; i < NUM_SCALE_SLOTS; i++) {
         for (uint8_t j = 0; j < 12; j++) {
-            flash_buffer[offset++] = user_scales[i][j];
+            settings.scales[i][j] = user_scales[i][j];
         }
     }
 
-    // Turn on built-in LED
-    gpio_put(PICO_DEFAULT_LED_PIN, 1);
-
-    // Stop audio and synth processes on core1
-    multicore_reset_core1();
-
-    // Disable interrupts, write, and restore interrupts
-    uint32_t ints_id = save_and_disable_interrupts();
-	flash_range_erase(FLASH_TARGET_OFFSET, FLASH_SECTOR_SIZE); // Required for flash_range_program to work
-	flash_range_program(FLASH_TARGET_OFFSET, flash_buffer, FLASH_PAGE_SIZE);
-	restore_interrupts (ints_id);
-
-    // Restart processes on core1
-    multicore_launch_core1(core1_main);
+    // Only the items that differ from the stored ones are written,
+    // if there are none this does not touch the flash at all
+    settings_store_save(&settings);
 
     // Wash "dirty" flags
     set_preset_has_changes(false);
     set_scale_has_changes(false);
+}
 
-    // Turn off built-in LED
-    gpio_put(PICO_DEFAULT_LED_PIN, 0);
-
+// Alarm callback - runs in interrupt context, just sets flag
+int64_t on_flash_write_delay(alarm_id_t id, void *) {
+    flash_write_alarm_id = 0;
+    flash_write_pending = true;
     return 0;
 }
 
@@ -277,7 +321,7 @@ void request_flash_write() {
     // Schedule writing settings to flash.
     // This delay is introduced to minimize write operations.
     if (flash_write_alarm_id) cancel_alarm(flash_write_alarm_id);
-    flash_write_alarm_id = add_alarm_in_ms(FLASH_WRITE_DELAY_S * 1000, write_flash_data, NULL, true);
+    flash_write_alarm_id = add_alarm_in_ms(FLASH_WRITE_DELAY_S * 1000, on_flash_write_delay, NULL, true);
 }
 
 void submit_preset_slot() {
@@ -336,60 +380,68 @@ static const struct sound_i2s_config sound_config = {
     .samples_per_buffer = AUDIO_BUFFER_LENGTH,
 };
 
-static inline uint32_t tudi_midi_write24 (uint8_t jack_id, uint8_t b1, uint8_t b2, uint8_t b3) {
-    uint8_t msg[3] = { b1, b2, b3 };
-    return tud_midi_stream_write(jack_id, msg, 3);
-}
-
-// Helper functions for playing notes, callable from C (arpeggiator.c)
+// Helper functions for playing notes, and the Midi hooks of the C modules
 extern "C" {
 
 // Helper to play a single note (internal synth + MIDI)
-// Called by both note_on and the arpeggiator
+// Called by note_on and the chord modes
 void play_single_note(uint8_t note, uint8_t velocity) {
-    g_synth.note_on(note, velocity);
+    synth_events_post(SYNTH_EVENT_NOTE_ON, note, velocity);
 #if defined(USE_MIDI)
-    tudi_midi_write24(0, 0x90, note, velocity);
+    midi_out_send(0x90, note, velocity);
 #endif
 }
 
 // Helper to stop a single note (internal synth + MIDI)
-// Called by both note_off and the arpeggiator
+// Called by note_off
 void stop_single_note(uint8_t note) {
-    g_synth.note_off(note);
+    synth_events_post(SYNTH_EVENT_NOTE_OFF, note, 0);
 #if defined(USE_MIDI)
-    tudi_midi_write24(0, 0x80, note, 0);
+    midi_out_send(0x80, note, 0);
 #endif
 }
 
-// Looper playback hooks (called from looper.c)
-void looper_send_note_on(uint8_t note, uint8_t velocity) {
-    play_single_note(note, velocity);
+// Looper playback hook (called from looper.c). The looper schedules
+// its events on the synth directly, only Midi goes through here.
+void looper_send_midi(uint8_t status, uint8_t data1, uint8_t data2) {
+#if defined(USE_MIDI)
+    midi_out_send(status, data1, data2);
+#endif
 }
 
-void looper_send_note_off(uint8_t note) {
-    stop_single_note(note);
+// Arpeggiator hook (called from arpeggiator.c), which also schedules its notes
+// on the synth directly
+void arpeggiator_send_midi(uint8_t status, uint8_t data1, uint8_t data2) {
+#if defined(USE_MIDI)
+    midi_out_send(status, data1, data2);
+#endif
 }
 
-void looper_send_cc(uint8_t cc_number, uint8_t value) {
-    g_synth.control_change(cc_number, value);
+// USB hook of the Midi output queue (called from midi_out.c)
+bool midi_out_write_packet(const uint8_t *packet) {
 #if defined(USE_MIDI)
-    tudi_midi_write24(0, 0xB0, cc_number, value);
+    return tud_midi_packet_write(packet);
+#else
+    return true;
 #endif
 }
 
-void looper_send_pitch(int16_t pitch_bend) {
-    int16_t bend = pitch_bend + 8192; // Convert signed back to 14-bit MIDI range
-    if (bend < 0) bend = 0;
-    if (bend > 16383) bend = 16383;
-    uint8_t lsb = bend & 0x7F;
-    uint8_t msb = (bend >> 7) & 0x7F;
-    g_synth.pitch_bend(lsb, msb);
+// Midi clock and transport messages (called from tempo.c)
+void tempo_send_midi(uint8_t status) {
 #if defined(USE_MIDI)
-    tudi_midi_write24(0, 0xE0, lsb, msb);
+    midi_out_send_realtime(status);
 #endif
 }
 
+// Start and stop from the incoming Midi clock (called from tempo.c)
+void tempo_transport(bool running) {
+    if (running) {
+        looper_restart_from_start();
+    } else if (looper_is_playing()) {
+        looper_stop();
+    }
+}
+
 } // extern "C"
 
 void note_on(uint8_t id, uint8_t velocity) {
@@ -413,7 +465,6 @@ void note_on(uint8_t id, uint8_t velocity) {
             // Root + Perfect 5th (7 semitones up)
             uint8_t fifth = note + INTERVAL_FIFTH;
             if (fifth <= 127) {
-                sleep_us(100);  // Brief delay for voice allocation
                 play_single_note(fifth, velocity);
                 looper_record_note(fifth, velocity, true);
                 active_chord_notes[id][active_chord_count[id]++] = fifth;
@@ -426,13 +477,11 @@ void note_on(uint8_t id, uint8_t velocity) {
             uint8_t third = note + INTERVAL_THIRD;
             uint8_t fifth = note + INTERVAL_FIFTH;
             if (third <= 127) {
-                sleep_us(100);  // Brief delay for voice allocation
                 play_single_note(third, velocity);
                 looper_record_note(third, velocity, true);
                 active_chord_notes[id][active_chord_count[id]++] = third;
             }
             if (fifth <= 127) {
-                sleep_us(100);  // Brief delay for voice allocation
                 play_single_note(fifth, velocity);
                 looper_record_note(fifth, velocity, true);
                 active_chord_notes[id][active_chord_count[id]++] = fifth;
@@ -444,7 +493,6 @@ void note_on(uint8_t id, uint8_t velocity) {
             // Root + Octave (12 semitones up, not scale degrees)
             uint8_t octave = note + 12;
             if (octave <= 127) {  // MIDI note range check
-                sleep_us(100);  // Brief delay for voice allocation
                 play_single_note(octave, velocity);
                 looper_record_note(octave, velocity, true);
                 active_chord_notes[id][active_chord_count[id]++] = octave;
@@ -464,11 +512,7 @@ void note_off(uint8_t id) {
     active_chord_count[id] = 0;
 }
 
-void touch_on(uint8_t id) {
-    // Set the velocity according to accelerometer data.
-    // The range of velocity is 0-127, but here it's clamped to 64-127
-    uint8_t velocity = imu_data.acceleration;
-
+static void start_touch(uint8_t id, uint8_t velocity) {
     // Track active pad and note for visual feedback
     set_pad_active(id, true);
     set_last_note(get_note_by_id(id));
@@ -480,14 +524,50 @@ void touch_on(uint8_t id) {
         note_on(id, velocity);
     }
 
-    // Since a note_on event can start the looper recording,
-    // a display draw needs to be called here.
+    // The display task draws the note indicator, keeping the touch task short
 #if defined (USE_DISPLAY)
-    display_draw(&display);
+    display_invalidate(DISPLAY_REGION_NOTES);
+#endif
+}
+
+#if defined (USE_IMU)
+// Touches whose note waits for the accelerometer data just after them.
+// One bit per pad, with the time of the touch.
+static uint16_t pending_touches;
+static uint32_t pending_touch_times[12];
+
+// Starts the notes of the pending touches once their velocity is known,
+// and those of the forced pads right away
+static void start_pending_touches(uint16_t forced) {
+    for (uint8_t id = 0; id < 12; id++) {
+        if (!(pending_touches & (1 << id))) { continue; }
+        uint8_t velocity;
+        if (imu_get_velocity(pending_touch_times[id], &velocity) || (forced & (1 << id))) {
+            pending_touches &= ~(1 << id);
+            start_touch(id, velocity);
+        }
+    }
+}
+#endif
+
+void touch_on(uint8_t id, uint32_t time_us) {
+    // Set the velocity according to accelerometer data around the time of this touch.
+    // The range of velocity is 0-127, but here it's clamped to 64-127
+#if defined (USE_IMU)
+    pending_touches |= (1 << id);
+    pending_touch_times[id] = time_us;
+    start_pending_touches(0);
+#else
+    start_touch(id, 127);
 #endif
 }
 
 void touch_off(uint8_t id) {
+#if defined (USE_IMU)
+    // A release only comes MPR121_DEBOUNCE_MS later, but the note on has to go first
+    start_pending_touches(1 << id);
+#endif
+
     // Clear pad from active set
     set_pad_active(id, false);
 
@@ -499,12 +579,26 @@ void touch_off(uint8_t id) {
     }
     
 #if defined (USE_DISPLAY)
-    display_draw(&display);
+    display_invalidate(DISPLAY_REGION_NOTES);
 #endif
 }
 
+void touch_pressure(uint8_t id, uint8_t pressure) {
+    // Arpeggiated notes do not belong to a single pad
+    if (arpeggiator_is_enabled()) { return; }
+
+    // Applies to every note of the chord started by this pad
+    for (uint8_t i = 0; i < active_chord_count[id]; i++) {
+        uint8_t note = active_chord_notes[id][i];
+        synth_events_post(SYNTH_EVENT_POLY_PRESSURE, note, pressure);
+#if defined (USE_MIDI)
+        midi_out_send(0xA0, note, pressure); // Polyphonic key pressure
+#endif
+    }
+}
+
 extern "C" void all_notes_off() {
-    g_synth.all_notes_off();
+    synth_events_post(SYNTH_EVENT_ALL_NOTES_OFF, 0, 0);
     // Stop arpeggiator if running
     arpeggiator_stop();
     // Reset chord tracking state
@@ -516,13 +610,9 @@ extern "C" void all_notes_off() {
 
 // Use the IMU to alter parameters according to device tilting
 void tilt_process() {
-    static uint8_t cc_throttle;
     if(get_imu_axes() & 0x02) {
-        g_synth.control_change(FILTER_CUTOFF, imu_data.deviation_y);
-        // Thin out recorded CC events to avoid exhausting the looper buffer
-        if ((cc_throttle++ & 0x03) == 0) {
-            looper_record_cc(FILTER_CUTOFF, imu_data.deviation_y);
-        }
+        synth_events_post(SYNTH_EVENT_CONTROL_CHANGE, FILTER_CUTOFF, imu_data.deviation_y);
+        looper_record_cc(FILTER_CUTOFF, imu_data.deviation_y);
     }
 
     // Split the bytes
@@ -531,39 +621,97 @@ void tilt_process() {
 
     // Send the instruction to the synth
     if(get_imu_axes() & 0x01) {
-        g_synth.pitch_bend(bending_lsb, bending_msb);
-        static uint8_t pitch_throttle;
-        int16_t bend_signed = (int16_t)imu_data.deviation_x - 8192;
-        if ((pitch_throttle++ & 0x03) == 0) {
-            looper_record_pitch(bend_signed);
-        }
+        synth_events_post(SYNTH_EVENT_PITCH_BEND, bending_lsb, bending_msb);
+        looper_record_pitch((int16_t)imu_data.deviation_x - 8192);
 
 #if defined (USE_MIDI)
-        static uint8_t throttle;
-        if(throttle++ % 10 != 0) return; // Limit the message rate
         // Pitch wheel range is between 0 and 16383 (0x0000 to 0x3FFF),
         // with 8192 (0x2000) being the center value.
-        // Send the Midi message
-        tudi_midi_write24 (0, 0xE0, bending_lsb, bending_msb);
+        // Send the Midi message. Bends the host hasn't taken yet are merged in the queue.
+        midi_out_send(0xE0, bending_lsb, bending_msb);
 #endif
     }
 }
 
+// Apply a queued event to the synth. Runs on core1 only.
+static void __not_in_flash_func(apply_synth_event)(const synth_event_t *event) {
+    switch (event->type) {
+        case SYNTH_EVENT_NOTE_ON:
+            g_synth.note_on(event->data1, event->data2);
+        break;
+        case SYNTH_EVENT_NOTE_OFF:
+            g_synth.note_off(event->data1);
+        break;
+        case SYNTH_EVENT_CONTROL_CHANGE:
+            g_synth.control_change(event->data1, event->data2);
+        break;
+        case SYNTH_EVENT_PITCH_BEND:
+            g_synth.pitch_bend(event->data1, event->data2);
+        break;
+        case SYNTH_EVENT_PROGRAM_CHANGE:
+            g_synth.program_change(event->data1);
+        break;
+        case SYNTH_EVENT_ALL_NOTES_OFF:
+            g_synth.all_notes_off();
+        break;
+        case SYNTH_EVENT_POLY_PRESSURE:
+            g_synth.polyphonic_key_pressure(event->data1, event->data2);
+        break;
+    }
+}
+
 static void __not_in_flash_func(i2s_audio_task)(void) {
     static int16_t *last_buffer;
+    static int16_t synth_buffer[AUDIO_BUFFER_LENGTH];
     int16_t *buffer = sound_i2s_get_next_buffer();
-    int16_t right_buffer; // Necessary quirk for compatibility with
-                          // the original PRA32-U code
             
     if (buffer != last_buffer) { 
         last_buffer = buffer;
-        for (int i = 0; i < AUDIO_BUFFER_LENGTH; i++) {
-        short sample = g_synth.process(right_buffer);
-        int temp = (int)sample * get_volume();
-        short output = (short)(temp >> 3);
-        *buffer++ = output;
-        *buffer++ = output;
+        // The buffer being filled starts playing right after the current one
+        uint32_t block_start = (sound_i2s_num_buffers_played + 1) * AUDIO_BUFFER_LENGTH;
+        int i = 0;
+        while (i < AUDIO_BUFFER_LENGTH) {
+            // Apply the events that are due at this sample, late ones included,
+            // and render up to the next pending event or the end of the block.
+            // Offsets are rounded down to the synth's 4-sample control period,
+            // the finest resolution at which it reacts to events anyway.
+            int end = AUDIO_BUFFER_LENGTH;
+            const synth_event_t *event;
+            while ((event = synth_events_peek()) != NULL) {
+                int32_t offset = (int32_t)(event->time - block_start) & ~3;
+                if (offset > i) {
+                    if (offset < end) { end = offset; }
+                    break;
+                }
+                apply_synth_event(event);
+                synth_events_pop();
+            }
+            g_synth.render_block(synth_buffer + i, end - i);
+            i = end;
+        }
+
+        // Fade out over a block when a mute is requested, and back in after it
+        static int fade_gain = AUDIO_BUFFER_LENGTH;
+        static uint8_t silent_blocks;
+        bool mute = audio_mute_request;
+        bool silent = mute && (fade_gain == 0);
+
+        uint8_t volume = get_volume();
+        for (i = 0; i < AUDIO_BUFFER_LENGTH; i++) {
+            fade_gain += (!mute && fade_gain < AUDIO_BUFFER_LENGTH) - (mute && fade_gain > 0);
+            int temp = (int)synth_buffer[i] * volume * fade_gain / AUDIO_BUFFER_LENGTH;
+            short output = (short)(temp >> 3);
+            *buffer++ = output;
+            *buffer++ = output;
         }
+
+        // Both buffers hold silence after two silent blocks in a row
+        if (!silent) {
+            silent_blocks = 0;
+        } else if (silent_blocks < 2) {
+            silent_blocks++;
+        }
+        audio_muted = (silent_blocks == 2);
     }
 }
 
@@ -614,7 +762,7 @@ void encoder_up() {
             set_chord_mode_up();
             // Force polyphonic mode for chord support
             if (get_chord_mode() != CHORD_OFF) {
-                g_synth.control_change(VOICE_MODE, VOICE_POLYPHONIC);
+                synth_events_post(SYNTH_EVENT_CONTROL_CHANGE, VOICE_MODE, VOICE_POLYPHONIC);
             }
         break;
         case CTX_ARP_PATTERN:
@@ -676,7 +824,7 @@ void encoder_up() {
     if(get_contrast() == CONTRAST_AUTO) {
         display_wake(&display);
     }
-    display_draw(&display);
+    display_invalidate(DISPLAY_REGION_ALL);
 #endif
 }
 
@@ -715,7 +863,7 @@ void encoder_down() {
             set_chord_mode_down();
             // Force polyphonic mode for chord support
             if (get_chord_mode() != CHORD_OFF) {
-                g_synth.control_change(VOICE_MODE, VOICE_POLYPHONIC);
+                synth_events_post(SYNTH_EVENT_CONTROL_CHANGE, VOICE_MODE, VOICE_POLYPHONIC);
             }
         break;
         case CTX_ARP_PATTERN:
@@ -751,10 +899,8 @@ void encoder_down() {
             set_preset_slot_down();
         break;
         case CTX_LOOPER:
-            // Restart loop from beginning
-            if (looper_has_loop()) {
-                looper_restart_from_start();
-            }
+            // Undo the last overdubbed take
+            looper_undo();
             set_context(CTX_LOOPER); // Keep context steady to avoid stray handlers
         break;
         case CTX_SCALE_EDIT_STEP:
@@ -777,7 +923,7 @@ void encoder_down() {
     if(get_contrast() == CONTRAST_AUTO) {
         display_wake(&display);
     }
-    display_draw(&display);
+    display_invalidate(DISPLAY_REGION_ALL);
 #endif
 }
 
@@ -870,7 +1016,7 @@ void button_long_press() {
     if(get_contrast() == CONTRAST_AUTO) {
         display_wake(&display);
     }
-    display_draw(&display);
+    display_invalidate(DISPLAY_REGION_ALL);
 #endif
 }
 
@@ -968,7 +1114,7 @@ void button_short_press() {
     if(get_contrast() == CONTRAST_AUTO) {
         display_wake(&display);
     }
-    display_draw(&display);
+    display_invalidate(DISPLAY_REGION_ALL);
 #endif
 }
 
@@ -992,6 +1138,9 @@ void button_onchange(button_t *button_p) {
 void battery_low_detected() {
     set_low_batt(true);
     battery_check_stop(); // Stop the timer
+#if defined (USE_DISPLAY)
+    display_invalidate(DISPLAY_REGION_SCREEN);
+#endif
 }
 
 // Declare binary information
@@ -1002,6 +1151,12 @@ void bi_decl_all() {
     bi_decl(bi_program_url(PROGRAM_URL));
     bi_decl(bi_1pin_with_name(MPR121_SDA_PIN, MPR121_SDA_DESCRIPTION));
     bi_decl(bi_1pin_with_name(MPR121_SCL_PIN, MPR121_SCL_DESCRIPTION));
+#if defined (MPR121_IRQ_PIN)
+    bi_decl(bi_1pin_with_name(MPR121_IRQ_PIN, MPR121_IRQ_DESCRIPTION));
+#endif
+#if defined (USE_IMU) && defined (MPU6050_INT_PIN)
+    bi_decl(bi_1pin_with_name(MPU6050_INT_PIN, MPU6050_INT_DESCRIPTION));
+#endif
     bi_decl(bi_1pin_with_name(ENCODER_DT_PIN, ENCODER_DT_DESCRIPTION));
     bi_decl(bi_1pin_with_name(ENCODER_CLK_PIN, ENCODER_CLK_DESCRIPTION));
     bi_decl(bi_1pin_with_name(ENCODER_SWITCH_PIN, ENCODER_SWITCH_DESCRIPTION));
@@ -1022,19 +1177,122 @@ void bi_decl_all() {
     I2S_CLOCK_PIN_BASE+1, I2S_LRCK_DESCRIPTION));
 }
 
+#if defined (PRA32_U2_USE_2_CORES_FOR_SIGNAL_PROCESSING)
+// Core1 hands half of the voices of each block over to core0 through the
+// inter-core FIFO. Rendering them in this interrupt preempts the UI work of
+// the main loop, which only gets the time left over, and costs a single
+// handshake per block.
+static void __not_in_flash_func(core0_render_irq)(void) {
+    multicore_fifo_drain();
+    multicore_fifo_clear_irq();
+    g_synth.secondary_core_process();
+}
+#endif
+
 // Secondary core task - handles audio generation
-// With higher clock speed, single core can handle 4-voice polyphony
+// With PRA32_U2_USE_2_CORES_FOR_SIGNAL_PROCESSING, half of the voices
+// are rendered on core0, see core0_render_irq()
 void core1_main() {
+    // Let core0 park this core while it writes to flash
+    multicore_lockout_victim_init();
+
     while(true) {
-        g_synth.secondary_core_process();
         i2s_audio_task();
     }
 }
 
+/* Core0 tasks, see scheduler.h */
+static void touch_task() {
+    mpr121_task();
+}
+
+static void ui_task() {
+    // Process deferred encoder events (set from interrupt context)
+    if (encoder_direction != 0) {
+        int8_t dir = encoder_direction;
+        encoder_direction = 0;  // Clear flag first to avoid missing events
+        if (dir == 1) {
+            encoder_down();
+        } else if (dir == -1) {
+            encoder_up();
+        }
+    }
+
+    // Process deferred button events (set from interrupt context)
+    if (button_pressed) {
+        button_pressed = false;
+        button_short_press();
+    }
+    if (button_long_press_pending) {
+        button_long_press_pending = false;
+        button_long_press();
+    }
+
+    tempo_task();
+    looper_task();
+    arpeggiator_task();
+
+    if (flash_write_pending) {
+        flash_write_pending = false;
+        write_flash_data();
+    }
+}
+
+#if defined (USE_IMU)
+static void imu_tilt_task() {
+    // Keep draining the FIFO for the velocity, even with tilt off
+    imu_task(&imu_data);
+    start_pending_touches(0);
+    if(get_imu_axes() > 0) {
+        tilt_process();
+    }
+}
+#endif
+
+#if defined (USE_DISPLAY)
+static void display_task() {
+    // Compose a frame if anything on screen was invalidated since the last one
+    display_update(&display);
+}
+#endif
+
+#if defined (USE_MIDI)
+static void usb_task() {
+    tud_task(); // tinyusb device task
+
+    // Incoming Midi, in one read per task so a busy host can't hold up touch scanning
+    uint8_t buffer[MIDI_IN_MAX_BYTES];
+    uint32_t length = tud_midi_stream_read(buffer, sizeof(buffer));
+    midi_in_process(buffer, length);
+
+    // Outgoing Midi, as far as the host takes it
+    if (tud_midi_mounted()) {
+        midi_out_flush();
+    } else {
+        midi_out_clear();
+    }
+}
+#endif
+
+// Name, function, period and priority, 0 being the most urgent
+static scheduler_task_t tasks[] = {
+    { "touch",   touch_task,    TOUCH_TASK_PERIOD_US,   0 },
+#if defined (USE_MIDI)
+    { "usb",     usb_task,      USB_TASK_PERIOD_US,     1 },
+#endif
+    { "ui",      ui_task,       UI_TASK_PERIOD_US,      2 },
+#if defined (USE_IMU)
+    { "imu",     imu_tilt_task, IMU_TASK_PERIOD_US,     3 },
+#endif
+#if defined (USE_DISPLAY)
+    { "display", display_task,  DISPLAY_TASK_PERIOD_US, 4 },
+#endif
+};
+
 int main() {
     // Adjust the clock speed to be an even multiplier
     // of the audio sampling frequency
-    // RP2350 runs at higher clock for 4-voice polyphony on single core
+    // See PRA32_U2_NUM_VOICES for the polyphony at this clock
     if (SOUND_OUTPUT_FREQUENCY % 11025 == 0) { // For 22.05, 44.1, 88.2 kHz
         set_sys_clock_khz(264600, false);  // 264.6 MHz (multiple of 44.1kHz base)
     } else if (SOUND_OUTPUT_FREQUENCY % 8000 == 0) { // For 8, 16, 32, 48, 96, 192 kHz
@@ -1066,8 +1324,8 @@ int main() {
 
     i2c_init(SSD1306_I2C_PORT, SSD1306_I2C_FREQ);
     
-    // Initialize mutex for I2C1 bus to prevent collisions between display and IMU
-    i2c1_mutex_init();
+    // Queue the display and IMU transactions on the I2C1 bus, so they can't collide
+    i2c1_bus_init(SSD1306_I2C_FREQ);
 #endif
 
 #if defined (USE_DISPLAY)
@@ -1080,6 +1338,7 @@ int main() {
 
     // Start the audio engine.
     sound_i2s_init(&sound_config);
+    synth_events_init();
 
     // Start the synth
     g_synth.initialize();
@@ -1105,6 +1364,7 @@ int main() {
     }
 
     // Attempt to load previous settings, if stored on flash
+    settings_store_init(write_flash_range);
     bool data_loaded = load_flash_data();
     if(!data_loaded) {
         // Settings not loaded, initialize state with default values
@@ -1134,6 +1394,16 @@ int main() {
         }
     }
 
+#if defined (PRA32_U2_USE_2_CORES_FOR_SIGNAL_PROCESSING)
+    // Render requests from core1 take priority over anything else on core0
+    render_claim_lock = spin_lock_init(spin_lock_claim_unused(true));
+    multicore_fifo_drain();
+    multicore_fifo_clear_irq();
+    irq_set_exclusive_handler(SIO_FIFO_IRQ_NUM(0), core0_render_irq);
+    irq_set_priority(SIO_FIFO_IRQ_NUM(0), PICO_HIGHEST_IRQ_PRIORITY);
+    irq_set_enabled(SIO_FIFO_IRQ_NUM(0), true);
+#endif
+
     // Launch the routine on the second core
     multicore_launch_core1(core1_main);
 
@@ -1141,10 +1411,17 @@ int main() {
     mpr121_i2c_init();
 
     // Initialize the audio looper with fixed-length buffer
-    looper_init(LOOPER_MAX_EVENTS, LOOPER_MAX_SECONDS * 1000);
+    looper_init(LOOPER_MEMORY_SIZE, LOOPER_MAX_SECONDS * 1000);
 
-    // Initialize the arpeggiator
+    // Initialize the arpeggiator, and the tempo clock that follows its speed
     arpeggiator_init();
+    tempo_init();
+
+#if defined (USE_MIDI)
+    // Initialize the parser of incoming Midi, and the queue of outgoing Midi
+    midi_in_init();
+    midi_out_init();
+#endif
 
     // Initialize the rotary encoder and switch
 #if defined (ENCODER_USE_PULLUPS)
@@ -1158,7 +1435,6 @@ int main() {
     // Falloff values in case the IMU is disabled
     imu_data.deviation_x = 0x2000;  // Center value
     imu_data.deviation_y = 64;      // Center value
-    imu_data.acceleration = 127;    // Max value
 
     // Use the onboard LED as a power-on indicator
     gpio_init(PICO_DEFAULT_LED_PIN);
@@ -1169,7 +1445,7 @@ int main() {
     // Initialize the ADC, used for voltage sensing
     adc_init();
     // Launch the battery check timed task
-    battery_check_init(5000, NULL, (void*)battery_low_detected);
+    battery_check_init(BATTERY_CHECK_INTERVAL_MS, NULL, (void*)battery_low_detected);
 
 #if defined (USE_DISPLAY)
     // Show a short intro animation. This will distract the user
@@ -1182,48 +1458,8 @@ int main() {
     set_context(CTX_SELECTION);
 #endif
 
+    scheduler_init(tasks, sizeof(tasks) / sizeof(tasks[0]));
     while (true) { // Main loop
-        mpr121_task();
-
-        // Process deferred encoder events (set from interrupt context)
-        if (encoder_direction != 0) {
-            int8_t dir = encoder_direction;
-            encoder_direction = 0;  // Clear flag first to avoid missing events
-            if (dir == 1) {
-                encoder_down();
-            } else if (dir == -1) {
-                encoder_up();
-            }
-        }
-
-        // Process deferred button events (set from interrupt context)
-        if (button_pressed) {
-            button_pressed = false;
-            button_short_press();
-        }
-        if (button_long_press_pending) {
-            button_long_press_pending = false;
-            button_long_press();
-        }
-
-#if defined (USE_IMU)
-        if(get_imu_axes() > 0) {
-            imu_task(&imu_data);
-            tilt_process();
-        }
-#endif
-
-#if defined (USE_DISPLAY)
-        // Process any deferred display updates (when I2C was busy during touch/encoder events)
-        if(display_is_pending()) {
-            display_draw(&display);
-        }
-#endif
-
-        looper_task();
-        arpeggiator_task();
-#if defined (USE_MIDI)
-        tud_task(); // tinyusb device task
-#endif
+        scheduler_run();
     }
 }
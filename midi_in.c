@@ -0,0 +1,290 @@
+#include "pico/stdlib.h"
+#include <string.h>
+#include "config.h"
+#include "synth_events.h"
+#include "tempo.h"
+#include "midi_in.h"
+
+#define DATA_INVALID    0xFF
+
+// One bit per note or controller
+typedef struct {
+    uint32_t bits[4];
+} midi_in_set_t;
+
+typedef struct {
+    // Parser
+    uint8_t running_status;
+    uint8_t data[2];
+    uint8_t data_count;
+    uint8_t system_data_remaining;  // Data bytes of a system common message to skip
+    bool sysex;
+    uint8_t sysex_data[MIDI_IN_SYSEX_MAX];
+    uint8_t sysex_length;
+
+    // Budgets left in this call
+    uint8_t notes_left;
+    uint8_t controls_left;
+
+    // Held over to the next call
+    midi_in_set_t note_offs;
+    midi_in_set_t controls;
+    midi_in_set_t pressures;
+    uint8_t control_values[128];
+    uint8_t pressure_values[128];
+    bool pitch_pending;
+    uint8_t pitch_lsb;
+    uint8_t pitch_msb;
+    bool program_pending;
+    uint8_t program;
+
+    midi_in_stats_t stats;
+} midi_in_t;
+
+static midi_in_t midi_in;
+
+static inline bool set_has(const midi_in_set_t *set, uint8_t i) {
+    return set->bits[i >> 5] & (1u << (i & 31));
+}
+
+static inline void set_add(midi_in_set_t *set, uint8_t i) {
+    set->bits[i >> 5] |= (1u << (i & 31));
+}
+
+static inline void set_remove(midi_in_set_t *set, uint8_t i) {
+    set->bits[i >> 5] &= ~(1u << (i & 31));
+}
+
+void midi_in_init(void) {
+    memset(&midi_in, 0, sizeof(midi_in));
+    midi_in.running_status = DATA_INVALID;
+}
+
+const midi_in_stats_t *midi_in_get_stats(void) {
+    return &midi_in.stats;
+}
+
+static void note_off(uint8_t note) {
+    if (set_has(&midi_in.note_offs, note)) { return; }
+    if (!synth_events_post(SYNTH_EVENT_NOTE_OFF, note, 0)) {
+        set_add(&midi_in.note_offs, note);
+        midi_in.stats.deferred++;
+    }
+}
+
+static void note_on(uint8_t note, uint8_t velocity) {
+    // A note off still waiting for room goes first
+    if (set_has(&midi_in.note_offs, note)) {
+        if (!synth_events_post(SYNTH_EVENT_NOTE_OFF, note, 0)) {
+            midi_in.stats.notes_dropped++;
+            return;
+        }
+        set_remove(&midi_in.note_offs, note);
+    }
+    if (midi_in.notes_left == 0 || !synth_events_post(SYNTH_EVENT_NOTE_ON, note, velocity)) {
+        midi_in.stats.notes_dropped++;
+        return;
+    }
+    midi_in.notes_left--;
+}
+
+// Posts a control update if it is within budget and there is room for it
+static bool post_control(synth_event_type_t type, uint8_t data1, uint8_t data2) {
+    if (midi_in.controls_left == 0) { return false; }
+    if (!synth_events_post(type, data1, data2)) { return false; }
+    midi_in.controls_left--;
+    return true;
+}
+
+static void control_change(uint8_t control, uint8_t value) {
+    if (set_has(&midi_in.controls, control)) {
+        midi_in.control_values[control] = value;
+        midi_in.stats.merged++;
+    } else if (!post_control(SYNTH_EVENT_CONTROL_CHANGE, control, value)) {
+        midi_in.control_values[control] = value;
+        set_add(&midi_in.controls, control);
+        midi_in.stats.deferred++;
+    }
+}
+
+static void poly_pressure(uint8_t note, uint8_t pressure) {
+    if (set_has(&midi_in.pressures, note)) {
+        midi_in.pressure_values[note] = pressure;
+        midi_in.stats.merged++;
+    } else if (!post_control(SYNTH_EVENT_POLY_PRESSURE, note, pressure)) {
+        midi_in.pressure_values[note] = pressure;
+        set_add(&midi_in.pressures, note);
+        midi_in.stats.deferred++;
+    }
+}
+
+static void pitch_bend(uint8_t lsb, uint8_t msb) {
+    if (midi_in.pitch_pending) {
+        midi_in.stats.merged++;
+    } else if (post_control(SYNTH_EVENT_PITCH_BEND, lsb, msb)) {
+        return;
+    } else {
+        midi_in.pitch_pending = true;
+        midi_in.stats.deferred++;
+    }
+    midi_in.pitch_lsb = lsb;
+    midi_in.pitch_msb = msb;
+}
+
+static void program_change(uint8_t program) {
+    if (midi_in.program_pending) {
+        midi_in.stats.merged++;
+    } else if (post_control(SYNTH_EVENT_PROGRAM_CHANGE, program, 0)) {
+        return;
+    } else {
+        midi_in.program_pending = true;
+        midi_in.stats.deferred++;
+    }
+    midi_in.program = program;
+}
+
+// Forwards what was held over, note offs first
+static void flush_pending(void) {
+    for (uint8_t word = 0; word < 4; word++) {
+        while (midi_in.note_offs.bits[word]) {
+            uint8_t note = (word << 5) + __builtin_ctz(midi_in.note_offs.bits[word]);
+            if (!synth_events_post(SYNTH_EVENT_NOTE_OFF, note, 0)) { return; }
+            set_remove(&midi_in.note_offs, note);
+        }
+    }
+    if (midi_in.program_pending && post_control(SYNTH_EVENT_PROGRAM_CHANGE, midi_in.program, 0)) {
+        midi_in.program_pending = false;
+    }
+    for (uint8_t word = 0; word < 4; word++) {
+        while (midi_in.controls.bits[word]) {
+            uint8_t control = (word << 5) + __builtin_ctz(midi_in.controls.bits[word]);
+            if (!post_control(SYNTH_EVENT_CONTROL_CHANGE, control, midi_in.control_values[control])) { return; }
+            set_remove(&midi_in.controls, control);
+        }
+    }
+    if (midi_in.pitch_pending && post_control(SYNTH_EVENT_PITCH_BEND, midi_in.pitch_lsb, midi_in.pitch_msb)) {
+        midi_in.pitch_pending = false;
+    }
+    for (uint8_t word = 0; word < 4; word++) {
+        while (midi_in.pressures.bits[word]) {
+            uint8_t note = (word << 5) + __builtin_ctz(midi_in.pressures.bits[word]);
+            if (!post_control(SYNTH_EVENT_POLY_PRESSURE, note, midi_in.pressure_values[note])) { return; }
+            set_remove(&midi_in.pressures, note);
+        }
+    }
+}
+
+static void channel_message(uint8_t status) {
+    if ((status & 0x0F) != PRA32_U_MIDI_CH) { return; }
+    midi_in.stats.messages++;
+    uint8_t data1 = midi_in.data[0];
+    uint8_t data2 = midi_in.data[1];
+    switch (status & 0xF0) {
+        case 0x80:
+            note_off(data1);
+            break;
+        case 0x90:
+            if (data2 == 0) {
+                note_off(data1);
+            } else {
+                note_on(data1, data2);
+            }
+            break;
+        case 0xA0:
+            poly_pressure(data1, data2);
+            break;
+        case 0xB0:
+            control_change(data1, data2);
+            break;
+        case 0xC0:
+            program_change(data1);
+            break;
+        case 0xE0:
+            pitch_bend(data1, data2);
+            break;
+        default: // Channel pressure, which the synth has no use for
+            break;
+    }
+}
+
+// The synth has no SysEx of its own. A GM or GM2 System On resets what a
+// song may have left behind, which is what a host sends it for.
+static void sysex_message(void) {
+    const uint8_t *d = midi_in.sysex_data;
+    if (midi_in.sysex_length == 4 && d[0] == 0x7E && d[2] == 0x09 && (d[3] == 0x01 || d[3] == 0x03)) {
+        synth_events_post(SYNTH_EVENT_ALL_NOTES_OFF, 0, 0);
+        synth_events_post(SYNTH_EVENT_PITCH_BEND, 0, 64);
+    }
+}
+
+static void receive_byte(uint8_t b) {
+    if (b >= 0xF8) {
+        // Realtime, anywhere in the stream, without affecting the rest
+        tempo_midi_in(b, synth_events_now());
+        return;
+    }
+    if (b < 0x80) {
+        if (midi_in.sysex) {
+            if (midi_in.sysex_length < MIDI_IN_SYSEX_MAX) {
+                midi_in.sysex_data[midi_in.sysex_length] = b;
+            }
+            if (midi_in.sysex_length < 0xFF) { midi_in.sysex_length++; }
+        } else if (midi_in.system_data_remaining != 0) {
+            midi_in.system_data_remaining--;
+        } else if (midi_in.running_status != DATA_INVALID) {
+            midi_in.data[midi_in.data_count++] = b;
+            uint8_t type = midi_in.running_status & 0xF0;
+            uint8_t length = (type == 0xC0 || type == 0xD0) ? 1 : 2;
+            if (midi_in.data_count == length) {
+                channel_message(midi_in.running_status);
+                midi_in.data_count = 0;
+            }
+        }
+        return;
+    }
+
+    // A status byte ends any SysEx, and cancels the running status unless
+    // it is a channel message
+    if (midi_in.sysex) {
+        midi_in.sysex = false;
+        if (b == 0xF7) {
+            midi_in.stats.sysex++;
+            if (midi_in.sysex_length > MIDI_IN_SYSEX_MAX) {
+                midi_in.stats.sysex_truncated++;
+            } else {
+                sysex_message();
+            }
+        }
+    }
+    midi_in.data_count = 0;
+    midi_in.system_data_remaining = 0;
+    if (b < 0xF0) {
+        midi_in.running_status = b;
+        return;
+    }
+    midi_in.running_status = DATA_INVALID;
+    switch (b) {
+        case 0xF0:
+            midi_in.sysex = true;
+            midi_in.sysex_length = 0;
+            break;
+        case 0xF1: // Time code quarter frame
+        case 0xF3: // Song select
+            midi_in.system_data_remaining = 1;
+            break;
+        case 0xF2: // Song position
+            midi_in.system_data_remaining = 2;
+            break;
+        default:
+            break;
+    }
+}
+
+void midi_in_process(const uint8_t *data, uint32_t length) {
+    midi_in.notes_left = MIDI_IN_NOTES_PER_TICK;
+    midi_in.controls_left = MIDI_IN_CONTROLS_PER_TICK;
+    flush_pending();
+    for (uint32_t i = 0; i < length; i++) {
+        receive_byte(data[i]);
+    }
+}
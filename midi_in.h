@@ -0,0 +1,43 @@
+#ifndef MIDI_IN_H
+#define MIDI_IN_H
+
+#include "pico/stdlib.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Midi received over USB, played on the internal synth.
+// A byte parser after the one of the PRA32-U2 library (PRA32_U2_MIDIIn),
+// which calls the synth directly and so could only run on core1. This one
+// runs in the USB task on core0 and posts the channel messages for
+// PRA32_U_MIDI_CH as synth events. Realtime messages go to the tempo clock.
+//
+// Each call gets a budget of note ons and of control updates, so a dense
+// stream from the host can't fill the synth event queue and crowd out the
+// pads. Note ons over budget are dropped. Control updates over budget wait
+// for the next call, merged with any later value of the same control, and
+// so do note offs that find the queue full.
+
+typedef struct {
+    uint32_t messages;          // Channel messages for the synth
+    uint32_t notes_dropped;     // Note ons over MIDI_IN_NOTES_PER_TICK, or with the queue full
+    uint32_t deferred;          // Messages held over to a later call
+    uint32_t merged;            // Control updates replaced by a later value before they went out
+    uint32_t sysex;             // SysEx messages received
+    uint32_t sysex_truncated;   // Longer than MIDI_IN_SYSEX_MAX, only the start was looked at
+} midi_in_stats_t;
+
+void midi_in_init(void);
+
+// Parses the bytes read from the USB Midi stream, after the messages held
+// over from the previous call. Call once per USB task, even with no bytes.
+void midi_in_process(const uint8_t *data, uint32_t length);
+
+const midi_in_stats_t *midi_in_get_stats(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
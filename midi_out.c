@@ -0,0 +1,164 @@
+#include "pico/stdlib.h"
+#include <string.h>
+#include "config.h"
+#include "midi_out.h"
+
+// USB hook in main.cpp, returns false if the packet was not taken
+extern bool midi_out_write_packet(const uint8_t *packet);
+
+// A zero header, which no message has, marks a packet taken back out
+#define HOLE            0
+
+#define REALTIME_SIZE   8
+
+_Static_assert((MIDI_OUT_QUEUE_SIZE & (MIDI_OUT_QUEUE_SIZE - 1)) == 0 && MIDI_OUT_QUEUE_SIZE <= 128,
+               "MIDI_OUT_QUEUE_SIZE must be a power of two, up to 128");
+
+typedef struct {
+    uint8_t packets[MIDI_OUT_QUEUE_SIZE][4];
+    uint8_t head;
+    uint8_t count;
+
+    uint8_t realtime[REALTIME_SIZE];
+    uint8_t realtime_count;
+
+    uint32_t offs_held[16][4];  // Notes of each channel with a note off held aside
+
+    midi_out_stats_t stats;
+} midi_out_t;
+
+static midi_out_t midi_out;
+
+static inline uint8_t *queued(uint8_t i) {
+    return midi_out.packets[(midi_out.head + i) & (MIDI_OUT_QUEUE_SIZE - 1)];
+}
+
+static inline bool is_note(uint8_t status) {
+    return (status & 0xF0) == 0x80 || (status & 0xF0) == 0x90;
+}
+
+static inline bool is_note_off(uint8_t status, uint8_t velocity) {
+    return (status & 0xF0) == 0x80 || ((status & 0xF0) == 0x90 && velocity == 0);
+}
+
+void midi_out_init(void) {
+    memset(&midi_out, 0, sizeof(midi_out));
+}
+
+void midi_out_clear(void) {
+    midi_out.head = 0;
+    midi_out.count = 0;
+    midi_out.realtime_count = 0;
+    memset(midi_out.offs_held, 0, sizeof(midi_out.offs_held));
+}
+
+const midi_out_stats_t *midi_out_get_stats(void) {
+    return &midi_out.stats;
+}
+
+// The queued update of the same control, if no note message came after it
+static uint8_t *find_update(uint8_t status, uint8_t data1) {
+    uint8_t type = status & 0xF0;
+    for (uint8_t i = midi_out.count; i > 0; i--) {
+        uint8_t *packet = queued(i - 1);
+        if (packet[0] == HOLE) { continue; }
+        if (is_note(packet[1])) { return NULL; }
+        if (packet[1] != status) { continue; }
+        if (type == 0xD0 || type == 0xE0 || packet[2] == data1) { return packet; }
+    }
+    return NULL;
+}
+
+// True if the note off is not needed in the full queue: either its note on
+// is still there and is taken back out, or a note off is already queued
+static bool settle_note_off(uint8_t status, uint8_t note) {
+    uint8_t channel = status & 0x0F;
+    for (uint8_t i = midi_out.count; i > 0; i--) {
+        uint8_t *packet = queued(i - 1);
+        if (packet[0] == HOLE || !is_note(packet[1])) { continue; }
+        if ((packet[1] & 0x0F) != channel || packet[2] != note) { continue; }
+        if (!is_note_off(packet[1], packet[3])) {
+            packet[0] = HOLE;
+        }
+        return true;
+    }
+    return false;
+}
+
+void midi_out_send(uint8_t status, uint8_t data1, uint8_t data2) {
+    uint8_t type = status & 0xF0;
+    bool note_off = is_note_off(status, data2);
+
+    if (type == 0xA0 || type == 0xB0 || type == 0xD0 || type == 0xE0) {
+        uint8_t *packet = find_update(status, data1);
+        if (packet != NULL) {
+            packet[2] = data1;
+            packet[3] = data2;
+            midi_out.stats.merged++;
+            return;
+        }
+    }
+
+    uint8_t limit = note_off ? MIDI_OUT_QUEUE_SIZE : MIDI_OUT_QUEUE_SIZE - MIDI_OUT_RESERVE;
+    if (midi_out.count < limit) {
+        uint8_t *packet = queued(midi_out.count++);
+        packet[0] = type >> 4; // Cable 0, and the code index of a channel message
+        packet[1] = status;
+        packet[2] = data1;
+        packet[3] = (type == 0xC0 || type == 0xD0) ? 0 : data2;
+        return;
+    }
+    if (!note_off) {
+        midi_out.stats.dropped++;
+        return;
+    }
+    if (settle_note_off(status, data1)) {
+        midi_out.stats.cancelled++;
+        return;
+    }
+    midi_out.offs_held[status & 0x0F][data1 >> 5] |= (1u << (data1 & 31));
+    midi_out.stats.offs_held++;
+}
+
+void midi_out_send_realtime(uint8_t status) {
+    if (midi_out.realtime_count == REALTIME_SIZE) {
+        midi_out.stats.dropped++;
+        return;
+    }
+    midi_out.realtime[midi_out.realtime_count++] = status;
+}
+
+void midi_out_flush(void) {
+    // Realtime first, its timing matters most
+    while (midi_out.realtime_count > 0) {
+        uint8_t packet[4] = { 0x0F, midi_out.realtime[0], 0, 0 };
+        if (!midi_out_write_packet(packet)) { return; }
+        midi_out.stats.sent++;
+        midi_out.realtime_count--;
+        memmove(midi_out.realtime, midi_out.realtime + 1, midi_out.realtime_count);
+    }
+
+    // Then the note offs held aside. Their note ons went out before them.
+    for (uint8_t channel = 0; channel < 16; channel++) {
+        for (uint8_t word = 0; word < 4; word++) {
+            uint32_t *bits = &midi_out.offs_held[channel][word];
+            while (*bits) {
+                uint8_t note = (word << 5) + __builtin_ctz(*bits);
+                uint8_t packet[4] = { 0x08, (uint8_t)(0x80 | channel), note, 0 };
+                if (!midi_out_write_packet(packet)) { return; }
+                midi_out.stats.sent++;
+                *bits &= ~(1u << (note & 31));
+            }
+        }
+    }
+
+    while (midi_out.count > 0) {
+        uint8_t *packet = queued(0);
+        if (packet[0] != HOLE) {
+            if (!midi_out_write_packet(packet)) { return; }
+            midi_out.stats.sent++;
+        }
+        midi_out.head = (midi_out.head + 1) & (MIDI_OUT_QUEUE_SIZE - 1);
+        midi_out.count--;
+    }
+}
@@ -0,0 +1,50 @@
+#ifndef MIDI_OUT_H
+#define MIDI_OUT_H
+
+#include "pico/stdlib.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Queue of the Midi messages sent over USB, as 4 byte USB-MIDI event
+// packets. Messages are queued by the core0 tasks and flushed in bulk by
+// the USB task, as far as the host takes them.
+//
+// - Realtime messages (clock, start, stop) go out first.
+// - A CC, pitch bend or pressure update replaces the queued value of the
+//   same control, unless a note message was queued after it.
+// - The last MIDI_OUT_RESERVE slots are kept for note offs. With the queue
+//   full, a note off takes its note on out of the queue if it is still
+//   there, or else is held aside and sent before anything else, so no
+//   note is left hanging.
+
+typedef struct {
+    uint32_t sent;              // Packets taken by USB
+    uint32_t merged;            // Updates folded into a queued one
+    uint32_t dropped;           // Messages refused with the queue full
+    uint32_t cancelled;         // Note ons taken back out by their note off
+    uint32_t offs_held;         // Note offs held aside from the full queue
+} midi_out_stats_t;
+
+void midi_out_init(void);
+
+// Channel message, 2 or 3 bytes depending on the status
+void midi_out_send(uint8_t status, uint8_t data1, uint8_t data2);
+
+// Single byte realtime message
+void midi_out_send_realtime(uint8_t status);
+
+// Hands the queued packets to USB, until it takes no more. Call from the USB task.
+void midi_out_flush(void);
+
+// Empties the queue, such as while no host is connected
+void midi_out_clear(void);
+
+const midi_out_stats_t *midi_out_get_stats(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
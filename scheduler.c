@@ -0,0 +1,53 @@
+#include "pico/stdlib.h"
+#include "scheduler.h"
+
+static scheduler_task_t *tasks;
+static uint8_t num_tasks;
+
+void scheduler_init(scheduler_task_t *task_list, uint8_t count) {
+    tasks = task_list;
+    num_tasks = count;
+
+    uint32_t now = time_us_32();
+    for (uint8_t i = 0; i < num_tasks; i++) {
+        tasks[i].next_release_us = now;
+        tasks[i].overruns = 0;
+        tasks[i].max_lateness_us = 0;
+        tasks[i].max_duration_us = 0;
+    }
+}
+
+bool scheduler_run(void) {
+    uint32_t now = time_us_32();
+
+    // Pick the most urgent of the due tasks, the earliest released on a tie
+    scheduler_task_t *task = NULL;
+    for (uint8_t i = 0; i < num_tasks; i++) {
+        scheduler_task_t *candidate = &tasks[i];
+        if ((int32_t)(now - candidate->next_release_us) < 0) { continue; }
+        if (task == NULL ||
+            candidate->priority < task->priority ||
+            (candidate->priority == task->priority &&
+             (int32_t)(candidate->next_release_us - task->next_release_us) < 0)) {
+            task = candidate;
+        }
+    }
+    if (task == NULL) { return false; }
+
+    uint32_t lateness = now - task->next_release_us;
+    if (lateness > task->max_lateness_us) { task->max_lateness_us = lateness; }
+
+    // Schedule the next release, skipping the missed ones
+    if (lateness >= task->period_us) {
+        task->overruns += lateness / task->period_us;
+        task->next_release_us = now + task->period_us;
+    } else {
+        task->next_release_us += task->period_us;
+    }
+
+    task->func();
+
+    uint32_t duration = time_us_32() - now;
+    if (duration > task->max_duration_us) { task->max_duration_us = duration; }
+    return true;
+}
@@ -0,0 +1,37 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+#include "pico/stdlib.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Fixed-rate cooperative scheduler for core0.
+// Each task is released once per period and runs to completion. When several
+// tasks are due, the one with the lowest priority value runs first. A task
+// that is released more than a whole period late skips the releases it
+// missed, and each of those counts as an overrun.
+
+typedef struct {
+    const char *name;
+    void (*func)(void);
+    uint32_t period_us;
+    uint8_t priority;           // 0 is the most urgent
+
+    // Maintained by the scheduler
+    uint32_t next_release_us;
+    uint32_t overruns;          // Releases skipped because the task ran too late
+    uint32_t max_lateness_us;   // Longest delay between a release and the start of the task
+    uint32_t max_duration_us;   // Longest run time of the task
+} scheduler_task_t;
+
+void scheduler_init(scheduler_task_t *tasks, uint8_t num_tasks);
+
+// Runs the most urgent due task, if any. Returns false if none was due.
+bool scheduler_run(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
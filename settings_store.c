@@ -0,0 +1,243 @@
+#include "pico/stdlib.h"
+#include <string.h>
+#include "hardware/flash.h"
+#include "config.h"
+#include "settings_store.h"
+
+#define PAGES_PER_SECTOR    (FLASH_SECTOR_SIZE / FLASH_PAGE_SIZE)
+#define NUM_PAGES           (FLASH_SETTINGS_SECTORS * PAGES_PER_SECTOR)
+
+// Page header, after the magic number
+#define HEADER_SEQUENCE     (MAGIC_NUMBER_LENGTH + 0) // 4 bytes, little endian
+#define HEADER_CRC          (MAGIC_NUMBER_LENGTH + 4) // 2 bytes, little endian, covers everything below
+#define HEADER_LENGTH       (MAGIC_NUMBER_LENGTH + 6) // Payload length in bytes
+#define HEADER_VERSION      (MAGIC_NUMBER_LENGTH + 7) // SETTINGS_FORMAT_VERSION
+#define HEADER_SIZE         (MAGIC_NUMBER_LENGTH + 8)
+#define PAYLOAD_MAX         (FLASH_PAGE_SIZE - HEADER_SIZE)
+
+// The payload is a list of items, each one a tag byte followed by its data.
+// The tag holds the item kind in the high nibble and the slot in the low one.
+#define ITEM_GLOBALS        0
+#define ITEM_PRESET         1
+#define ITEM_SCALE          2
+
+// A full snapshot has to fit in a single page
+_Static_assert((1 + SETTINGS_GLOBALS_LENGTH) +
+               (NUM_PRESET_SLOTS * (1 + SETTINGS_PRESET_LENGTH)) +
+               (NUM_SCALE_SLOTS * (1 + SETTINGS_SCALE_LENGTH)) <= PAYLOAD_MAX,
+               "Too many preset or scale slots for a settings page");
+_Static_assert(NUM_PRESET_SLOTS <= 16 && NUM_SCALE_SLOTS <= 16, "Slot numbers must fit in a nibble");
+
+// Offsets of the single-page layout of firmware 2.5.1 and earlier
+#define LEGACY_GLOBALS      MAGIC_NUMBER_LENGTH
+#define LEGACY_PRESETS      (MAGIC_NUMBER_LENGTH + 12)
+#define LEGACY_SCALES       (LEGACY_PRESETS + NUM_PRESET_SLOTS * SETTINGS_PRESET_LENGTH)
+
+static settings_flash_write_t flash_write;
+static settings_t stored;           // What the log currently holds
+static bool log_valid;              // False until a snapshot has been written
+static uint8_t head_sector;         // Where the next page goes. A head_page equal to
+static uint8_t head_page;           // PAGES_PER_SECTOR means the sector is full
+static uint32_t next_sequence;
+
+static inline const uint8_t *page_address(uint16_t page) {
+    // Read address is different than write address
+    return (const uint8_t *)(XIP_BASE + FLASH_SETTINGS_OFFSET + (uint32_t)page * FLASH_PAGE_SIZE);
+}
+
+static uint16_t crc16(uint16_t crc, const uint8_t *data, size_t length) {
+    // CRC-16/CCITT
+    while (length--) {
+        crc ^= (uint16_t)(*data++) << 8;
+        for (uint8_t i = 0; i < 8; i++) {
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
+        }
+    }
+    return crc;
+}
+
+static uint16_t page_crc(const uint8_t *page) {
+    uint16_t crc = crc16(0xFFFF, page + HEADER_SEQUENCE, 4);
+    return crc16(crc, page + HEADER_LENGTH, (HEADER_SIZE - HEADER_LENGTH) + page[HEADER_LENGTH]);
+}
+
+static inline uint32_t page_sequence(const uint8_t *page) {
+    return page[HEADER_SEQUENCE + 0]         | (page[HEADER_SEQUENCE + 1] << 8) |
+           (page[HEADER_SEQUENCE + 2] << 16) | ((uint32_t)page[HEADER_SEQUENCE + 3] << 24);
+}
+
+static bool page_is_valid(const uint8_t *page) {
+    uint8_t magic[MAGIC_NUMBER_LENGTH] = MAGIC_NUMBER;
+    if (memcmp(page, magic, MAGIC_NUMBER_LENGTH) != 0) { return false; }
+    if (page[HEADER_VERSION] != SETTINGS_FORMAT_VERSION) { return false; }
+    if (page[HEADER_LENGTH] > PAYLOAD_MAX) { return false; }
+    uint16_t crc = page[HEADER_CRC] | (page[HEADER_CRC + 1] << 8);
+    return crc == page_crc(page);
+}
+
+static bool page_is_erased(const uint8_t *page) {
+    for (uint16_t i = 0; i < FLASH_PAGE_SIZE; i++) {
+        if (page[i] != 0xFF) { return false; }
+    }
+    return true;
+}
+
+// Returns the data of the item with the given tag, or NULL if there is no such item
+static uint8_t *item_data(settings_t *settings, uint8_t tag, uint8_t *length) {
+    uint8_t slot = tag & 0x0F;
+    switch (tag >> 4) {
+        case ITEM_GLOBALS:
+            if (slot != 0) { break; }
+            *length = SETTINGS_GLOBALS_LENGTH;
+            return settings->globals;
+        case ITEM_PRESET:
+            if (slot >= NUM_PRESET_SLOTS) { break; }
+            *length = SETTINGS_PRESET_LENGTH;
+            return settings->presets[slot];
+        case ITEM_SCALE:
+            if (slot >= NUM_SCALE_SLOTS) { break; }
+            *length = SETTINGS_SCALE_LENGTH;
+            return settings->scales[slot];
+    }
+    return NULL;
+}
+
+static void apply_page(const uint8_t *page, settings_t *settings) {
+    const uint8_t *payload = page + HEADER_SIZE;
+    uint8_t payload_length = page[HEADER_LENGTH];
+    uint8_t offset = 0;
+    while (offset < payload_length) {
+        uint8_t length;
+        uint8_t *data = item_data(settings, payload[offset], &length);
+        // Stop at items written by a later format, or cut short
+        if (data == NULL || length > payload_length - offset - 1) { break; }
+        memcpy(data, &payload[offset + 1], length);
+        offset += 1 + length;
+    }
+}
+
+static bool load_legacy(settings_t *settings) {
+    const uint8_t *stored_data = (const uint8_t *)(XIP_BASE + FLASH_LEGACY_OFFSET);
+    uint8_t magic[MAGIC_NUMBER_LENGTH] = MAGIC_NUMBER;
+    if (memcmp(stored_data, magic, MAGIC_NUMBER_LENGTH) != 0) { return false; }
+    if (stored_data[HEADER_VERSION] != 0) { return false; } // Reserved byte, always 0 back then
+
+    memcpy(settings->globals, &stored_data[LEGACY_GLOBALS], SETTINGS_GLOBALS_LENGTH);
+    memcpy(settings->presets, &stored_data[LEGACY_PRESETS], sizeof(settings->presets));
+    memcpy(settings->scales,  &stored_data[LEGACY_SCALES],  sizeof(settings->scales));
+    return true;
+}
+
+void settings_store_init(settings_flash_write_t flash_write_func) {
+    flash_write = flash_write_func;
+    log_valid = false;
+    head_sector = 0;
+    head_page = 0;
+    next_sequence = 0;
+}
+
+bool settings_store_load(settings_t *settings) {
+    // Collect the valid pages first, the CRC check is the expensive part
+    uint32_t sequences[NUM_PAGES];
+    bool valid[NUM_PAGES];
+    for (uint16_t page = 0; page < NUM_PAGES; page++) {
+        valid[page] = page_is_valid(page_address(page));
+        sequences[page] = valid[page] ? page_sequence(page_address(page)) : 0;
+    }
+
+    // Apply them from the oldest to the newest
+    bool found = false;
+    uint32_t last_sequence = 0;
+    uint16_t last_page = 0;
+    while (true) {
+        bool have_next = false;
+        uint16_t next_page = 0;
+        for (uint16_t page = 0; page < NUM_PAGES; page++) {
+            if (!valid[page] || (found && sequences[page] <= last_sequence)) { continue; }
+            if (!have_next || sequences[page] < sequences[next_page]) {
+                have_next = true;
+                next_page = page;
+            }
+        }
+        if (!have_next) { break; }
+
+        apply_page(page_address(next_page), &stored);
+        found = true;
+        last_sequence = sequences[next_page];
+        last_page = next_page;
+    }
+
+    if (!found) {
+        // Nothing in the log yet. The first save writes a snapshot
+        // to the first sector, which migrates any legacy settings.
+        log_valid = false;
+        if (!load_legacy(&stored)) { return false; }
+        *settings = stored;
+        return true;
+    }
+
+    // Continue after the newest page, skipping any page that was not
+    // fully programmed. A full sector gets compacted on the next save.
+    log_valid = true;
+    next_sequence = last_sequence + 1;
+    head_sector = last_page / PAGES_PER_SECTOR;
+    head_page = (last_page % PAGES_PER_SECTOR) + 1;
+    while (head_page < PAGES_PER_SECTOR &&
+           !page_is_erased(page_address(head_sector * PAGES_PER_SECTOR + head_page))) {
+        head_page++;
+    }
+
+    *settings = stored;
+    return true;
+}
+
+bool settings_store_save(const settings_t *settings) {
+    static uint8_t page[FLASH_PAGE_SIZE];
+    bool snapshot = !log_valid || (head_page == PAGES_PER_SECTOR);
+
+    // Gather the items that changed, or all of them for a snapshot
+    memset(page, 0xFF, sizeof(page));
+    uint8_t *payload = page + HEADER_SIZE;
+    uint8_t payload_length = 0;
+    for (uint8_t kind = ITEM_GLOBALS; kind <= ITEM_SCALE; kind++) {
+        for (uint8_t slot = 0; slot < 16; slot++) {
+            uint8_t tag = (kind << 4) | slot;
+            uint8_t length;
+            uint8_t *stored_data = item_data(&stored, tag, &length);
+            if (stored_data == NULL) { break; }
+            const uint8_t *data = item_data((settings_t *)settings, tag, &length);
+            if (!snapshot && memcmp(stored_data, data, length) == 0) { continue; }
+            payload[payload_length] = tag;
+            memcpy(&payload[payload_length + 1], data, length);
+            payload_length += 1 + length;
+        }
+    }
+    if (payload_length == 0) { return false; }
+
+    // A snapshot starts a freshly erased sector, the next one when compacting
+    if (snapshot) {
+        head_sector = log_valid ? (head_sector + 1) % FLASH_SETTINGS_SECTORS : 0;
+        head_page = 0;
+    }
+
+    uint8_t magic[MAGIC_NUMBER_LENGTH] = MAGIC_NUMBER;
+    memcpy(page, magic, MAGIC_NUMBER_LENGTH);
+    page[HEADER_SEQUENCE + 0] = next_sequence;
+    page[HEADER_SEQUENCE + 1] = next_sequence >> 8;
+    page[HEADER_SEQUENCE + 2] = next_sequence >> 16;
+    page[HEADER_SEQUENCE + 3] = next_sequence >> 24;
+    page[HEADER_LENGTH] = payload_length;
+    page[HEADER_VERSION] = SETTINGS_FORMAT_VERSION;
+    uint16_t crc = page_crc(page);
+    page[HEADER_CRC + 0] = crc;
+    page[HEADER_CRC + 1] = crc >> 8;
+
+    uint32_t offset = FLASH_SETTINGS_OFFSET + ((uint32_t)head_sector * PAGES_PER_SECTOR + head_page) * FLASH_PAGE_SIZE;
+    flash_write(offset, page, FLASH_PAGE_SIZE, snapshot);
+
+    head_page++;
+    next_sequence++;
+    log_valid = true;
+    stored = *settings;
+    return true;
+}
@@ -0,0 +1,50 @@
+#ifndef SETTINGS_STORE_H
+#define SETTINGS_STORE_H
+#include "pico/stdlib.h"
+#include "config.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Append-only settings log over the last FLASH_SETTINGS_SECTORS sectors of flash.
+// Each save programs one page holding the items that changed since the last
+// save, instead of erasing and rewriting a whole sector. Pages carry a sequence
+// number and a CRC, and are applied in sequence order at startup. When the
+// current sector is full, the next one is erased and a full snapshot is
+// written at its start, so the oldest sector can always be reused.
+
+#define SETTINGS_FORMAT_VERSION     1   // Stored at MAGIC_NUMBER_LENGTH + 7, which is 0 in the
+                                        // single-page layout of firmware 2.5.1 and earlier
+
+#define SETTINGS_GLOBALS_LENGTH     7   // Key, scale, instrument, IMU axes, volume, contrast, chord mode
+#define SETTINGS_PRESET_LENGTH      45  // PROGRAM_PARAMS_NUM
+#define SETTINGS_SCALE_LENGTH       12
+
+typedef struct {
+    uint8_t globals[SETTINGS_GLOBALS_LENGTH];
+    uint8_t presets[NUM_PRESET_SLOTS][SETTINGS_PRESET_LENGTH];
+    uint8_t scales[NUM_SCALE_SLOTS][SETTINGS_SCALE_LENGTH];
+} settings_t;
+
+// Erases the sector at offset first if erase is true, then programs length
+// bytes (a multiple of FLASH_PAGE_SIZE) at offset. Provided by the application,
+// which has to keep the other core and the audio output safe meanwhile.
+typedef void (*settings_flash_write_t)(uint32_t offset, const uint8_t *data, size_t length, bool erase);
+
+void settings_store_init(settings_flash_write_t flash_write);
+
+// Reads the log, or the single-page layout of earlier firmware if there is no
+// log yet. Returns false if nothing valid is stored. The values themselves
+// are not range-checked.
+bool settings_store_load(settings_t *settings);
+
+// Appends the items that differ from the stored ones. Returns false if there
+// was nothing to write.
+bool settings_store_save(const settings_t *settings);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
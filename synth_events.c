@@ -0,0 +1,107 @@
+#include "pico/stdlib.h"
+#include "hardware/sync.h"
+#include "config.h"
+#include "sound_i2s.h"
+#include "synth_events.h"
+
+#define SYNTH_EVENTS_QUEUE_MASK (SYNTH_EVENTS_QUEUE_SIZE - 1)
+
+#if (SYNTH_EVENTS_QUEUE_SIZE & SYNTH_EVENTS_QUEUE_MASK) != 0
+#error "SYNTH_EVENTS_QUEUE_SIZE must be a power of two"
+#endif
+
+// Live events are posted for right now, scheduled ones ahead of time, each
+// queue in time order. The consumer takes the earliest of the heads, so
+// events scheduled far ahead don't hold back the live ones.
+typedef struct {
+    synth_event_t events[SYNTH_EVENTS_QUEUE_SIZE];
+    volatile uint32_t head; // Written by the producer only
+    volatile uint32_t tail; // Written by the consumer only
+} event_queue_t;
+
+static event_queue_t live;
+static event_queue_t scheduled[SYNTH_NUM_LANES];
+static volatile uint32_t scheduled_cancel[SYNTH_NUM_LANES]; // Scheduled events before this index are dropped
+static event_queue_t *peeked;               // Consumer only, the queue of the last peek
+static uint32_t overflows;
+
+void synth_events_init(void) {
+    live.head = 0;
+    live.tail = 0;
+    for (uint8_t lane = 0; lane < SYNTH_NUM_LANES; lane++) {
+        scheduled[lane].head = 0;
+        scheduled[lane].tail = 0;
+        scheduled_cancel[lane] = 0;
+    }
+    peeked = &live;
+    overflows = 0;
+}
+
+uint32_t synth_events_now(void) {
+    return sound_i2s_get_sample_clock();
+}
+
+static bool queue_post(event_queue_t *q, uint32_t time, synth_event_type_t type, uint8_t data1, uint8_t data2) {
+    uint32_t h = q->head;
+    if (h - q->tail >= SYNTH_EVENTS_QUEUE_SIZE) {
+        overflows++;
+        return false;
+    }
+
+    synth_event_t *event = &q->events[h & SYNTH_EVENTS_QUEUE_MASK];
+    event->time = time;
+    event->type = type;
+    event->data1 = data1;
+    event->data2 = data2;
+
+    __dmb(); // Publish the event before the new head
+    q->head = h + 1;
+    return true;
+}
+
+bool synth_events_post_at(synth_lane_t lane, uint32_t time, synth_event_type_t type, uint8_t data1, uint8_t data2) {
+    return queue_post(&scheduled[lane], time, type, data1, data2);
+}
+
+bool synth_events_post(synth_event_type_t type, uint8_t data1, uint8_t data2) {
+    return queue_post(&live, synth_events_now() + SYNTH_EVENTS_LATENCY, type, data1, data2);
+}
+
+void synth_events_cancel_scheduled(synth_lane_t lane) {
+    scheduled_cancel[lane] = scheduled[lane].head;
+}
+
+static inline const synth_event_t *__not_in_flash_func(queue_peek)(event_queue_t *q) {
+    uint32_t t = q->tail;
+    if (t == q->head) { return NULL; }
+    __dmb(); // Read the event only after observing the head
+    return &q->events[t & SYNTH_EVENTS_QUEUE_MASK];
+}
+
+const synth_event_t *__not_in_flash_func(synth_events_peek)(void) {
+    const synth_event_t *earliest = queue_peek(&live);
+    peeked = &live;
+    for (uint8_t lane = 0; lane < SYNTH_NUM_LANES; lane++) {
+        // Skip what was cancelled, without applying it
+        uint32_t cancel = scheduled_cancel[lane];
+        if ((int32_t)(cancel - scheduled[lane].tail) > 0) {
+            scheduled[lane].tail = cancel;
+        }
+
+        const synth_event_t *event = queue_peek(&scheduled[lane]);
+        if (event != NULL && (earliest == NULL || (int32_t)(event->time - earliest->time) < 0)) {
+            earliest = event;
+            peeked = &scheduled[lane];
+        }
+    }
+    return earliest;
+}
+
+void __not_in_flash_func(synth_events_pop)(void) {
+    __dmb(); // Finish reading the event before releasing its slot
+    peeked->tail = peeked->tail + 1;
+}
+
+uint32_t synth_events_get_overflows(void) {
+    return overflows;
+}
@@ -0,0 +1,67 @@
+#ifndef SYNTH_EVENTS_H
+#define SYNTH_EVENTS_H
+#include "pico/stdlib.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Single-producer/single-consumer queue of timestamped synth events.
+// Core0 (UI, looper, arpeggiator) is the only producer, core1 (audio) is the
+// only consumer. Core1 drains the queue at block boundaries and applies each
+// event at its own sample offset within the block, so the synth state is
+// never touched by core0 while a sample is being computed.
+
+typedef enum {
+    SYNTH_EVENT_NOTE_ON = 0,
+    SYNTH_EVENT_NOTE_OFF,
+    SYNTH_EVENT_CONTROL_CHANGE,
+    SYNTH_EVENT_PITCH_BEND,
+    SYNTH_EVENT_PROGRAM_CHANGE,
+    SYNTH_EVENT_ALL_NOTES_OFF,
+    SYNTH_EVENT_POLY_PRESSURE,
+} synth_event_type_t;
+
+// Producers of events planned ahead, each with a queue of its own
+typedef enum {
+    SYNTH_LANE_LOOPER = 0,
+    SYNTH_LANE_ARPEGGIATOR,
+    SYNTH_NUM_LANES,
+} synth_lane_t;
+
+typedef struct {
+    uint32_t time;  // Audio sample clock value at which the event takes effect
+    uint8_t type;   // synth_event_type_t
+    uint8_t data1;  // note, cc number, pitch bend lsb or program number
+    uint8_t data2;  // velocity, cc value, pitch bend msb or pressure
+} synth_event_t;
+
+void synth_events_init(void);
+
+// Current playback position in samples, see sound_i2s_get_sample_clock()
+uint32_t synth_events_now(void);
+
+// Producer side (core0). Events are stamped with the current audio clock
+// plus SYNTH_EVENTS_LATENCY, which keeps the relative timing of events intact.
+// Return false if the queue is full and the event was dropped.
+bool synth_events_post(synth_event_type_t type, uint8_t data1, uint8_t data2);
+
+// Events planned ahead, such as looper playback, go to the queue of their
+// lane and can be any distance in the future. Times must not decrease from
+// one call to the next on a lane, until it is cancelled.
+bool synth_events_post_at(synth_lane_t lane, uint32_t time, synth_event_type_t type, uint8_t data1, uint8_t data2);
+
+// Drops the events posted on the lane that were not applied yet
+void synth_events_cancel_scheduled(synth_lane_t lane);
+
+// Consumer side (core1). The event returned by peek stays valid until pop.
+const synth_event_t *synth_events_peek(void);
+void synth_events_pop(void);
+
+uint32_t synth_events_get_overflows(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,248 @@
+#include "pico/stdlib.h"
+#include <stdlib.h>
+#include "config.h"
+#include "state.h"
+#include "synth_events.h"
+#include "tempo.h"
+
+// Hooks in main.cpp
+extern void tempo_send_midi(uint8_t status);
+extern void tempo_transport(bool running);
+
+// Incoming clock loop filter: shares of the pulse timing error taken into
+// the phase and the period, as right shifts. Smooths out the USB jitter.
+#define PLL_PHASE_SHIFT     2
+#define PLL_PERIOD_SHIFT    4
+
+// Range of incoming pulse periods, in 24.8 fixed point samples (20 to 400 BPM)
+#define PULSE_PERIOD_MIN    (((SOUND_OUTPUT_FREQUENCY * 60 / (400 * TEMPO_MIDI_PPQN))) << 8)
+#define PULSE_PERIOD_MAX    (((SOUND_OUTPUT_FREQUENCY * 60 / (20 * TEMPO_MIDI_PPQN))) << 8)
+
+#define EXTERNAL_TIMEOUT    ((uint32_t)TEMPO_EXTERNAL_TIMEOUT_MS * (SOUND_OUTPUT_FREQUENCY / 1000))
+
+typedef struct {
+    // Ticks follow on from the anchor tick, which falls on the anchor time,
+    // tick_length samples apart in 16.16 fixed point
+    uint32_t anchor_tick;
+    uint32_t anchor_time;
+    uint32_t tick_length;
+    uint16_t beat_ms;           // Internal tempo the tick length was set for
+
+    uint32_t midi_tick;         // Next tick with a Midi clock message to send
+    bool start_pending;         // Midi start goes out before that message
+
+    // Incoming Midi clock
+    bool external;
+    bool rephase;               // Midi start received, the next pulse is the first beat
+    uint8_t pulse_count;        // Pulses since locking on, up to 2
+    uint32_t pulse_tick;        // Tick the last pulse stands for
+    uint32_t pulse_time;        // Smoothed time of the last pulse
+    uint32_t pulse_period;      // Smoothed time between pulses, 24.8 fixed point
+    uint32_t last_pulse;        // Arrival of the last pulse, for the timeout
+} tempo_t;
+
+static tempo_t tempo;
+
+static inline uint32_t align_up(uint32_t tick, uint32_t step) {
+    return ((tick + step - 1) / step) * step;
+}
+
+// First tick that nothing was planned on yet. Ticks before it keep their time.
+static uint32_t tempo_first_free_tick(void) {
+    return tempo_tick_at(synth_events_now() + SEQUENCER_LOOKAHEAD);
+}
+
+// Moves the anchor to the first free tick, shifted by the given amount, and
+// sets the tick length from there on
+static void tempo_retime(uint32_t tick_length, int32_t shift) {
+    uint32_t tick = tempo_first_free_tick();
+    tempo.anchor_time = tempo_tick_time(tick) + shift;
+    tempo.anchor_tick = tick;
+    tempo.tick_length = tick_length;
+}
+
+static uint32_t internal_tick_length(uint16_t beat_ms) {
+    return (uint32_t)(((uint64_t)beat_ms * SOUND_OUTPUT_FREQUENCY * 65536) / (1000 * TEMPO_PPQN));
+}
+
+static uint16_t internal_beat_ms(void) {
+    uint16_t speed = get_arp_speed_ms();
+    if (speed < ARP_SPEED_MIN) return ARP_SPEED_MIN;
+    if (speed > ARP_SPEED_MAX) return ARP_SPEED_MAX;
+    return speed;
+}
+
+// The Midi clock carries on from the next pulse that is not due yet
+static void tempo_resync_midi(void) {
+    tempo.midi_tick = align_up(tempo_tick_at(synth_events_now() + SYNTH_EVENTS_LATENCY), TEMPO_TICKS_PER_PULSE);
+    tempo.start_pending = false;
+}
+
+void tempo_init(void) {
+    tempo.beat_ms = internal_beat_ms();
+    tempo.tick_length = internal_tick_length(tempo.beat_ms);
+    tempo.anchor_tick = 0;
+    tempo.anchor_time = synth_events_now();
+    tempo.external = false;
+    tempo.rephase = false;
+    tempo.pulse_count = 0;
+    tempo_resync_midi();
+}
+
+uint32_t tempo_tick_time(uint32_t tick) {
+    int64_t ticks = (int32_t)(tick - tempo.anchor_tick);
+    return tempo.anchor_time + (uint32_t)((ticks * tempo.tick_length) >> 16);
+}
+
+uint32_t tempo_tick_at(uint32_t time) {
+    int64_t elapsed = (int32_t)(time - tempo.anchor_time);
+    uint32_t tick = tempo.anchor_tick + (int32_t)((elapsed << 16) / tempo.tick_length);
+    // The division rounds towards zero, step over to the exact tick
+    while ((int32_t)(tempo_tick_time(tick) - time) < 0) { tick++; }
+    while ((int32_t)(tempo_tick_time(tick - 1) - time) >= 0) { tick--; }
+    return tick;
+}
+
+uint32_t tempo_ticks_to_samples(uint32_t ticks) {
+    return (uint32_t)(((uint64_t)ticks * tempo.tick_length) >> 16);
+}
+
+uint32_t tempo_start(uint32_t time) {
+    if (tempo.external) {
+        return tempo_tick_at(time);
+    }
+    // A fresh bar after the ticks already planned on. The ones in between
+    // are skipped, and whatever follows the ticks picks up from the bar.
+    uint32_t tick = align_up(tempo_first_free_tick(), TEMPO_TICKS_PER_BAR);
+    tempo.anchor_tick = tick;
+    tempo.anchor_time = time;
+    tempo.midi_tick = tick;
+    tempo.start_pending = true;
+    return tick;
+}
+
+void tempo_stop(void) {
+    if (tempo.external) { return; }
+    tempo.start_pending = false;
+    tempo_send_midi(0xFC);
+}
+
+bool tempo_is_external(void) {
+    return tempo.external;
+}
+
+static void tempo_clock_pulse(uint32_t time) {
+    if (!tempo.external) {
+        tempo.external = true;
+        tempo.pulse_count = 0;
+    }
+    tempo.last_pulse = time;
+
+    if (tempo.pulse_count >= 2) {
+        uint32_t predicted = tempo.pulse_time + (tempo.pulse_period >> 8);
+        int32_t error = (int32_t)(time - predicted);
+        if (abs(error) > (int32_t)(tempo.pulse_period >> 9)) {
+            // Off by more than half a pulse, lock on again
+            tempo.pulse_count = 0;
+        } else {
+            tempo.pulse_time = predicted + (error >> PLL_PHASE_SHIFT);
+            tempo.pulse_period += (error * 256) >> PLL_PERIOD_SHIFT;
+            tempo.pulse_tick += TEMPO_TICKS_PER_PULSE;
+        }
+    } else if (tempo.pulse_count == 1) {
+        tempo.pulse_period = (time - tempo.pulse_time) << 8;
+        tempo.pulse_time = time;
+        tempo.pulse_tick += TEMPO_TICKS_PER_PULSE;
+        tempo.pulse_count = 2;
+    }
+    if (tempo.pulse_count == 0) {
+        // The pulse stands for the nearest pulse tick ahead, the tick
+        // length stays until the next pulse gives the period
+        tempo.pulse_tick = align_up(tempo_tick_at(time), TEMPO_TICKS_PER_PULSE);
+        tempo.pulse_time = time;
+        tempo.pulse_count = 1;
+    }
+    if (tempo.pulse_period < PULSE_PERIOD_MIN) { tempo.pulse_period = PULSE_PERIOD_MIN; }
+    if (tempo.pulse_period > PULSE_PERIOD_MAX) { tempo.pulse_period = PULSE_PERIOD_MAX; }
+
+    if (tempo.rephase) {
+        // The first beat of a bar, after the ticks already planned on
+        tempo.rephase = false;
+        tempo.pulse_tick = align_up(tempo_first_free_tick(), TEMPO_TICKS_PER_BAR);
+        tempo.pulse_time = time;
+        tempo.anchor_tick = tempo.pulse_tick;
+        tempo.anchor_time = time;
+        if (tempo.pulse_count >= 2) {
+            tempo.tick_length = tempo.pulse_period << 6;
+        }
+        tempo_transport(true);
+        return;
+    }
+    if (tempo.pulse_count < 2) { return; }
+
+    // Steer the free ticks towards the smoothed pulses, by at most a quarter
+    // of a tick at a time so they never go back on the ones before
+    uint32_t tick = tempo_first_free_tick();
+    uint32_t current = tempo_tick_time(tick);
+    int64_t ticks = (int32_t)(tick - tempo.pulse_tick);
+    uint32_t target = tempo.pulse_time + (uint32_t)((ticks * tempo.pulse_period) / (TEMPO_TICKS_PER_PULSE * 256));
+    int32_t shift = (int32_t)(target - current);
+    int32_t limit = (int32_t)(tempo.tick_length >> 18);
+    if (shift > limit) { shift = limit; }
+    if (shift < -limit) { shift = -limit; }
+    tempo_retime(tempo.pulse_period << 6, shift);
+}
+
+void tempo_midi_in(uint8_t status, uint32_t time) {
+    switch (status) {
+        case 0xF8: // Clock
+            tempo_clock_pulse(time);
+            break;
+        case 0xFA: // Start
+            tempo.rephase = true;
+            break;
+        case 0xFC: // Stop
+            if (tempo.external) {
+                tempo_transport(false);
+            }
+            break;
+        default: // Continue carries on with the pulses
+            break;
+    }
+}
+
+void tempo_task(void) {
+    uint32_t now = synth_events_now();
+    if (tempo.external && (int32_t)(now - tempo.last_pulse) > (int32_t)EXTERNAL_TIMEOUT) {
+        // The incoming clock stopped, back to the internal tempo
+        tempo.external = false;
+        tempo.rephase = false;
+        tempo.beat_ms = 0;
+    }
+    if (tempo.external) { return; }
+
+    uint16_t beat_ms = internal_beat_ms();
+    if (beat_ms != tempo.beat_ms) {
+        tempo.beat_ms = beat_ms;
+        tempo_retime(internal_tick_length(beat_ms), 0);
+        if (!tempo.start_pending) {
+            tempo_resync_midi();
+        }
+    }
+
+#if defined(USE_MIDI)
+    // Sent when due like live notes, so the clock and the notes line up at the receiver
+    uint32_t due = now + SYNTH_EVENTS_LATENCY;
+    if ((int32_t)(tempo_tick_time(tempo.midi_tick) - now) < 0) {
+        tempo_resync_midi(); // Way behind, such as after the tempo went up a lot
+    }
+    while ((int32_t)(tempo_tick_time(tempo.midi_tick) - due) <= 0) {
+        if (tempo.start_pending) {
+            tempo_send_midi(0xFA);
+            tempo.start_pending = false;
+        }
+        tempo_send_midi(0xF8);
+        tempo.midi_tick += TEMPO_TICKS_PER_PULSE;
+    }
+#endif
+}
@@ -0,0 +1,54 @@
+#ifndef TEMPO_H
+#define TEMPO_H
+
+#include "pico/stdlib.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Tempo clock shared by the arpeggiator, the looper and the Midi clock output.
+// Ticks are TEMPO_PPQN to the beat and are placed on the audio sample clock,
+// so whatever follows them is as exact as the synth events it schedules.
+// The tempo is the arpeggiator speed, one step per beat, unless a USB Midi
+// clock is coming in, which the ticks then follow through a phase locked loop.
+// Tick numbers keep counting up across tempo changes.
+
+#define TEMPO_PPQN              96  // Ticks per beat
+#define TEMPO_MIDI_PPQN         24  // Midi clock messages per beat
+#define TEMPO_BEATS_PER_BAR     4
+#define TEMPO_TICKS_PER_PULSE   (TEMPO_PPQN / TEMPO_MIDI_PPQN)
+#define TEMPO_TICKS_PER_BAR     (TEMPO_PPQN * TEMPO_BEATS_PER_BAR)
+
+void tempo_init(void);
+
+// Follows the tempo setting, sends the Midi clock and falls back to the
+// internal tempo when the incoming clock stops. Call before the arpeggiator
+// and looper tasks.
+void tempo_task(void);
+
+// Audio sample clock value of a tick
+uint32_t tempo_tick_time(uint32_t tick);
+
+// First tick at or after an audio sample clock value
+uint32_t tempo_tick_at(uint32_t time);
+
+uint32_t tempo_ticks_to_samples(uint32_t ticks);
+
+// Starts the Midi transport with the first beat of a bar at the given time,
+// and returns its tick. Under an external clock the transport is not ours,
+// and this only returns the first tick at or after the time.
+uint32_t tempo_start(uint32_t time);
+void tempo_stop(void);
+
+// True while the ticks follow an incoming Midi clock
+bool tempo_is_external(void);
+
+// Realtime message received over USB Midi, at the given audio sample clock value
+void tempo_midi_in(uint8_t status, uint32_t time);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
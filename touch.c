@@ -6,6 +6,11 @@
 #include <config.h>
 #include "touch.h"
 
+// MPR121 registers
+#define MPR121_TOUCH_STATUS_REG     0x00 // 16 bits, one per electrode
+#define MPR121_FILTERED_DATA_REG    0x04 // 10 bits per electrode, 2 bytes each, little endian
+#define MPR121_BASELINE_REG         0x1E // Upper 8 of 10 bits per electrode, 1 byte each
+
 struct mpr121_sensor mpr121;
 
 void mpr121_i2c_init(){
@@ -20,23 +25,109 @@ void mpr121_i2c_init(){
                           MPR121_RELEASE_THRESHOLD, &mpr121);
     
     mpr121_enable_electrodes(12, &mpr121);
+
+#if defined (MPR121_IRQ_PIN)
+    // Open-drain output, held low until the touch status is read
+    gpio_init(MPR121_IRQ_PIN);
+    gpio_set_dir(MPR121_IRQ_PIN, GPIO_IN);
+    gpio_pull_up(MPR121_IRQ_PIN);
+#endif
+}
+
+// Burst read of consecutive registers in a single transaction
+static bool mpr121_read_registers(uint8_t reg, uint8_t *data, size_t length) {
+    if (i2c_write_blocking(MPR121_I2C_PORT, MPR121_ADDRESS, &reg, 1, true) != 1) { return false; }
+    return i2c_read_blocking(MPR121_I2C_PORT, MPR121_ADDRESS, data, length, false) == (int)length;
 }
 
+// Read the status of all electrodes in a single transaction
+static bool mpr121_read_touch_status(uint16_t *status) {
+    uint8_t data[2];
+    if (!mpr121_read_registers(MPR121_TOUCH_STATUS_REG, data, 2)) { return false; }
+    *status = (data[0] | (data[1] << 8)) & 0x0FFF;
+    return true;
+}
+
+#if defined (USE_PRESSURE)
+// Estimate how hard the touched pads are pressed from how far their filtered
+// data has dropped below the baseline. Only the span of touched electrodes is
+// read, and only while any is touched. The baselines drift slowly, so they
+// are read at a lower rate.
+static void mpr121_pressure_task(uint32_t now, uint16_t touched) {
+    static uint32_t last_read_us;
+    static uint32_t last_baseline_us;
+    static bool baselines_valid;
+    static uint8_t baselines[12];
+    static uint16_t smoothed[12]; // Pressure * 4
+    static uint8_t sent[12];
+
+    // Released pads go back to zero
+    for (uint8_t i = 0; i < 12; i++) {
+        if (!((touched >> i) & 0x01)) {
+            smoothed[i] = 0;
+            if (sent[i] != 0) {
+                sent[i] = 0;
+                touch_pressure(i, 0);
+            }
+        }
+    }
+
+    if (touched == 0) {
+        baselines_valid = false; // Calibration may have moved on meanwhile
+        return;
+    }
+    if (now - last_read_us < MPR121_PRESSURE_INTERVAL_US) { return; }
+    last_read_us = now;
+
+    if (!baselines_valid || (now - last_baseline_us) >= MPR121_BASELINE_INTERVAL_US) {
+        if (!mpr121_read_registers(MPR121_BASELINE_REG, baselines, 12)) { return; }
+        baselines_valid = true;
+        last_baseline_us = now;
+    }
 
-// Perform a second pass of debouncing to better deal with long presses
+    uint8_t first = __builtin_ctz(touched);
+    uint8_t last = 31 - __builtin_clz(touched);
+    uint8_t data[24];
+    if (!mpr121_read_registers(MPR121_FILTERED_DATA_REG + 2 * first, data, 2 * (last - first + 1))) { return; }
+
+    for (uint8_t i = first; i <= last; i++) {
+        if (!((touched >> i) & 0x01)) { continue; }
+        uint16_t filtered = data[2 * (i - first)] | ((data[2 * (i - first) + 1] & 0x03) << 8);
+        int32_t delta = (baselines[i] << 2) - filtered;
+        int32_t pressure = ((delta - MPR121_TOUCH_THRESHOLD) * 127) / MPR121_PRESSURE_RANGE;
+        if (pressure < 0) { pressure = 0; }
+        if (pressure > 127) { pressure = 127; }
+
+        smoothed[i] += pressure - (smoothed[i] >> 2);
+        uint8_t value = smoothed[i] >> 2;
+        if (value != sent[i]) {
+            sent[i] = value;
+            touch_pressure(i, value);
+        }
+    }
+}
+#endif
+
+
+// Perform a second pass of debouncing to better deal with long presses.
+// A release only counts once the pad has read as released for
+// MPR121_DEBOUNCE_MS, however often mpr121_task() got to run meanwhile.
 static bool debounced_states[12] = {false};
-static int debounce_counters[12] = {0};
-static inline bool mpr121_debounce(uint8_t i, bool is_touched) {
+static bool releasing[12] = {false};
+static uint32_t release_times[12];
+static inline bool mpr121_debounce(uint8_t i, bool is_touched, uint32_t now) {
     if (is_touched) { // Do not filter positive readings
-            debounced_states[i] = true;
-            debounce_counters[i] = 0;
-        } else if (!is_touched && debounced_states[i]) {
-            debounce_counters[i]++;
-            if (debounce_counters[i] >= MPR121_DEBOUNCE_THRESHOLD) {
-                debounced_states[i] = false;
-                debounce_counters[i] = 0;
-            }
+        debounced_states[i] = true;
+        releasing[i] = false;
+    } else if (debounced_states[i]) {
+        if (!releasing[i]) {
+            releasing[i] = true;
+            release_times[i] = now;
+        } else if (now - release_times[i] >= MPR121_DEBOUNCE_MS * 1000) {
+            debounced_states[i] = false;
+            releasing[i] = false;
         }
+    }
 
     return debounced_states[i];
 }
@@ -44,18 +135,33 @@ static inline bool mpr121_debounce(uint8_t i, bool is_touched) {
 void mpr121_task(){
     bool is_touched;
     static bool was_touched[12];
+    static uint16_t touch_status;
+
+    // With the IRQ pin connected, the status is only read after it changed
+#if defined (MPR121_IRQ_PIN)
+    if (!gpio_get(MPR121_IRQ_PIN))
+#endif
+    {
+        mpr121_read_touch_status(&touch_status);
+    }
+
+    uint32_t now = time_us_32();
     for(uint8_t i=0; i<12; i++) {
-        mpr121_is_touched(i, &is_touched, &mpr121);
-        is_touched = mpr121_debounce(i, is_touched);
+        is_touched = (touch_status >> i) & 0x01;
+        is_touched = mpr121_debounce(i, is_touched, now);
         if (is_touched != was_touched[i]){
-            if(time_us_32() < 500000) return;  // Ignore readings for half a second,
+            if(now < 500000) return;           // Ignore readings for half a second,
                                                // allowing the MPR121 to calibrate.
             if (is_touched){
-                touch_on(i);
+                touch_on(i, now);
             } else {
                 touch_off(i);
             }
             was_touched[i] = is_touched;
         }
     }
+
+#if defined (USE_PRESSURE)
+    mpr121_pressure_task(now, touch_status);
+#endif
 }
\ No newline at end of file
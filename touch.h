@@ -9,8 +9,9 @@ extern "C" {
 void mpr121_i2c_init();
 void mpr121_task();
 
-extern void touch_on(uint8_t id);
+extern void touch_on(uint8_t id, uint32_t time_us); // time_us_32() when the touch was read
 extern void touch_off(uint8_t id);
+extern void touch_pressure(uint8_t id, uint8_t pressure); // 0-127, with USE_PRESSURE
 
 #ifdef __cplusplus
 }